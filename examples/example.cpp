@@ -44,18 +44,18 @@ int main(int argc, char **argv)
     std::cout << "private key share 1: " << json_str << std::endl;
 
     safeheron::tss_rsa::update_bloom_filter(transaction, json_str);
-    std::cout << "bloom filter after share1: " << transaction.bloom_filter << std::endl;
+    std::cout << "bloom filter after share1: " << transaction.bloom_filter.ToString() << std::endl;
 
     priv_arr[1].ToJsonString(json_str);
     std::cout << "private key share 2: " << json_str << std::endl;
 
     safeheron::tss_rsa::update_bloom_filter(transaction, json_str);
-    std::cout << "bloom filter after share 2: " << transaction.bloom_filter << std::endl;
+    std::cout << "bloom filter after share 2: " << transaction.bloom_filter.ToString() << std::endl;
 
     transaction.data = "transaction_data";
-    transaction.data += transaction.bloom_filter.to_string();
+    safeheron::tss_rsa::append_bloom_filter(transaction);
 
-    std::cout << "transaction data: " << transaction.data << std::endl;
+    std::cout << "transaction data: " << safeheron::encode::hex::EncodeToHex(transaction.data) << std::endl;
 
     // Prepare
     std::string doc_pss = safeheron::tss_rsa::EncodeEMSA_PSS(transaction.data, key_bits_length, safeheron::tss_rsa::SaltLength::AutoLength);
@@ -86,6 +86,7 @@ int main(int argc, char **argv)
     std::cout << "Verify Sig: " << pub.VerifySignature(doc_pss, sig) << std::endl;
 
     // Extract the bloom filter from the signed transaction
-    std::cout << "extracted bloom_str: " << safeheron::tss_rsa::extract_bloom_filter(transaction) << std::endl;
+    safeheron::tss_rsa::BloomFilterView view = safeheron::tss_rsa::extract_bloom_filter(transaction);
+    std::cout << "extracted bloom filter: " << view.ToBloomFilter().ToString() << std::endl;
     return 0;
 }
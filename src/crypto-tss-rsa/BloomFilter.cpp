@@ -1,26 +1,539 @@
 #include "BloomFilter.h"
+#include <cmath>
+#include <functional>
+#include "exception/located_exception.h"
+#include "filter_hash.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#include <arm_neon.h>
+#define TSS_RSA_BLOOM_NEON
+#endif
+
+using safeheron::exception::LocatedException;
+
+// Historical filter parameters, kept as the defaults.
+// Size of the bloom filter
+static const size_t DEFAULT_M = 48;
+// Number of hash functions
+static const size_t DEFAULT_K = 17;
+
+// Odd multipliers, one per lane of a block. The first eight are the ones of the Parquet split block Bloom filter.
+alignas(64) static const uint32_t BLOCK_SALT[16] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU, 0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U,
+    0x9e3779b1U, 0x85ebca77U, 0xc2b2ae3dU, 0x27d4eb2fU, 0x165667b1U, 0xd3a2646dU, 0xfd7046c5U, 0xb55a4f09U};
+
+alignas(64) static const uint32_t LANE_INDEX[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+
+// The bits an element sets in its block: the k lanes start, start + 1, ..., start + k - 1 (mod 16) get
+// bit (key * BLOCK_SALT[j]) >> 27 in lane j, the other lanes get none. Rotating the first lane spreads
+// the load over all 16 lanes when k < 16.
+struct BlockPattern
+{
+    alignas(64) uint32_t lanes[16];
+};
+
+#if defined(__AVX2__)
+
+static inline void MakePattern(uint32_t key, uint32_t start, size_t k, BlockPattern &pattern)
+{
+    const __m256i ones = _mm256_set1_epi32(1);
+    const __m256i fifteen = _mm256_set1_epi32(15);
+    const __m256i h = _mm256_set1_epi32((int)key);
+    const __m256i kk = _mm256_set1_epi32((int)k);
+    const __m256i first = _mm256_set1_epi32((int)start);
+    for (int half = 0; half < 2; half++)
+    {
+        __m256i salt = _mm256_load_si256(reinterpret_cast<const __m256i *>(BLOCK_SALT + 8 * half));
+        __m256i lane = _mm256_load_si256(reinterpret_cast<const __m256i *>(LANE_INDEX + 8 * half));
+        // lane is enabled iff (lane - start) mod 16 < k
+        __m256i distance = _mm256_and_si256(_mm256_sub_epi32(lane, first), fifteen);
+        __m256i shift = _mm256_srli_epi32(_mm256_mullo_epi32(h, salt), 27);
+        __m256i bits = _mm256_and_si256(_mm256_sllv_epi32(ones, shift), _mm256_cmpgt_epi32(kk, distance));
+        _mm256_store_si256(reinterpret_cast<__m256i *>(pattern.lanes + 8 * half), bits);
+    }
+}
+
+static inline void SetBlock(uint32_t *block, const BlockPattern &pattern)
+{
+    __m256i *b = reinterpret_cast<__m256i *>(block);
+    const __m256i *p = reinterpret_cast<const __m256i *>(pattern.lanes);
+    _mm256_store_si256(b, _mm256_or_si256(_mm256_load_si256(b), _mm256_load_si256(p)));
+    _mm256_store_si256(b + 1, _mm256_or_si256(_mm256_load_si256(b + 1), _mm256_load_si256(p + 1)));
+}
+
+static inline bool TestBlock(const uint32_t *block, const BlockPattern &pattern)
+{
+    const __m256i *b = reinterpret_cast<const __m256i *>(block);
+    const __m256i *p = reinterpret_cast<const __m256i *>(pattern.lanes);
+    // testc(b, p) == 1 iff (~b & p) == 0
+    return _mm256_testc_si256(_mm256_load_si256(b), _mm256_load_si256(p)) &
+           _mm256_testc_si256(_mm256_load_si256(b + 1), _mm256_load_si256(p + 1));
+}
+
+#elif defined(TSS_RSA_BLOOM_NEON)
+
+static inline void MakePattern(uint32_t key, uint32_t start, size_t k, BlockPattern &pattern)
+{
+    const uint32x4_t ones = vdupq_n_u32(1);
+    const uint32x4_t fifteen = vdupq_n_u32(15);
+    const uint32x4_t h = vdupq_n_u32(key);
+    const uint32x4_t kk = vdupq_n_u32((uint32_t)k);
+    const uint32x4_t first = vdupq_n_u32(start);
+    for (int q = 0; q < 4; q++)
+    {
+        uint32x4_t distance = vandq_u32(vsubq_u32(vld1q_u32(LANE_INDEX + 4 * q), first), fifteen);
+        uint32x4_t shift = vshrq_n_u32(vmulq_u32(h, vld1q_u32(BLOCK_SALT + 4 * q)), 27);
+        uint32x4_t bits = vshlq_u32(ones, vreinterpretq_s32_u32(shift));
+        bits = vandq_u32(bits, vcltq_u32(distance, kk));
+        vst1q_u32(pattern.lanes + 4 * q, bits);
+    }
+}
+
+static inline void SetBlock(uint32_t *block, const BlockPattern &pattern)
+{
+    for (int q = 0; q < 4; q++)
+    {
+        vst1q_u32(block + 4 * q, vorrq_u32(vld1q_u32(block + 4 * q), vld1q_u32(pattern.lanes + 4 * q)));
+    }
+}
+
+static inline bool TestBlock(const uint32_t *block, const BlockPattern &pattern)
+{
+    uint32x4_t miss = vdupq_n_u32(0);
+    for (int q = 0; q < 4; q++)
+    {
+        // bits of the pattern missing from the block: p & ~b
+        miss = vorrq_u32(miss, vbicq_u32(vld1q_u32(pattern.lanes + 4 * q), vld1q_u32(block + 4 * q)));
+    }
+    uint32x2_t folded = vorr_u32(vget_low_u32(miss), vget_high_u32(miss));
+    return vget_lane_u64(vreinterpret_u64_u32(folded), 0) == 0;
+}
+
+#else
+
+static inline void MakePattern(uint32_t key, uint32_t start, size_t k, BlockPattern &pattern)
+{
+    for (uint32_t j = 0; j < 16; j++)
+    {
+        pattern.lanes[j] = ((j - start) & 15) < k ? (uint32_t)1 << ((key * BLOCK_SALT[j]) >> 27) : 0;
+    }
+}
+
+static inline void SetBlock(uint32_t *block, const BlockPattern &pattern)
+{
+    for (size_t j = 0; j < 16; j++)
+    {
+        block[j] |= pattern.lanes[j];
+    }
+}
+
+static inline bool TestBlock(const uint32_t *block, const BlockPattern &pattern)
+{
+    uint32_t miss = 0;
+    for (size_t j = 0; j < 16; j++)
+    {
+        miss |= pattern.lanes[j] & ~block[j];
+    }
+    return miss == 0;
+}
+
+#endif
+
+static inline void PrefetchBlock(const uint32_t *block)
+{
+#if defined(__GNUC__)
+    __builtin_prefetch(block);
+#else
+    (void)block;
+#endif
+}
 
 namespace safeheron
 {
     namespace tss_rsa
     {
-        void update_bloom_filter(Transaction &transaction, std::string json_str)
+        BloomFilter::BloomFilter(BloomHashMode mode)
+            : m_(DEFAULT_M), k_(DEFAULT_K), mode_(mode), words_((DEFAULT_M + 63) / 64, 0) {}
+
+        BloomFilter::BloomFilter(size_t expected_elements, double false_positive_rate, BloomHashMode mode)
+            : mode_(mode)
+        {
+            m_ = OptimalBitCount(expected_elements, false_positive_rate);
+            k_ = OptimalHashCount(m_, expected_elements);
+            words_.assign((m_ + 63) / 64, 0);
+        }
+
+        BloomFilter BloomFilter::Create(size_t m, size_t k, BloomHashMode mode)
+        {
+            if (m == 0 || k == 0)
+            {
+                throw LocatedException(__FILE__, __LINE__, __FUNCTION__, -1, "m == 0 || k == 0");
+            }
+            BloomFilter filter(mode);
+            filter.m_ = m;
+            filter.k_ = k;
+            filter.words_.assign((m + 63) / 64, 0);
+            return filter;
+        }
+
+        size_t BloomFilter::OptimalBitCount(size_t expected_elements, double false_positive_rate)
+        {
+            if (expected_elements == 0)
+            {
+                throw LocatedException(__FILE__, __LINE__, __FUNCTION__, -1, "expected_elements == 0");
+            }
+            if (!(false_positive_rate > 0.0 && false_positive_rate < 1.0))
+            {
+                throw LocatedException(__FILE__, __LINE__, __FUNCTION__, -1, "false_positive_rate is not in (0, 1)");
+            }
+            const double ln2 = std::log(2.0);
+            double m = std::ceil(-(double)expected_elements * std::log(false_positive_rate) / (ln2 * ln2));
+            return m < 1.0 ? 1 : (size_t)m;
+        }
+
+        size_t BloomFilter::OptimalHashCount(size_t m, size_t expected_elements)
+        {
+            if (expected_elements == 0)
+            {
+                throw LocatedException(__FILE__, __LINE__, __FUNCTION__, -1, "expected_elements == 0");
+            }
+            double k = std::round((double)m / (double)expected_elements * std::log(2.0));
+            return k < 1.0 ? 1 : (size_t)k;
+        }
+
+        size_t BloomFilter::m() const
+        {
+            return m_;
+        }
+
+        size_t BloomFilter::k() const
+        {
+            return k_;
+        }
+
+        BloomHashMode BloomFilter::mode() const
+        {
+            return mode_;
+        }
+
+        // Call visit(index) for the k bit indices of element, until it returns false.
+        template <typename Visitor>
+        static bool ForEachIndex(BloomHashMode mode, size_t m, size_t k, const std::string &element, Visitor visit)
+        {
+            if (mode == BloomHashMode::DoubleHashing)
+            {
+                uint64_t h1, h2;
+                Hash128(element.data(), element.size(), 0, h1, h2);
+                // h2 is forced odd so that it never collapses to 0 mod m.
+                h2 |= 1;
+                for (size_t i = 0; i < k; i++)
+                {
+                    if (!visit((size_t)((h1 + i * h2) % m))) return false;
+                }
+                return true;
+            }
+
+            for (size_t i = 0; i < k; i++)
+            {
+                if (!visit(std::hash<std::string>()(std::to_string(i) + element) % m)) return false;
+            }
+            return true;
+        }
+
+        bool BloomFilter::Add(const std::string &element)
+        {
+            std::vector<uint64_t> &words = words_;
+            return ForEachIndex(mode_, m_, k_, element, [&words](size_t index)
+                                {
+                                    words[index / 64] |= (uint64_t)1 << (index % 64);
+                                    return true;
+                                });
+        }
+
+        bool BloomFilter::Contains(const std::string &element) const
+        {
+            return ForEachIndex(mode_, m_, k_, element, [this](size_t index)
+                                { return TestBit(index); });
+        }
+
+        bool BloomFilter::TestBit(size_t i) const
+        {
+            return (words_[i / 64] >> (i % 64)) & 1;
+        }
+
+        void BloomFilter::Clear()
+        {
+            words_.assign(words_.size(), 0);
+        }
+
+        std::string BloomFilter::ToString() const
+        {
+            std::string str(m_, '0');
+            for (size_t i = 0; i < m_; i++)
+            {
+                if (TestBit(i)) str[m_ - 1 - i] = '1';
+            }
+            return str;
+        }
+
+        static void AppendUint32LE(std::string &out, uint32_t v)
+        {
+            for (int i = 0; i < 4; i++)
+            {
+                out.push_back((char)(uint8_t)(v >> (8 * i)));
+            }
+        }
+
+        static uint32_t LoadUint32LE(const char *p)
+        {
+            const uint8_t *b = reinterpret_cast<const uint8_t *>(p);
+            return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+        }
+
+        size_t BloomFilter::SerializedSize() const
+        {
+            return words_.size() * 8 + BloomFilterView::FOOTER_SIZE;
+        }
+
+        void BloomFilter::AppendTo(std::string &out) const
+        {
+            if (m_ > 0xFFFFFFFFU || k_ > 0xFFFFFFFFU)
+            {
+                throw LocatedException(__FILE__, __LINE__, __FUNCTION__, -1, "m or k does not fit in 32 bits");
+            }
+            out.reserve(out.size() + SerializedSize());
+            for (uint64_t word : words_)
+            {
+                for (int i = 0; i < 8; i++)
+                {
+                    out.push_back((char)(uint8_t)(word >> (8 * i)));
+                }
+            }
+            AppendUint32LE(out, (uint32_t)m_);
+            AppendUint32LE(out, (uint32_t)k_);
+            out.push_back((char)BloomFilterView::VERSION);
+        }
+
+        const uint8_t BloomFilterView::VERSION;
+        const size_t BloomFilterView::FOOTER_SIZE;
+
+        bool BloomFilterView::Parse(const char *data, size_t size, BloomFilterView &view)
+        {
+            if (data == nullptr || size < FOOTER_SIZE || (uint8_t)data[size - 1] != VERSION) return false;
+            const char *footer = data + size - FOOTER_SIZE;
+            size_t m = LoadUint32LE(footer);
+            size_t k = LoadUint32LE(footer + 4);
+            if (m == 0 || k == 0 || size != (m + 63) / 64 * 8 + FOOTER_SIZE) return false;
+            view.data_ = data;
+            view.size_ = size;
+            view.m_ = m;
+            view.k_ = k;
+            return true;
+        }
+
+        bool BloomFilterView::ParseTrailer(const char *data, size_t size, BloomFilterView &view)
+        {
+            if (data == nullptr || size < FOOTER_SIZE) return false;
+            uint64_t m = LoadUint32LE(data + size - FOOTER_SIZE);
+            uint64_t encoded_size = (m + 63) / 64 * 8 + FOOTER_SIZE;
+            if (encoded_size > size) return false;
+            return Parse(data + size - (size_t)encoded_size, (size_t)encoded_size, view);
+        }
+
+        bool BloomFilterView::valid() const
+        {
+            return data_ != nullptr;
+        }
+
+        size_t BloomFilterView::m() const
+        {
+            return m_;
+        }
+
+        size_t BloomFilterView::k() const
+        {
+            return k_;
+        }
+
+        const char *BloomFilterView::data() const
+        {
+            return data_;
+        }
+
+        size_t BloomFilterView::size() const
+        {
+            return size_;
+        }
+
+        bool BloomFilterView::TestBit(size_t i) const
+        {
+            // Little endian words: bit i is bit i % 8 of byte i / 8.
+            return ((uint8_t)data_[i / 8] >> (i % 8)) & 1;
+        }
+
+        bool BloomFilterView::Contains(const std::string &element, BloomHashMode mode) const
+        {
+            if (!valid()) return false;
+            return ForEachIndex(mode, m_, k_, element, [this](size_t index)
+                                { return TestBit(index); });
+        }
+
+        BloomFilter BloomFilterView::ToBloomFilter(BloomHashMode mode) const
+        {
+            if (!valid())
+            {
+                throw LocatedException(__FILE__, __LINE__, __FUNCTION__, -1, "invalid view");
+            }
+            BloomFilter filter = BloomFilter::Create(m_, k_, mode);
+            const char *p = data_;
+            for (size_t w = 0; w < filter.words_.size(); w++)
+            {
+                uint64_t word = 0;
+                for (int i = 0; i < 8; i++)
+                {
+                    word |= (uint64_t)(uint8_t)p[8 * w + i] << (8 * i);
+                }
+                filter.words_[w] = word;
+            }
+            return filter;
+        }
+
+        void update_bloom_filter(Transaction &transaction, const std::string &json_str)
+        {
+            transaction.bloom_filter.Add(json_str);
+        }
+
+        void append_bloom_filter(Transaction &transaction)
+        {
+            transaction.bloom_filter.AppendTo(transaction.data);
+        }
+
+        BloomFilterView extract_bloom_filter(const Transaction &transaction)
+        {
+            BloomFilterView view;
+            BloomFilterView::ParseTrailer(transaction.data.data(), transaction.data.size(), view);
+            return view;
+        }
+
+        const size_t BlockedBloomFilter::BLOCK_BITS;
+        const size_t BlockedBloomFilter::BLOCK_LANES;
+        const size_t BlockedBloomFilter::MAX_K;
+
+        BlockedBloomFilter::BlockedBloomFilter(size_t expected_elements, double false_positive_rate)
+        {
+            size_t m = BloomFilter::OptimalBitCount(expected_elements, false_positive_rate);
+            block_count_ = (m + BLOCK_BITS - 1) / BLOCK_BITS;
+            k_ = BloomFilter::OptimalHashCount(block_count_ * BLOCK_BITS, expected_elements);
+            if (k_ > MAX_K) k_ = MAX_K;
+            lanes_.assign(block_count_ * BLOCK_LANES, 0);
+        }
+
+        BlockedBloomFilter BlockedBloomFilter::Create(size_t block_count, size_t k)
+        {
+            if (block_count == 0 || k == 0 || k > MAX_K)
+            {
+                throw LocatedException(__FILE__, __LINE__, __FUNCTION__, -1, "block_count == 0 || k == 0 || k > 16");
+            }
+            BlockedBloomFilter filter;
+            filter.block_count_ = block_count;
+            filter.k_ = k;
+            filter.lanes_.assign(block_count * BLOCK_LANES, 0);
+            return filter;
+        }
+
+        size_t BlockedBloomFilter::m() const
+        {
+            return block_count_ * BLOCK_BITS;
+        }
+
+        size_t BlockedBloomFilter::k() const
+        {
+            return k_;
+        }
+
+        size_t BlockedBloomFilter::block_count() const
+        {
+            return block_count_;
+        }
+
+        bool BlockedBloomFilter::Add(const std::string &element)
         {
-            // std::cout << "json_str: " << json_str << std::endl;
-            for (int i = 0; i < K; i++)
+            uint64_t h1, h2;
+            Hash128(element.data(), element.size(), 0, h1, h2);
+            BlockPattern pattern;
+            MakePattern((uint32_t)h2, (uint32_t)(h2 >> 32) & 15, k_, pattern);
+            SetBlock(&lanes_[(h1 % block_count_) * BLOCK_LANES], pattern);
+            return true;
+        }
+
+        bool BlockedBloomFilter::Contains(const std::string &element) const
+        {
+            uint64_t h1, h2;
+            Hash128(element.data(), element.size(), 0, h1, h2);
+            BlockPattern pattern;
+            MakePattern((uint32_t)h2, (uint32_t)(h2 >> 32) & 15, k_, pattern);
+            return TestBlock(&lanes_[(h1 % block_count_) * BLOCK_LANES], pattern);
+        }
+
+        void BlockedBloomFilter::TestMany(const std::vector<std::string> &elements, std::vector<uint8_t> &results) const
+        {
+            results.resize(elements.size());
+            // Elements are processed in groups: hash the whole group and prefetch its blocks, then test.
+            const size_t GROUP = 16;
+            size_t block_index[GROUP];
+            uint64_t key[GROUP];
+            for (size_t base = 0; base < elements.size(); base += GROUP)
             {
-                hash_indices[i] = std::hash<std::string>()(std::to_string(i) + json_str) % M;
+                size_t n = elements.size() - base < GROUP ? elements.size() - base : GROUP;
+                for (size_t i = 0; i < n; i++)
+                {
+                    uint64_t h1, h2;
+                    Hash128(elements[base + i].data(), elements[base + i].size(), 0, h1, h2);
+                    block_index[i] = (size_t)(h1 % block_count_);
+                    key[i] = h2;
+                    PrefetchBlock(&lanes_[block_index[i] * BLOCK_LANES]);
+                }
+                for (size_t i = 0; i < n; i++)
+                {
+                    BlockPattern pattern;
+                    MakePattern((uint32_t)key[i], (uint32_t)(key[i] >> 32) & 15, k_, pattern);
+                    results[base + i] = TestBlock(&lanes_[block_index[i] * BLOCK_LANES], pattern) ? 1 : 0;
+                }
             }
+        }
+
+        void BlockedBloomFilter::TestMany(const std::string &element,
+                                          const std::vector<const BlockedBloomFilter *> &filters,
+                                          std::vector<uint8_t> &results)
+        {
+            results.resize(filters.size());
+            uint64_t h1, h2;
+            Hash128(element.data(), element.size(), 0, h1, h2);
 
-            for (int index : hash_indices)
+            // Filters built with the same k share the pattern, so it is only rebuilt when k changes.
+            BlockPattern pattern = BlockPattern();
+            size_t pattern_k = 0;
+            for (size_t i = 0; i < filters.size(); i++)
+            {
+                PrefetchBlock(&filters[i]->lanes_[(h1 % filters[i]->block_count_) * BLOCK_LANES]);
+            }
+            for (size_t i = 0; i < filters.size(); i++)
             {
-                transaction.bloom_filter.set(index);
+                const BlockedBloomFilter *filter = filters[i];
+                if (filter->k_ != pattern_k)
+                {
+                    MakePattern((uint32_t)h2, (uint32_t)(h2 >> 32) & 15, filter->k_, pattern);
+                    pattern_k = filter->k_;
+                }
+                results[i] = TestBlock(&filter->lanes_[(h1 % filter->block_count_) * BLOCK_LANES], pattern) ? 1 : 0;
             }
         }
 
-        std::string extract_bloom_filter(Transaction &transaction)
+        void BlockedBloomFilter::Clear()
         {
-            return transaction.data.substr(transaction.data.size() - transaction.bloom_filter.size(), transaction.data.size());
+            lanes_.assign(lanes_.size(), 0);
         }
     } // namespace tss_rsa
-} // namespace safeheron
\ No newline at end of file
+} // namespace safeheron
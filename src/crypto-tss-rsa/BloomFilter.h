@@ -1,33 +1,382 @@
 #ifndef TSS_RSA_BLOOMFILTER_H
 #define TSS_RSA_BLOOMFILTER_H
 
-#include <bitset>
-#include <iostream>
+#include <cstddef>
+#include <cstdint>
+#include <new>
 #include <string>
 #include <vector>
-// #include <openssl/sha.h>
+#include "MembershipFilter.h"
 
-// Size of the bloom filter
-const int M = 48;
-// Number of hash functions
-const int K = 17;
+namespace safeheron
+{
+    namespace tss_rsa
+    {
+        /**
+         * How the k bit indices of an element are derived.
+         */
+        enum class BloomHashMode
+        {
+            /**
+             * Hash std::to_string(i) + element with std::hash for every i.
+             * k passes over the element, and the indices depend on the standard library in use.
+             */
+            StdHash,
+            /**
+             * Kirsch-Mitzenmacher double hashing: hash the element once with MurmurHash3_x64_128,
+             * split the digest into h1 and h2, and use index_i = (h1 + i * h2) mod m.
+             * The indices are the same on every platform.
+             */
+            DoubleHashing
+        };
+
+        class BloomFilterView;
+
+        /**
+         * A Bloom filter whose bit count m and hash count k are chosen at runtime.
+         *
+         * The filter owns all of its state, so distinct filters can be updated from different
+         * threads concurrently, and a single filter can be queried concurrently as long as
+         * nobody adds to it at the same time.
+         */
+        class BloomFilter : public MembershipFilter
+        {
+        public:
+            /**
+             * Constructor.
+             * Create a filter with the historical parameters m = 48, k = 17.
+             * @param[in] mode index derivation mode
+             */
+            explicit BloomFilter(BloomHashMode mode = BloomHashMode::DoubleHashing);
+
+            /**
+             * Constructor.
+             * Pick m and k for the expected number of elements and the target false positive rate.
+             * @param[in] expected_elements expected number of elements, > 0
+             * @param[in] false_positive_rate target false positive rate, in (0, 1)
+             * @param[in] mode index derivation mode
+             */
+            BloomFilter(size_t expected_elements, double false_positive_rate,
+                        BloomHashMode mode = BloomHashMode::DoubleHashing);
+
+            /**
+             * Create a filter with explicit parameters.
+             * @param[in] m number of bits, > 0
+             * @param[in] k number of hash functions, > 0
+             * @param[in] mode index derivation mode
+             * @return a BloomFilter object.
+             */
+            static BloomFilter Create(size_t m, size_t k, BloomHashMode mode = BloomHashMode::DoubleHashing);
+
+            /**
+             * Optimal number of bits: m = ceil(-n * ln(p) / ln(2)^2)
+             * @param[in] expected_elements n
+             * @param[in] false_positive_rate p
+             * @return m
+             */
+            static size_t OptimalBitCount(size_t expected_elements, double false_positive_rate);
+
+            /**
+             * Optimal number of hash functions: k = round(m / n * ln(2))
+             * @param[in] m number of bits
+             * @param[in] expected_elements n
+             * @return k
+             */
+            static size_t OptimalHashCount(size_t m, size_t expected_elements);
+
+            size_t m() const;
+            size_t k() const;
+            BloomHashMode mode() const;
+
+            /**
+             * Insert an element.
+             * @param[in] element
+             * @return true, a Bloom filter never refuses an element.
+             */
+            bool Add(const std::string &element) override;
+
+            /**
+             * Test whether an element may have been inserted.
+             * @param[in] element
+             * @return false if the element is definitely absent, true if it may be present.
+             */
+            bool Contains(const std::string &element) const override;
+
+            /**
+             * Test bit i.
+             * @param[in] i bit index, i < m
+             * @return true if the bit is set.
+             */
+            bool TestBit(size_t i) const;
+
+            /**
+             * Reset all the bits.
+             */
+            void Clear() override;
+
+            /**
+             * Render the filter as '0'/'1' characters, bit m-1 first (same layout as std::bitset::to_string).
+             * @return the string.
+             */
+            std::string ToString() const;
+
+            /**
+             * Size of the binary encoding produced by AppendTo().
+             * @return 8 * ceil(m / 64) + 9
+             */
+            size_t SerializedSize() const;
+
+            /**
+             * Append the binary encoding of the filter:
+             *     bit words (uint64, little endian) | m (uint32, little endian) | k (uint32, little endian) | version (1 byte)
+             * Bit i of the filter is bit (i % 8) of byte i / 8 of the word array.
+             * m and k come last, so that the encoding can be found at the end of a buffer without knowing them.
+             * The hash mode is not encoded.
+             * @param[out] out string to append to
+             */
+            void AppendTo(std::string &out) const;
+
+        private:
+            friend class BloomFilterView;
+
+            size_t m_;                    /**< number of bits */
+            size_t k_;                    /**< number of hash functions */
+            BloomHashMode mode_;          /**< index derivation mode */
+            std::vector<uint64_t> words_; /**< bit storage, bit i lives in words_[i / 64] */
+        };
+
+        /**
+         * A read-only, non-owning view of a binary encoded BloomFilter (see BloomFilter::AppendTo).
+         * Queries read the bits straight from the underlying buffer, which must outlive the view.
+         */
+        class BloomFilterView
+        {
+        public:
+            static const uint8_t VERSION = 2;
+            static const size_t FOOTER_SIZE = 9;
+
+            /**
+             * Constructor. An empty, invalid view.
+             */
+            BloomFilterView() : data_(nullptr), size_(0), m_(0), k_(0) {}
+
+            /**
+             * Parse an encoded filter.
+             * @param[in] data encoded filter
+             * @param[in] size length of data, must be the exact encoded size
+             * @param[out] view the view over data
+             * @return true on success, false if the header is invalid or does not match size.
+             */
+            static bool Parse(const char *data, size_t size, BloomFilterView &view);
+
+            /**
+             * Parse the encoded filter that ends a buffer, such as a transaction with a filter appended.
+             * The encoded size is read from the footer, m and k of the receiving side are not needed.
+             * @param[in] data buffer
+             * @param[in] size length of the buffer
+             * @param[out] view the view over the end of data
+             * @return true on success, false if the buffer does not end with a valid encoding.
+             */
+            static bool ParseTrailer(const char *data, size_t size, BloomFilterView &view);
+
+            bool valid() const;
+            size_t m() const;
+            size_t k() const;
+
+            /**
+             * @return pointer to the first byte of the encoding
+             */
+            const char *data() const;
+
+            /**
+             * @return length of the encoding
+             */
+            size_t size() const;
+
+            /**
+             * Test bit i.
+             * @param[in] i bit index, i < m
+             * @return true if the bit is set.
+             */
+            bool TestBit(size_t i) const;
+
+            /**
+             * Test whether an element may have been inserted.
+             * @param[in] element
+             * @param[in] mode index derivation mode the filter was built with
+             * @return false if the element is definitely absent, true if it may be present.
+             */
+            bool Contains(const std::string &element, BloomHashMode mode = BloomHashMode::DoubleHashing) const;
+
+            /**
+             * Copy the view into an owning filter.
+             * @param[in] mode index derivation mode the filter was built with
+             * @return a BloomFilter object.
+             */
+            BloomFilter ToBloomFilter(BloomHashMode mode = BloomHashMode::DoubleHashing) const;
+
+        private:
+            const char *data_; /**< encoding, not owned */
+            size_t size_;      /**< length of the encoding */
+            size_t m_;         /**< number of bits */
+            size_t k_;         /**< number of hash functions */
+        };
+
+        /**
+         * Allocator returning 64-byte aligned storage, so that every block of a BlockedBloomFilter
+         * sits in a single cache line and can be loaded with aligned SIMD loads.
+         */
+        template <typename T>
+        struct CacheLineAllocator
+        {
+            typedef T value_type;
+            static const size_t ALIGNMENT = 64;
+
+            template <typename U>
+            struct rebind
+            {
+                typedef CacheLineAllocator<U> other;
+            };
+
+            CacheLineAllocator() {}
+
+            template <typename U>
+            CacheLineAllocator(const CacheLineAllocator<U> &) {}
+
+            T *allocate(size_t n)
+            {
+                // Keep the pointer returned by operator new just in front of the aligned block.
+                uint8_t *raw = static_cast<uint8_t *>(::operator new(n * sizeof(T) + ALIGNMENT + sizeof(void *)));
+                uintptr_t aligned = (reinterpret_cast<uintptr_t>(raw) + sizeof(void *) + ALIGNMENT - 1) & ~(uintptr_t)(ALIGNMENT - 1);
+                reinterpret_cast<void **>(aligned)[-1] = raw;
+                return reinterpret_cast<T *>(aligned);
+            }
+
+            void deallocate(T *p, size_t)
+            {
+                ::operator delete(reinterpret_cast<void **>(p)[-1]);
+            }
+
+            template <typename U>
+            bool operator==(const CacheLineAllocator<U> &) const { return true; }
+
+            template <typename U>
+            bool operator!=(const CacheLineAllocator<U> &) const { return false; }
+        };
+
+        /**
+         * A blocked (split block) Bloom filter.
+         *
+         * The bit array is cut into 64-byte blocks, one cache line each, viewed as 16 lanes of 32 bits.
+         * An element picks one block and a start lane from its hash, and sets one bit in each of the k lanes
+         * start, start + 1, ..., start + k - 1 (mod 16), k <= 16, so an insert or a query touches a single
+         * cache line. Rotating the start spreads the bits over all 16 lanes when k < 16. The per-lane bit
+         * patterns are computed and applied with AVX2 or NEON when the library is built for it, and with
+         * scalar code otherwise; all three produce the same bits.
+         */
+        class BlockedBloomFilter : public MembershipFilter
+        {
+        public:
+            static const size_t BLOCK_BITS = 512;
+            static const size_t BLOCK_LANES = 16;
+            static const size_t MAX_K = BLOCK_LANES;
+
+            /**
+             * Constructor.
+             * Pick m and k for the expected number of elements and the target false positive rate.
+             * m is rounded up to a whole number of blocks, and k is capped at 16.
+             * @param[in] expected_elements expected number of elements, > 0
+             * @param[in] false_positive_rate target false positive rate, in (0, 1)
+             */
+            BlockedBloomFilter(size_t expected_elements, double false_positive_rate);
+
+            /**
+             * Create a filter with explicit parameters.
+             * @param[in] block_count number of 512-bit blocks, > 0
+             * @param[in] k number of hash functions, in [1, 16]
+             * @return a BlockedBloomFilter object.
+             */
+            static BlockedBloomFilter Create(size_t block_count, size_t k);
+
+            size_t m() const;
+            size_t k() const;
+            size_t block_count() const;
+
+            /**
+             * Insert an element.
+             * @param[in] element
+             * @return true, a Bloom filter never refuses an element.
+             */
+            bool Add(const std::string &element) override;
+
+            /**
+             * Test whether an element may have been inserted.
+             * @param[in] element
+             * @return false if the element is definitely absent, true if it may be present.
+             */
+            bool Contains(const std::string &element) const override;
+
+            /**
+             * Test N elements against this filter.
+             * All the elements are hashed first and their blocks prefetched before any of them is tested.
+             * @param[in] elements elements to test
+             * @param[out] results results[i] is 1 if elements[i] may be present, 0 otherwise
+             */
+            void TestMany(const std::vector<std::string> &elements, std::vector<uint8_t> &results) const;
+
+            /**
+             * Test one element against N filters.
+             * The element is hashed and its bit pattern built once, then matched against a block of every filter.
+             * @param[in] element element to test
+             * @param[in] filters filters to test against
+             * @param[out] results results[i] is 1 if element may be present in filters[i], 0 otherwise
+             */
+            static void TestMany(const std::string &element,
+                                 const std::vector<const BlockedBloomFilter *> &filters,
+                                 std::vector<uint8_t> &results);
+
+            /**
+             * Reset all the bits.
+             */
+            void Clear() override;
+
+        private:
+            BlockedBloomFilter() : block_count_(0), k_(0) {}
+
+            size_t block_count_; /**< number of 512-bit blocks */
+            size_t k_;           /**< number of hash functions */
+            std::vector<uint32_t, CacheLineAllocator<uint32_t> > lanes_; /**< block i is lanes_[16 * i, 16 * i + 16) */
+        };
+    } // namespace tss_rsa
+} // namespace safeheron
 
 // Transaction structure
 struct Transaction
 {
-    std::bitset<M> bloom_filter;
+    safeheron::tss_rsa::BloomFilter bloom_filter;
     std::string data;
 };
 
-std::vector<int> hash_indices(K);
-
 namespace safeheron
 {
     namespace tss_rsa
     {
-        void update_bloom_filter(Transaction &transaction, std::string json_str);
-        std::string extract_bloom_filter(Transaction &transaction);
+        void update_bloom_filter(Transaction &transaction, const std::string &json_str);
+
+        /**
+         * Append the binary encoding of transaction.bloom_filter to transaction.data.
+         * @param[in,out] transaction
+         */
+        void append_bloom_filter(Transaction &transaction);
+
+        /**
+         * Locate the encoded filter at the end of transaction.data, without copying it.
+         * The encoded size is read from the footer of the encoding, see BloomFilterView::ParseTrailer.
+         * @param[in] transaction
+         * @return a view into transaction.data, invalid if there is no matching trailer.
+         */
+        BloomFilterView extract_bloom_filter(const Transaction &transaction);
     } // namespace tss_rsa
 } // namespace safeheron
 
-#endif // TSS_RSA_BLOOMFILTER_H
\ No newline at end of file
+#endif // TSS_RSA_BLOOMFILTER_H
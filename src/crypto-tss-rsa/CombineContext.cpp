@@ -0,0 +1,139 @@
+#include "CombineContext.h"
+#include "common.h"
+
+using safeheron::bignum::BN;
+
+namespace safeheron {
+namespace tss_rsa{
+
+CombineContext::CombineContext(const RSAPublicKey &public_key, const RSAKeyMeta &key_meta,
+                               size_t lagrange_cache_capacity)
+        : public_key_(public_key), key_meta_(key_meta), lagrange_capacity_(lagrange_cache_capacity),
+          lagrange_hits_(0), lagrange_misses_(0){
+    const BN &n = public_key_.n();
+    mont_ = public_key_.mont();
+    if(!mont_) mont_ = std::make_shared<MontgomeryContext>(n);
+
+    // Compute \Delta = l!
+    delta_ = BN(1);
+    for(int i = 1; i <= key_meta_.l(); i++){
+        delta_ *= i;
+    }
+
+    // e' is always set to 4.
+    BN d;
+    BN::ExtendedEuclidean(BN(4), public_key_.e(), a_, b_, d);
+
+    vku_e_ = mont_->PowM(key_meta_.vku(), public_key_.e());
+    vku_inv_ = key_meta_.vku().InvM(n);
+}
+
+const RSAPublicKey &CombineContext::public_key() const {
+    return public_key_;
+}
+
+const RSAKeyMeta &CombineContext::key_meta() const {
+    return key_meta_;
+}
+
+const MontgomeryContext &CombineContext::mont() const {
+    return *mont_;
+}
+
+const BN &CombineContext::delta() const {
+    return delta_;
+}
+
+const BN &CombineContext::a() const {
+    return a_;
+}
+
+const BN &CombineContext::b() const {
+    return b_;
+}
+
+const BN &CombineContext::vku_e() const {
+    return vku_e_;
+}
+
+const BN &CombineContext::vku_inv() const {
+    return vku_inv_;
+}
+
+bool CombineContext::SignerMask(const std::vector<int> &S, int l, std::vector<uint64_t> &mask) {
+    mask.assign((size_t)l / 64 + 1, 0);
+    for(int j : S){
+        if(j < 1 || j > l) return false;
+        uint64_t bit = (uint64_t)1 << (j % 64);
+        if(mask[j / 64] & bit) return false;
+        mask[j / 64] |= bit;
+    }
+    return true;
+}
+
+std::shared_ptr<const std::vector<BN>> CombineContext::LagrangeExponents(const std::vector<int> &S) const {
+    for(size_t t = 1; t < S.size(); t++){
+        if(S[t - 1] >= S[t]) return nullptr;
+    }
+    std::vector<uint64_t> mask;
+    if(!SignerMask(S, key_meta_.l(), mask)) return nullptr;
+    return LagrangeExponents(mask);
+}
+
+std::shared_ptr<const std::vector<BN>> CombineContext::LagrangeExponents(const std::vector<uint64_t> &mask) const {
+    // Party 0 and the parties beyond l have no share
+    const int l = key_meta_.l();
+    if(mask.size() != (size_t)l / 64 + 1 || (mask[0] & 1)) return nullptr;
+    if((l + 1) % 64 != 0 && (mask.back() >> ((l + 1) % 64)) != 0) return nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = lagrange_.find(mask);
+        if(it != lagrange_.end()){
+            lagrange_hits_++;
+            lagrange_lru_.splice(lagrange_lru_.begin(), lagrange_lru_, it->second);
+            return it->second->second;
+        }
+        lagrange_misses_++;
+    }
+
+    std::vector<BN> S_bn;
+    for(size_t w = 0; w < mask.size(); w++){
+        for(int bit = 0; bit < 64; bit++){
+            if(mask[w] & ((uint64_t)1 << bit)) S_bn.emplace_back(BN((int)(w * 64 + bit)));
+        }
+    }
+    std::shared_ptr<std::vector<BN>> exps = std::make_shared<std::vector<BN>>();
+    for(const auto &j : S_bn){
+        exps->emplace_back(lambda(BN(0), j, S_bn, delta_) * 2);
+    }
+    if(lagrange_capacity_ == 0) return exps;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = lagrange_.find(mask);
+    if(it != lagrange_.end()) return it->second->second;  // inserted by a concurrent miss
+    lagrange_lru_.emplace_front(mask, exps);
+    lagrange_[mask] = lagrange_lru_.begin();
+    if(lagrange_lru_.size() > lagrange_capacity_){
+        lagrange_.erase(lagrange_lru_.back().first);
+        lagrange_lru_.pop_back();
+    }
+    return exps;
+}
+
+size_t CombineContext::lagrange_cache_size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lagrange_lru_.size();
+}
+
+uint64_t CombineContext::lagrange_cache_hits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lagrange_hits_;
+}
+
+uint64_t CombineContext::lagrange_cache_misses() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lagrange_misses_;
+}
+
+};
+};
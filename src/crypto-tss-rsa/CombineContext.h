@@ -0,0 +1,119 @@
+#ifndef SAFEHERON_TSS_RSA_COMBINE_CONTEXT_H
+#define SAFEHERON_TSS_RSA_COMBINE_CONTEXT_H
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "crypto-bn/bn.h"
+#include "RSAPublicKey.h"
+#include "RSAKeyMeta.h"
+#include "MontgomeryContext.h"
+
+namespace safeheron {
+namespace tss_rsa{
+
+/**
+ * Everything InternalCombineSignatures needs that depends on the key only, so that a combiner working
+ * under a long-lived key computes it once instead of once per signature:
+ *  - \Delta = l!
+ *  - a, b such that 4a + eb = 1
+ *  - vku^e mod n and vku^-1 mod n
+ *  - the Montgomery context of n
+ *  - 2 \lambda_{0,j}^S for every j in S, memoized per signer subset S.
+ *
+ * The fixed-base tables of the share proofs are not built here: the first combination that verifies the
+ * shares builds them, through RSAKeyMeta::Precompute of the key meta copy held by the context.
+ *
+ * The memo is a least recently used cache keyed by the bitmask of S, bounded by the capacity given to the
+ * constructor, with hit and miss counters.
+ *
+ * The object is safe to share between threads.
+ */
+class CombineContext{
+public:
+    /**
+     * Constructor.
+     * @param[in] public_key public key
+     * @param[in] key_meta key meta data
+     * @param[in] lagrange_cache_capacity maximum number of signer subsets in the memo, 0 to disable it
+     */
+    CombineContext(const RSAPublicKey &public_key, const RSAKeyMeta &key_meta,
+                   size_t lagrange_cache_capacity = 64);
+
+    const RSAPublicKey &public_key() const;
+    const RSAKeyMeta &key_meta() const;
+    const MontgomeryContext &mont() const;
+
+    const bignum::BN &delta() const;
+    const bignum::BN &a() const;
+    const bignum::BN &b() const;
+    const bignum::BN &vku_e() const;
+    const bignum::BN &vku_inv() const;
+
+    /**
+     * Exponents 2 \lambda_{0,j}^S of the shares, computed on the first call for a given subset S.
+     * @param[in] S indices of the signers, starting from 1, sorted in increasing order and without duplicates
+     * @return exps, where exps[t] is the exponent of the share of party S[t]; nullptr if an index is out of
+     *         (1, ... ,l), or S is not strictly increasing: an unsorted S is rejected, not sorted.
+     */
+    std::shared_ptr<const std::vector<bignum::BN>> LagrangeExponents(const std::vector<int> &S) const;
+
+    /**
+     * Exponents 2 \lambda_{0,j}^S of the shares, computed on the first call for a given subset S.
+     * @param[in] mask bitmask of S, see SignerMask
+     * @return exps, where exps[t] is the exponent of the share of the t-th party of S in increasing order;
+     *         nullptr if the mask is not the size SignerMask gives, or has a bit out of (1, ... ,l).
+     */
+    std::shared_ptr<const std::vector<bignum::BN>> LagrangeExponents(const std::vector<uint64_t> &mask) const;
+
+    /**
+     * Bitmask of a signer subset: bit j % 64 of word j / 64 is set for every party j of S.
+     * @param[in] S indices of the signers, starting from 1, in any order
+     * @param[in] l number of parties
+     * @param[out] mask
+     * @return false if an index is out of (1, ... ,l) or appears twice.
+     */
+    static bool SignerMask(const std::vector<int> &S, int l, std::vector<uint64_t> &mask);
+
+    /**
+     * @return number of signer subsets in the memo.
+     */
+    size_t lagrange_cache_size() const;
+
+    /**
+     * @return number of calls to LagrangeExponents served from the memo.
+     */
+    uint64_t lagrange_cache_hits() const;
+
+    /**
+     * @return number of calls to LagrangeExponents that computed the exponents.
+     */
+    uint64_t lagrange_cache_misses() const;
+
+private:
+    RSAPublicKey public_key_;
+    RSAKeyMeta key_meta_;
+    std::shared_ptr<const MontgomeryContext> mont_;
+    bignum::BN delta_;    /**< l! */
+    bignum::BN a_;        /**< 4a + eb = 1 */
+    bignum::BN b_;
+    bignum::BN vku_e_;    /**< vku^e mod n */
+    bignum::BN vku_inv_;  /**< vku^-1 mod n */
+
+    typedef std::pair<std::vector<uint64_t>, std::shared_ptr<const std::vector<bignum::BN>>> LagrangeEntry;
+
+    size_t lagrange_capacity_;
+    mutable std::mutex mutex_;
+    mutable std::list<LagrangeEntry> lagrange_lru_;   /**< most recently used first */
+    mutable std::map<std::vector<uint64_t>, std::list<LagrangeEntry>::iterator> lagrange_;
+    mutable uint64_t lagrange_hits_;
+    mutable uint64_t lagrange_misses_;
+};
+
+};
+};
+
+#endif //SAFEHERON_TSS_RSA_COMBINE_CONTEXT_H
@@ -0,0 +1,173 @@
+#include "CuckooFilter.h"
+#include "exception/located_exception.h"
+#include "filter_hash.h"
+
+using safeheron::exception::LocatedException;
+
+namespace safeheron {
+namespace tss_rsa{
+
+const size_t CuckooFilter::ENTRIES_PER_BUCKET;
+const size_t CuckooFilter::MAX_KICKS;
+
+// Round up to the next power of 2.
+static size_t NextPowerOf2(size_t i) {
+    size_t p = 1;
+    while (p < i) p <<= 1;
+    return p;
+}
+
+CuckooFilter::CuckooFilter(size_t capacity)
+        : size_(0), has_victim_(false), victim_index_(0), victim_fingerprint_(0),
+          rng_state_(0x9e3779b97f4a7c15ULL) {
+    if (capacity == 0) {
+        throw LocatedException(__FILE__, __LINE__, __FUNCTION__, -1, "capacity == 0");
+    }
+    // Following the reference implementation, keep the expected load factor under 96%.
+    size_t bucket_count = NextPowerOf2((capacity + ENTRIES_PER_BUCKET - 1) / ENTRIES_PER_BUCKET);
+    if ((double)capacity / (double)bucket_count / ENTRIES_PER_BUCKET > 0.96) {
+        bucket_count <<= 1;
+    }
+    buckets_.assign(bucket_count, 0);
+    mask_ = bucket_count - 1;
+}
+
+size_t CuckooFilter::size() const {
+    return size_;
+}
+
+size_t CuckooFilter::bucket_count() const {
+    return buckets_.size();
+}
+
+size_t CuckooFilter::capacity() const {
+    return buckets_.size() * ENTRIES_PER_BUCKET;
+}
+
+void CuckooFilter::Hashes(const std::string &element, size_t &i1, size_t &i2, uint8_t &fingerprint) const {
+    uint64_t h1, h2;
+    Hash128(element.data(), element.size(), 0, h1, h2);
+    // Fingerprint 0 is reserved for empty entries.
+    fingerprint = (uint8_t)(h2 % 255 + 1);
+    i1 = (size_t)h1 & mask_;
+    i2 = AltIndex(i1, fingerprint);
+}
+
+size_t CuckooFilter::AltIndex(size_t index, uint8_t fingerprint) const {
+    // An involution: AltIndex(AltIndex(i, f), f) == i
+    return (index ^ ((size_t)fingerprint * 0x5bd1e995)) & mask_;
+}
+
+uint8_t CuckooFilter::Entry(size_t index, size_t slot) const {
+    return (uint8_t)(buckets_[index] >> (slot * 8));
+}
+
+void CuckooFilter::SetEntry(size_t index, size_t slot, uint8_t fingerprint) {
+    buckets_[index] = (buckets_[index] & ~((uint32_t)0xff << (slot * 8))) | ((uint32_t)fingerprint << (slot * 8));
+}
+
+bool CuckooFilter::InsertToBucket(size_t index, uint8_t fingerprint) {
+    for (size_t slot = 0; slot < ENTRIES_PER_BUCKET; slot++) {
+        if (Entry(index, slot) == 0) {
+            SetEntry(index, slot, fingerprint);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CuckooFilter::BucketContains(size_t index, uint8_t fingerprint) const {
+    // Look for a zero byte in bucket ^ (f f f f), all four entries at once.
+    uint32_t x = buckets_[index] ^ ((uint32_t)fingerprint * 0x01010101U);
+    return ((x - 0x01010101U) & ~x & 0x80808080U) != 0;
+}
+
+bool CuckooFilter::RemoveFromBucket(size_t index, uint8_t fingerprint) {
+    for (size_t slot = 0; slot < ENTRIES_PER_BUCKET; slot++) {
+        if (Entry(index, slot) == fingerprint) {
+            SetEntry(index, slot, 0);
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t CuckooFilter::NextRandom() {
+    // xorshift64*
+    rng_state_ ^= rng_state_ >> 12;
+    rng_state_ ^= rng_state_ << 25;
+    rng_state_ ^= rng_state_ >> 27;
+    return rng_state_ * 0x2545f4914f6cdd1dULL;
+}
+
+void CuckooFilter::InsertFingerprint(size_t index, uint8_t fingerprint) {
+    size_t alt = AltIndex(index, fingerprint);
+    if (InsertToBucket(index, fingerprint) || InsertToBucket(alt, fingerprint)) return;
+
+    // Both buckets are full: kick a random entry out to its alternate bucket, and repeat.
+    size_t cur = (NextRandom() & 1) ? index : alt;
+    for (size_t kick = 0; kick < MAX_KICKS; kick++) {
+        size_t slot = (size_t)(NextRandom() % ENTRIES_PER_BUCKET);
+        uint8_t evicted = Entry(cur, slot);
+        SetEntry(cur, slot, fingerprint);
+        fingerprint = evicted;
+        cur = AltIndex(cur, fingerprint);
+        if (InsertToBucket(cur, fingerprint)) return;
+    }
+
+    // Keep the homeless fingerprint aside rather than dropping an element.
+    has_victim_ = true;
+    victim_index_ = cur;
+    victim_fingerprint_ = fingerprint;
+}
+
+bool CuckooFilter::Add(const std::string &element) {
+    if (has_victim_) return false;
+
+    size_t i1, i2;
+    uint8_t fingerprint;
+    Hashes(element, i1, i2, fingerprint);
+    InsertFingerprint(i1, fingerprint);
+    size_++;
+    return true;
+}
+
+bool CuckooFilter::Contains(const std::string &element) const {
+    size_t i1, i2;
+    uint8_t fingerprint;
+    Hashes(element, i1, i2, fingerprint);
+    if (BucketContains(i1, fingerprint) || BucketContains(i2, fingerprint)) return true;
+    return has_victim_ && victim_fingerprint_ == fingerprint && (victim_index_ == i1 || victim_index_ == i2);
+}
+
+bool CuckooFilter::Remove(const std::string &element) {
+    size_t i1, i2;
+    uint8_t fingerprint;
+    Hashes(element, i1, i2, fingerprint);
+
+    if (RemoveFromBucket(i1, fingerprint) || RemoveFromBucket(i2, fingerprint)) {
+        size_--;
+        // An entry was freed: give the waiting fingerprint another chance.
+        if (has_victim_) {
+            has_victim_ = false;
+            InsertFingerprint(victim_index_, victim_fingerprint_);
+        }
+        return true;
+    }
+
+    if (has_victim_ && victim_fingerprint_ == fingerprint && (victim_index_ == i1 || victim_index_ == i2)) {
+        has_victim_ = false;
+        size_--;
+        return true;
+    }
+    return false;
+}
+
+void CuckooFilter::Clear() {
+    buckets_.assign(buckets_.size(), 0);
+    size_ = 0;
+    has_victim_ = false;
+}
+
+};
+};
@@ -0,0 +1,103 @@
+#ifndef SAFEHERON_TSS_RSA_CUCKOO_FILTER_H
+#define SAFEHERON_TSS_RSA_CUCKOO_FILTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MembershipFilter.h"
+
+namespace safeheron {
+namespace tss_rsa{
+
+/**
+ * Cuckoo filter, see "Cuckoo Filter: Practically Better Than Bloom" (Fan et al., CoNEXT 2014).
+ * Native port of filters/cuckoo/cuckoo.go.
+ *
+ * Each bucket holds 4 entries of 8-bit fingerprints, packed in one 32-bit word. An element may live
+ * in one of two buckets i1 = hash(x) and i2 = i1 ^ hash(fingerprint(x)), so insert, lookup and
+ * delete each look at two words. With 8-bit fingerprints the false positive rate is about 3%.
+ *
+ * Unlike a Bloom filter, elements can be removed. Only remove elements that were inserted, otherwise
+ * another element with the same fingerprint may be removed instead.
+ */
+class CuckooFilter : public MembershipFilter{
+public:
+    static const size_t ENTRIES_PER_BUCKET = 4;
+    static const size_t MAX_KICKS = 500;
+
+    /**
+     * Constructor.
+     * @param[in] capacity expected number of elements, > 0
+     */
+    explicit CuckooFilter(size_t capacity);
+
+    /**
+     * Insert an element.
+     * When both candidate buckets are full, resident fingerprints are relocated to their alternate
+     * bucket, up to MAX_KICKS times. If that fails the last displaced fingerprint is kept aside, so that
+     * no element is lost, and the filter refuses further inserts until something is removed.
+     * @param[in] element
+     * @return true on success, false if the filter is full.
+     */
+    bool Add(const std::string &element) override;
+
+    /**
+     * Test whether an element may have been inserted.
+     * @param[in] element
+     * @return false if the element is definitely absent, true if it may be present.
+     */
+    bool Contains(const std::string &element) const override;
+
+    /**
+     * Remove an element inserted earlier.
+     * @param[in] element
+     * @return true if a matching fingerprint was found and removed.
+     */
+    bool Remove(const std::string &element);
+
+    /**
+     * Remove all the elements.
+     */
+    void Clear() override;
+
+    /**
+     * @return number of elements in the filter.
+     */
+    size_t size() const;
+
+    /**
+     * @return number of buckets, a power of 2.
+     */
+    size_t bucket_count() const;
+
+    /**
+     * @return number of entries, bucket_count() * ENTRIES_PER_BUCKET.
+     */
+    size_t capacity() const;
+
+private:
+    void Hashes(const std::string &element, size_t &i1, size_t &i2, uint8_t &fingerprint) const;
+    size_t AltIndex(size_t index, uint8_t fingerprint) const;
+    void InsertFingerprint(size_t index, uint8_t fingerprint);
+    bool InsertToBucket(size_t index, uint8_t fingerprint);
+    bool BucketContains(size_t index, uint8_t fingerprint) const;
+    bool RemoveFromBucket(size_t index, uint8_t fingerprint);
+    uint8_t Entry(size_t index, size_t slot) const;
+    void SetEntry(size_t index, size_t slot, uint8_t fingerprint);
+    uint64_t NextRandom();
+
+private:
+    std::vector<uint32_t> buckets_;  /**< bucket i holds 4 fingerprints, fingerprint 0 marks an empty entry */
+    size_t mask_;                    /**< bucket_count - 1 */
+    size_t size_;                    /**< number of elements */
+    bool has_victim_;                /**< a fingerprint is waiting for a free entry */
+    size_t victim_index_;            /**< bucket of the waiting fingerprint */
+    uint8_t victim_fingerprint_;     /**< the waiting fingerprint */
+    uint64_t rng_state_;             /**< xorshift state used to pick the entry to kick out */
+};
+
+};
+};
+
+#endif //SAFEHERON_TSS_RSA_CUCKOO_FILTER_H
@@ -0,0 +1,248 @@
+#ifndef SAFEHERON_TSS_RSA_FIXED_BN_H
+#define SAFEHERON_TSS_RSA_FIXED_BN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if defined(__SIZEOF_INT128__)
+#define SAFEHERON_TSS_RSA_HAS_FIXED_BN 1
+#endif
+
+#ifdef SAFEHERON_TSS_RSA_HAS_FIXED_BN
+
+namespace safeheron {
+namespace tss_rsa{
+
+/**
+ * Unsigned integer of BITS bits in 64-bit limbs, least significant limb first, stored inline.
+ */
+template <size_t BITS>
+struct FixedBN {
+    static const size_t LIMBS = (BITS + 63) / 64;
+    static const size_t BYTES = LIMBS * 8;
+
+    uint64_t limb[LIMBS];
+
+    void SetZero() {
+        std::memset(limb, 0, sizeof(limb));
+    }
+
+    bool IsZero() const {
+        uint64_t acc = 0;
+        for (size_t i = 0; i < LIMBS; ++i) acc |= limb[i];
+        return acc == 0;
+    }
+
+    bool operator==(const FixedBN &o) const {
+        uint64_t acc = 0;
+        for (size_t i = 0; i < LIMBS; ++i) acc |= limb[i] ^ o.limb[i];
+        return acc == 0;
+    }
+
+    /**
+     * Load a big endian byte string.
+     * @param[in] data
+     * @param[in] size size <= BYTES
+     */
+    void FromBytesBE(const uint8_t *data, size_t size) {
+        SetZero();
+        for (size_t i = 0; i < size; ++i) {
+            size_t pos = size - 1 - i;
+            limb[i / 8] |= (uint64_t)data[pos] << (8 * (i % 8));
+        }
+    }
+
+    /**
+     * Store as a big endian byte string without leading zeros.
+     * @param[out] out
+     */
+    void ToBytesBE(std::string &out) const {
+        uint8_t buf[BYTES];
+        for (size_t i = 0; i < BYTES; ++i) {
+            buf[BYTES - 1 - i] = (uint8_t)(limb[i / 8] >> (8 * (i % 8)));
+        }
+        size_t skip = 0;
+        while (skip < BYTES && buf[skip] == 0) ++skip;
+        out.assign((const char *)buf + skip, BYTES - skip);
+    }
+};
+
+/**
+ * Montgomery arithmetic modulo an odd modulus of at most BITS bits, with R = 2^(64 * LIMBS).
+ *
+ * All the operands live on the stack, the multiplication is the CIOS method (Koc, Acar and Kaliski,
+ * "Analyzing and Comparing Montgomery Multiplication Algorithms", 1996) on 128-bit products.
+ * The inputs of Mul must be reduced modulo n; the outputs are. Pow skips the zero windows of the exponent,
+ * so it is not constant time in the exponent.
+ */
+template <size_t BITS>
+class FixedMontgomery {
+public:
+    typedef FixedBN<BITS> Num;
+    static const size_t LIMBS = Num::LIMBS;
+    static const size_t MAX_WINDOW = 5;
+
+    /**
+     * Constructor.
+     * @param[in] n odd modulus, n > 1, at most BITS bits
+     * @param[in] rr R^2 mod n
+     */
+    FixedMontgomery(const Num &n, const Num &rr) : n_(n), rr_(rr) {
+        // -n^-1 mod 2^64 by Newton iteration, every step doubles the number of correct bits
+        uint64_t inv = 1;
+        for (int i = 0; i < 6; ++i) inv *= 2 - n.limb[0] * inv;
+        n0inv_ = (uint64_t)0 - inv;
+        Num one;
+        one.SetZero();
+        one.limb[0] = 1;
+        Mul(one_, one, rr_);
+    }
+
+    const Num &n() const { return n_; }
+
+    /**
+     * @return R mod n, 1 in Montgomery form.
+     */
+    const Num &one() const { return one_; }
+
+    /**
+     * r = a * b * R^-1 mod n. r may alias a or b.
+     */
+    void Mul(Num &r, const Num &a, const Num &b) const {
+        typedef unsigned __int128 u128;
+        uint64_t t[LIMBS + 2];
+        std::memset(t, 0, sizeof(t));
+        for (size_t i = 0; i < LIMBS; ++i) {
+            // t += a * b[i]
+            uint64_t carry = 0;
+            const uint64_t bi = b.limb[i];
+            for (size_t j = 0; j < LIMBS; ++j) {
+                u128 s = (u128)a.limb[j] * bi + t[j] + carry;
+                t[j] = (uint64_t)s;
+                carry = (uint64_t)(s >> 64);
+            }
+            u128 s = (u128)t[LIMBS] + carry;
+            t[LIMBS] = (uint64_t)s;
+            t[LIMBS + 1] = (uint64_t)(s >> 64);
+
+            // t = (t + m * n) / 2^64
+            const uint64_t m = t[0] * n0inv_;
+            s = (u128)m * n_.limb[0] + t[0];
+            carry = (uint64_t)(s >> 64);
+            for (size_t j = 1; j < LIMBS; ++j) {
+                s = (u128)m * n_.limb[j] + t[j] + carry;
+                t[j - 1] = (uint64_t)s;
+                carry = (uint64_t)(s >> 64);
+            }
+            s = (u128)t[LIMBS] + carry;
+            t[LIMBS - 1] = (uint64_t)s;
+            t[LIMBS] = t[LIMBS + 1] + (uint64_t)(s >> 64);
+        }
+
+        // t < 2n, subtract n once if t >= n
+        uint64_t diff[LIMBS];
+        uint64_t borrow = 0;
+        for (size_t j = 0; j < LIMBS; ++j) {
+            u128 d = (u128)t[j] - n_.limb[j] - borrow;
+            diff[j] = (uint64_t)d;
+            borrow = (uint64_t)(d >> 64) & 1;
+        }
+        const uint64_t keep_t = (uint64_t)0 - (uint64_t)(borrow & (t[LIMBS] == 0));
+        for (size_t j = 0; j < LIMBS; ++j) {
+            r.limb[j] = (t[j] & keep_t) | (diff[j] & ~keep_t);
+        }
+    }
+
+    /**
+     * r = a * R mod n, a < n.
+     */
+    void ToMontgomery(Num &r, const Num &a) const {
+        Mul(r, a, rr_);
+    }
+
+    /**
+     * r = a * R^-1 mod n.
+     */
+    void FromMontgomery(Num &r, const Num &a) const {
+        Num one;
+        one.SetZero();
+        one.limb[0] = 1;
+        Mul(r, a, one);
+    }
+
+    /**
+     * r = a^e in Montgomery form, e given as big endian bytes.
+     * A fixed window of up to 5 bits for long exponents, plain square and multiply for short ones.
+     * @param[out] r may alias a
+     * @param[in] a Montgomery form
+     * @param[in] e big endian exponent
+     * @param[in] e_size length of e
+     */
+    void Pow(Num &r, const Num &a, const uint8_t *e, size_t e_size) const {
+        while (e_size > 0 && e[0] == 0) {
+            ++e;
+            --e_size;
+        }
+        if (e_size == 0) {
+            r = one_;
+            return;
+        }
+        const size_t bits = e_size * 8;
+        const size_t w = bits <= 32 ? 1 : (bits <= 256 ? 4 : MAX_WINDOW);
+        if (w == 1) {
+            Num base = a;
+            Num acc = one_;
+            for (size_t i = bits; i-- > 0; ) {
+                Mul(acc, acc, acc);
+                if (Bit(e, e_size, i)) Mul(acc, acc, base);
+            }
+            r = acc;
+            return;
+        }
+
+        // table[d] = a^d
+        Num table[(size_t)1 << MAX_WINDOW];
+        table[0] = one_;
+        table[1] = a;
+        for (size_t d = 2; d < ((size_t)1 << w); ++d) Mul(table[d], table[d - 1], a);
+
+        Num acc = one_;
+        bool started = false;
+        for (size_t top = ((bits + w - 1) / w) * w; top > 0; top -= w) {
+            unsigned digit = 0;
+            for (size_t k = 0; k < w; ++k) {
+                digit = (digit << 1) | Bit(e, e_size, top - 1 - k);
+            }
+            if (started) {
+                for (size_t k = 0; k < w; ++k) Mul(acc, acc, acc);
+                if (digit) Mul(acc, acc, table[digit]);
+            } else if (digit) {
+                acc = table[digit];
+                started = true;
+            }
+        }
+        r = acc;
+    }
+
+private:
+    // bit i of big endian e, 0 beyond its length
+    static unsigned Bit(const uint8_t *e, size_t e_size, size_t i) {
+        if (i >= e_size * 8) return 0;
+        return (e[e_size - 1 - i / 8] >> (i % 8)) & 1;
+    }
+
+private:
+    Num n_;
+    Num rr_;       /**< R^2 mod n */
+    Num one_;      /**< R mod n */
+    uint64_t n0inv_;  /**< -n^-1 mod 2^64 */
+};
+
+};
+};
+
+#endif //SAFEHERON_TSS_RSA_HAS_FIXED_BN
+
+#endif //SAFEHERON_TSS_RSA_FIXED_BN_H
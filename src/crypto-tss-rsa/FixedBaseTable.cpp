@@ -0,0 +1,90 @@
+#include "FixedBaseTable.h"
+#include "exception/safeheron_exceptions.h"
+
+using safeheron::bignum::BN;
+using safeheron::exception::LocatedException;
+using safeheron::exception::BadAllocException;
+
+namespace safeheron {
+namespace tss_rsa{
+
+// Window minimizing ceil(t / w) + 2^w
+static size_t BestWindow(size_t max_exp_bits) {
+    size_t best = 1;
+    size_t best_cost = max_exp_bits + 2;
+    for (size_t w = 2; w <= 8; w++) {
+        size_t cost = (max_exp_bits + w - 1) / w + ((size_t)1 << w);
+        if (cost < best_cost) {
+            best = w;
+            best_cost = cost;
+        }
+    }
+    return best;
+}
+
+FixedBaseTable::FixedBaseTable(const std::shared_ptr<const MontgomeryContext> &mont, const BN &base, size_t max_exp_bits)
+        : mont_(mont), base_(base), max_exp_bits_(max_exp_bits) {
+    if (!mont_ || max_exp_bits == 0) {
+        throw LocatedException(__FILE__, __LINE__, __FUNCTION__, -1, "!mont || max_exp_bits == 0");
+    }
+    window_bits_ = BestWindow(max_exp_bits);
+    size_t windows = (max_exp_bits + window_bits_ - 1) / window_bits_;
+    powers_.reserve(windows);
+    powers_.emplace_back(mont_->ToMontgomery(base));
+    for (size_t j = 1; j < windows; j++) {
+        BIGNUMPtr p(BN_dup(powers_.back().get()));
+        if (!p) {
+            throw BadAllocException(__FILE__, __LINE__, __FUNCTION__, -1, "BN_dup failed");
+        }
+        for (size_t s = 0; s < window_bits_; s++) {
+            mont_->Sqr(p.get(), p.get());
+        }
+        powers_.emplace_back(std::move(p));
+    }
+}
+
+BN FixedBaseTable::PowM(const BN &exp) const {
+    if (exp < 0 || exp.BitLength() > max_exp_bits_) {
+        return mont_->PowM(base_, exp);
+    }
+
+    // Split the exponent into w-bit digits.
+    BIGNUMPtr e = MontgomeryContext::ToBIGNUM(exp);
+    size_t windows = (exp.BitLength() + window_bits_ - 1) / window_bits_;
+    std::vector<uint32_t> digits(windows, 0);
+    for (size_t j = 0; j < windows; j++) {
+        for (size_t s = 0; s < window_bits_; s++) {
+            if (BN_is_bit_set(e.get(), (int)(j * window_bits_ + s))) digits[j] |= (uint32_t)1 << s;
+        }
+    }
+
+    // A = prod_d B_d, where B_d = prod_{j: e_j >= d} g_j, so that A = prod_j g_j^(e_j)
+    BIGNUMPtr a = mont_->One();
+    BIGNUMPtr b = mont_->One();
+    bool b_is_one = true;
+    for (uint32_t d = ((uint32_t)1 << window_bits_) - 1; d >= 1; d--) {
+        for (size_t j = 0; j < windows; j++) {
+            if (digits[j] == d) {
+                mont_->Mul(b.get(), b.get(), powers_[j].get());
+                b_is_one = false;
+            }
+        }
+        if (!b_is_one) mont_->Mul(a.get(), a.get(), b.get());
+    }
+    return mont_->FromMontgomery(a.get());
+}
+
+const BN &FixedBaseTable::base() const {
+    return base_;
+}
+
+size_t FixedBaseTable::max_exp_bits() const {
+    return max_exp_bits_;
+}
+
+size_t FixedBaseTable::window_bits() const {
+    return window_bits_;
+}
+
+};
+};
@@ -0,0 +1,57 @@
+#ifndef SAFEHERON_TSS_RSA_FIXED_BASE_TABLE_H
+#define SAFEHERON_TSS_RSA_FIXED_BASE_TABLE_H
+
+#include <memory>
+#include <vector>
+#include "crypto-bn/bn.h"
+#include "MontgomeryContext.h"
+
+namespace safeheron {
+namespace tss_rsa{
+
+/**
+ * Fixed-base exponentiation, g^e mod n for a base g known in advance.
+ *
+ * Windowed method of Yao / Brickell-Gordon-McCurley-Wilson: the table holds g_j = g^(2^(w*j)) for every
+ * w-bit window j of the exponent, so that
+ *     g^e = prod_{d = 1}^{2^w - 1} ( prod_{j: e_j = d} g_j )^d
+ * takes about t / w + 2^w multiplications and no squaring, where t is the exponent length, instead of
+ * about t squarings and t / (w + 1) multiplications for a sliding window.
+ * The window w is chosen to minimize that cost, and the table takes ceil(t / w) residues.
+ *
+ * Like BN::PowM, this is not constant time. The table is immutable after construction and can be
+ * used by several threads.
+ */
+class FixedBaseTable{
+public:
+    /**
+     * Constructor. Costs about one exponentiation.
+     * @param[in] mont Montgomery context of the modulus
+     * @param[in] base g
+     * @param[in] max_exp_bits largest exponent length served by the table
+     */
+    FixedBaseTable(const std::shared_ptr<const MontgomeryContext> &mont, const bignum::BN &base, size_t max_exp_bits);
+
+    /**
+     * g^exp mod n. Exponents which are negative or longer than max_exp_bits() fall back to MontgomeryContext::PowM.
+     * @param[in] exp exponent
+     * @return g^exp mod n
+     */
+    bignum::BN PowM(const bignum::BN &exp) const;
+
+    const bignum::BN &base() const;
+    size_t max_exp_bits() const;
+    size_t window_bits() const;
+
+private:
+    std::shared_ptr<const MontgomeryContext> mont_;
+    bignum::BN base_;
+    size_t max_exp_bits_;
+    size_t window_bits_;
+    std::vector<BIGNUMPtr> powers_;  /**< powers_[j] = g^(2^(w*j)) in Montgomery form */
+};
+
+};
+};
+
+#endif //SAFEHERON_TSS_RSA_FIXED_BASE_TABLE_H
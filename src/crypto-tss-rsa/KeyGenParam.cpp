@@ -11,6 +11,8 @@ KeyGenParam::KeyGenParam(){
     q_ = BN::ZERO;
     f_ = BN::ZERO;
     vku_ = BN::ZERO;
+    thread_count_ = 0;
+    self_check_ = false;
 }
 
 /**
@@ -31,6 +33,8 @@ KeyGenParam::KeyGenParam(int e,
     q_ = q;
     f_ = f;
     vku_ = vku;
+    thread_count_ = 0;
+    self_check_ = false;
 }
 
 int KeyGenParam::e() const {
@@ -73,5 +77,21 @@ void KeyGenParam::set_vku(const BN &vku) {
     vku_ = vku;
 }
 
+size_t KeyGenParam::thread_count() const {
+    return thread_count_;
+}
+
+void KeyGenParam::set_thread_count(size_t thread_count) {
+    thread_count_ = thread_count;
+}
+
+bool KeyGenParam::self_check() const {
+    return self_check_;
+}
+
+void KeyGenParam::set_self_check(bool self_check) {
+    self_check_ = self_check;
+}
+
 };
 };
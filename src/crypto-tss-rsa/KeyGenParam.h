@@ -45,12 +45,31 @@ public:
 
     void set_vku(const bignum::BN &vku);
 
+    size_t thread_count() const;
+
+    /**
+     * Search the missing safe primes p and q at the same time, on thread_count threads (see RandomSafePrimePairParallel),
+     * and compute the verification keys vki of the parties on as many threads.
+     * @param[in] thread_count: 0 (default) keeps the sequential computation.
+     */
+    void set_thread_count(size_t thread_count);
+
+    bool self_check() const;
+
+    /**
+     * Recover d from the shares after sharing it, and fail the key generation if it does not match.
+     * @param[in] self_check: false (default) skips the check.
+     */
+    void set_self_check(bool self_check);
+
 private:
     int e_;  /**< 65537 default */
     safeheron::bignum::BN p_;  /**< safe prime. */
     safeheron::bignum::BN q_;  /**< safe prime. */
     safeheron::bignum::BN f_;  /**< f \in Z_n^*, then f^2 \in Q_n */
     safeheron::bignum::BN vku_;  /**< vku \in Z_n^*, Jacobi(vku, n) = -1, where n = pq */
+    size_t thread_count_;  /**< threads of key generation, 0 for the sequential computation. */
+    bool self_check_;  /**< check the shares of d against d. */
 };
 
 };
@@ -0,0 +1,52 @@
+#include "KeyMetaPrecompute.h"
+
+using safeheron::bignum::BN;
+
+namespace safeheron {
+namespace tss_rsa{
+
+// Output length of SHA256, the bit length of the challenge c in RSASigShareProof
+static const size_t L1 = 256;
+
+KeyMetaPrecompute::KeyMetaPrecompute(const BN &n, const BN &vkv, const std::vector<BN> &vki_arr)
+        : mont_(std::make_shared<MontgomeryContext>(n)), vki_arr_(vki_arr), vki_inv_tables_(vki_arr.size()) {
+    // z = si * c + r < 2^(L(N) + 2*L1 + 2), see RSASigShareProof::Prove
+    vkv_table_.reset(new FixedBaseTable(mont_, vkv, n.BitLength() + 2 * L1 + 2));
+    vkv_transcript_.Append(vkv);
+}
+
+const BN &KeyMetaPrecompute::n() const {
+    return mont_->n();
+}
+
+const MontgomeryContext &KeyMetaPrecompute::mont() const {
+    return *mont_;
+}
+
+const std::shared_ptr<const MontgomeryContext> &KeyMetaPrecompute::mont_ptr() const {
+    return mont_;
+}
+
+BN KeyMetaPrecompute::PowVkv(const BN &exp) const {
+    return vkv_table_->PowM(exp);
+}
+
+BN KeyMetaPrecompute::PowVkiInv(size_t index, const BN &exp) const {
+    std::shared_ptr<const FixedBaseTable> table;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::shared_ptr<const FixedBaseTable> &slot = vki_inv_tables_.at(index);
+        if (!slot) {
+            slot = std::make_shared<FixedBaseTable>(mont_, vki_arr_[index].InvM(mont_->n()), L1);
+        }
+        table = slot;
+    }
+    return table->PowM(exp);
+}
+
+const ProofTranscript &KeyMetaPrecompute::vkv_transcript() const {
+    return vkv_transcript_;
+}
+
+};
+};
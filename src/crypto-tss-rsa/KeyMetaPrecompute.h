@@ -0,0 +1,68 @@
+#ifndef SAFEHERON_TSS_RSA_KEY_META_PRECOMPUTE_H
+#define SAFEHERON_TSS_RSA_KEY_META_PRECOMPUTE_H
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "crypto-bn/bn.h"
+#include "MontgomeryContext.h"
+#include "FixedBaseTable.h"
+#include "ProofTranscript.h"
+
+namespace safeheron {
+namespace tss_rsa{
+
+/**
+ * Precomputation over the fixed bases of a key, used by the signature share proofs:
+ *  - the Montgomery context of n,
+ *  - a fixed-base table of vkv, for v^z in Verify (Prove takes v^r in constant time instead),
+ *  - per party, a fixed-base table of vki^-1, for vi^(-c) in Verify, built on first use,
+ *  - the proof transcript with v hashed, the prefix of every challenge.
+ *
+ * Built by RSAKeyMeta::Precompute(), immutable from the outside and safe to share between threads.
+ */
+class KeyMetaPrecompute{
+public:
+    /**
+     * Constructor. Builds the vkv table, which costs about one exponentiation.
+     * @param[in] n n = pq
+     * @param[in] vkv validation key
+     * @param[in] vki_arr validation key array of all parties
+     */
+    KeyMetaPrecompute(const bignum::BN &n, const bignum::BN &vkv, const std::vector<bignum::BN> &vki_arr);
+
+    const bignum::BN &n() const;
+    const MontgomeryContext &mont() const;
+    const std::shared_ptr<const MontgomeryContext> &mont_ptr() const;
+
+    /**
+     * @param[in] exp exponent
+     * @return vkv^exp mod n
+     */
+    bignum::BN PowVkv(const bignum::BN &exp) const;
+
+    /**
+     * @param[in] index index of the party, starting from 0
+     * @param[in] exp exponent
+     * @return vki^(-exp) mod n
+     */
+    bignum::BN PowVkiInv(size_t index, const bignum::BN &exp) const;
+
+    /**
+     * @return the proof transcript holding v, to be copied and continued.
+     */
+    const ProofTranscript &vkv_transcript() const;
+
+private:
+    std::shared_ptr<const MontgomeryContext> mont_;
+    std::unique_ptr<FixedBaseTable> vkv_table_;
+    ProofTranscript vkv_transcript_;
+    std::vector<bignum::BN> vki_arr_;
+    mutable std::mutex mutex_;
+    mutable std::vector<std::shared_ptr<const FixedBaseTable>> vki_inv_tables_;
+};
+
+};
+};
+
+#endif //SAFEHERON_TSS_RSA_KEY_META_PRECOMPUTE_H
@@ -0,0 +1,284 @@
+#include "KeyStore.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "WireFormat.h"
+
+using safeheron::bignum::BN;
+
+namespace safeheron {
+namespace tss_rsa{
+
+static const char MAGIC[8] = {'T', 'S', 'S', 'R', 'S', 'A', 'K', 'S'};
+static const uint32_t FORMAT_VERSION = 1;
+static const size_t HEADER_SIZE = 16;
+static const size_t INDEX_ENTRY_SIZE = 24;
+
+static void PutU32(std::string &out, uint32_t v){
+    for(int i = 0; i < 4; i++) out.push_back((char)(uint8_t)(v >> (8 * i)));
+}
+
+static void PutU64(std::string &out, uint64_t v){
+    for(int i = 0; i < 8; i++) out.push_back((char)(uint8_t)(v >> (8 * i)));
+}
+
+static uint32_t GetU32(const uint8_t *p){
+    uint32_t v = 0;
+    for(int i = 3; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+
+static uint64_t GetU64(const uint8_t *p){
+    uint64_t v = 0;
+    for(int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+
+KeyStoreEntry::KeyStoreEntry()
+        : pub_(nullptr, 0), meta_(nullptr, 0), k_(0), l_(0), vkv_(nullptr, 0), vku_(nullptr, 0) {}
+
+bool KeyStoreEntry::Parse(const std::string &key_id, Slice pub, Slice meta){
+    bool ok = true;
+    int32_t k = 0, l = 0;
+    Slice vkv(nullptr, 0), vku(nullptr, 0);
+    std::vector<Slice> vki_arr;
+    WireReader reader(meta.first, meta.second);
+    while (ok && reader.Next()) {
+        Slice slice(nullptr, 0);
+        switch (reader.field()) {
+            case 1: ok = reader.ReadInt32(k); break;
+            case 2: ok = reader.ReadInt32(l); break;
+            case 3: ok = reader.ReadBytes(vkv.first, vkv.second); break;
+            case 4: ok = reader.ReadBytes(vku.first, vku.second); break;
+            case 5:
+                ok = reader.ReadBytes(slice.first, slice.second);
+                vki_arr.push_back(slice);
+                break;
+            default: break;
+        }
+    }
+    if (!ok || !reader.Done()) return false;
+    if (k == 0 || l == 0) return false;
+
+    key_id_ = key_id;
+    pub_ = pub;
+    meta_ = meta;
+    k_ = k;
+    l_ = l;
+    vkv_ = vkv;
+    vku_ = vku;
+    vki_arr_.swap(vki_arr);
+    decoded_ = std::make_shared<DecodedFields>();
+    decoded_->values.resize(2 + vki_arr_.size());
+    return true;
+}
+
+const BN &KeyStoreEntry::Decoded(size_t field, const Slice &slice) const {
+    if (!decoded_) return BN::ZERO;
+    std::lock_guard<std::mutex> lock(decoded_->mutex);
+    std::unique_ptr<BN> &value = decoded_->values[field];
+    if (!value) value.reset(new BN(slice.second == 0 ? BN::ZERO : BN::FromBytesBE(slice.first, slice.second)));
+    return *value;
+}
+
+const std::string &KeyStoreEntry::key_id() const {
+    return key_id_;
+}
+
+int KeyStoreEntry::k() const {
+    return k_;
+}
+
+int KeyStoreEntry::l() const {
+    return l_;
+}
+
+bool KeyStoreEntry::public_key(RSAPublicKey &public_key) const {
+    if (!pub_.first) return false;
+    return public_key.FromBytes((const char *)pub_.first, pub_.second);
+}
+
+const BN &KeyStoreEntry::vkv() const {
+    return Decoded(0, vkv_);
+}
+
+const BN &KeyStoreEntry::vku() const {
+    return Decoded(1, vku_);
+}
+
+const BN &KeyStoreEntry::vki(size_t index) const {
+    if (index >= vki_arr_.size()) return BN::ZERO;
+    return Decoded(2 + index, vki_arr_[index]);
+}
+
+bool KeyStoreEntry::key_meta(RSAKeyMeta &key_meta) const {
+    if (!meta_.first) return false;
+    return key_meta.FromBytes((const char *)meta_.first, meta_.second);
+}
+
+bool KeyStoreWriter::Add(const std::string &key_id, const RSAPublicKey &public_key, const RSAKeyMeta &key_meta){
+    if (records_.count(key_id)) return false;
+    std::string pub, meta;
+    if (!public_key.ToBytes(pub) || !key_meta.ToBytes(meta)) return false;
+    if (key_id.size() > UINT32_MAX || pub.size() > UINT32_MAX || meta.size() > UINT32_MAX) return false;
+    records_[key_id] = std::make_pair(pub, meta);
+    return true;
+}
+
+size_t KeyStoreWriter::size() const {
+    return records_.size();
+}
+
+void KeyStoreWriter::Serialize(std::string &out) const {
+    out.clear();
+    out.append(MAGIC, sizeof(MAGIC));
+    PutU32(out, FORMAT_VERSION);
+    PutU32(out, (uint32_t)records_.size());
+
+    // std::map iterates in key id order, the order of the index
+    uint64_t offset = HEADER_SIZE + INDEX_ENTRY_SIZE * records_.size();
+    for (const auto &item : records_) {
+        PutU64(out, offset);
+        PutU32(out, (uint32_t)item.first.size());
+        PutU32(out, (uint32_t)item.second.first.size());
+        PutU32(out, (uint32_t)item.second.second.size());
+        PutU32(out, 0);
+        offset += item.first.size() + item.second.first.size() + item.second.second.size();
+    }
+    for (const auto &item : records_) {
+        out.append(item.first);
+        out.append(item.second.first);
+        out.append(item.second.second);
+    }
+}
+
+bool KeyStoreWriter::WriteFile(const std::string &path) const {
+    std::string buf;
+    Serialize(buf);
+    FILE *fp = fopen(path.c_str(), "wb");
+    if (!fp) return false;
+    bool ok = fwrite(buf.data(), 1, buf.size(), fp) == buf.size();
+    ok = fclose(fp) == 0 && ok;
+    return ok;
+}
+
+KeyStore::KeyStore()
+        : data_(nullptr), size_(0), count_(0), map_(nullptr), map_size_(0) {}
+
+KeyStore::~KeyStore() {
+    Close();
+}
+
+bool KeyStore::Init(const uint8_t *data, size_t size) {
+    if (size < HEADER_SIZE || memcmp(data, MAGIC, sizeof(MAGIC)) != 0) return false;
+    if (GetU32(data + 8) != FORMAT_VERSION) return false;
+    size_t count = GetU32(data + 12);
+    if (count > (size - HEADER_SIZE) / INDEX_ENTRY_SIZE) return false;
+    data_ = data;
+    size_ = size;
+    count_ = count;
+    return true;
+}
+
+#ifdef _WIN32
+// No mmap: the file is read into a buffer owned by the store.
+bool KeyStore::Open(const std::string &path) {
+    Close();
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (!fp) return false;
+    std::string buf;
+    char chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0) buf.append(chunk, n);
+    bool ok = ferror(fp) == 0;
+    fclose(fp);
+    if (!ok || buf.empty()) return false;
+    file_.swap(buf);
+    if (!Init((const uint8_t *)file_.data(), file_.size())) {
+        std::string().swap(file_);
+        return false;
+    }
+    return true;
+}
+#else
+bool KeyStore::Open(const std::string &path) {
+    Close();
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+    size_t size = (size_t)st.st_size;
+    void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+    if (!Init((const uint8_t *)map, size)) {
+        munmap(map, size);
+        return false;
+    }
+    map_ = map;
+    map_size_ = size;
+    return true;
+}
+#endif
+
+bool KeyStore::OpenBuffer(const uint8_t *data, size_t size) {
+    Close();
+    return Init(data, size);
+}
+
+void KeyStore::Close() {
+#ifdef _WIN32
+    std::string().swap(file_);
+#else
+    if (map_) munmap(map_, map_size_);
+#endif
+    map_ = nullptr;
+    map_size_ = 0;
+    data_ = nullptr;
+    size_ = 0;
+    count_ = 0;
+}
+
+size_t KeyStore::size() const {
+    return count_;
+}
+
+bool KeyStore::Find(const std::string &key_id, KeyStoreEntry &entry) const {
+    // Binary search of the index; records are bounds checked as they are reached.
+    size_t lo = 0, hi = count_;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const uint8_t *p = data_ + HEADER_SIZE + INDEX_ENTRY_SIZE * mid;
+        uint64_t offset = GetU64(p);
+        uint64_t id_size = GetU32(p + 8);
+        uint64_t pub_size = GetU32(p + 12);
+        uint64_t meta_size = GetU32(p + 16);
+        if (offset > size_ || id_size + pub_size + meta_size > size_ - offset) return false;
+
+        const uint8_t *record = data_ + offset;
+        int cmp = memcmp(record, key_id.data(), std::min((size_t)id_size, key_id.size()));
+        if (cmp == 0 && id_size != key_id.size()) cmp = id_size < key_id.size() ? -1 : 1;
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else if (cmp > 0) {
+            hi = mid;
+        } else {
+            return entry.Parse(key_id,
+                               KeyStoreEntry::Slice(record + id_size, (size_t)pub_size),
+                               KeyStoreEntry::Slice(record + id_size + pub_size, (size_t)meta_size));
+        }
+    }
+    return false;
+}
+
+};
+};
@@ -0,0 +1,194 @@
+#ifndef SAFEHERON_TSS_RSA_KEY_STORE_H
+#define SAFEHERON_TSS_RSA_KEY_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "crypto-bn/bn.h"
+#include "RSAKeyMeta.h"
+#include "RSAPublicKey.h"
+
+namespace safeheron {
+namespace tss_rsa{
+
+/**
+ * A key of a KeyStore: views into the mapped file, decoded on access.
+ *
+ * Only the field offsets are read by KeyStore::Find; vkv, vku and every vki(index) are decoded from the file
+ * on their first access and kept, so a combiner pays once for the vki of the parties that actually sign and
+ * nothing for the others. Copies of an entry share the decoded fields, and the accessors are safe to call
+ * from several threads. The entry is valid as long as the store it comes from stays open; the references
+ * returned, as long as the entry, or a copy of it, is not given another key by KeyStore::Find.
+ */
+class KeyStoreEntry{
+public:
+    KeyStoreEntry();
+
+    const std::string &key_id() const;
+    int k() const;
+    int l() const;
+
+    /**
+     * @param[out] public_key
+     * @return true on success, false on error.
+     */
+    bool public_key(RSAPublicKey &public_key) const;
+
+    const bignum::BN &vkv() const;
+    const bignum::BN &vku() const;
+
+    /**
+     * @param[in] index index of party, starting from 0, as RSAKeyMeta::vki
+     * @return vki of party index + 1, 0 if index >= l.
+     */
+    const bignum::BN &vki(size_t index) const;
+
+    /**
+     * Decode the whole key meta data, the same as RSAKeyMeta::FromBytes.
+     * @param[out] key_meta
+     * @return true on success, false on error.
+     */
+    bool key_meta(RSAKeyMeta &key_meta) const;
+
+private:
+    typedef std::pair<const uint8_t *, size_t> Slice;
+
+    // Decoded big numbers: vkv, vku, then the vki, nullptr until first accessed
+    struct DecodedFields {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<bignum::BN>> values;
+    };
+
+    bool Parse(const std::string &key_id, Slice pub, Slice meta);
+    const bignum::BN &Decoded(size_t field, const Slice &slice) const;
+
+private:
+    std::string key_id_;
+    Slice pub_;
+    Slice meta_;
+    int k_;
+    int l_;
+    Slice vkv_;
+    Slice vku_;
+    std::vector<Slice> vki_arr_;
+    std::shared_ptr<DecodedFields> decoded_;
+
+    friend class KeyStore;
+};
+
+/**
+ * Builder of a key store file.
+ *
+ * Layout, all the integers little endian:
+ *     "TSSRSAKS"  magic, 8 bytes
+ *     uint32      format version, 1
+ *     uint32      number of keys
+ *     index       one 24 bytes entry per key, sorted by key id:
+ *                     uint64 offset of the record, uint32 key id size, uint32 public key size,
+ *                     uint32 key meta size, uint32 reserved (0)
+ *     records     key id, then the public key and the key meta data as written by ToBytes
+ */
+class KeyStoreWriter{
+public:
+    /**
+     * Add a key.
+     * @param[in] key_id
+     * @param[in] public_key
+     * @param[in] key_meta
+     * @return true on success, false if the key id is already in use or the key can not be encoded.
+     */
+    bool Add(const std::string &key_id, const RSAPublicKey &public_key, const RSAKeyMeta &key_meta);
+
+    /**
+     * @return number of keys added.
+     */
+    size_t size() const;
+
+    /**
+     * Write the store into a buffer.
+     * @param[out] out
+     */
+    void Serialize(std::string &out) const;
+
+    /**
+     * Write the store into a file, replacing it.
+     * @param[in] path
+     * @return true on success, false on error.
+     */
+    bool WriteFile(const std::string &path) const;
+
+private:
+    std::map<std::string, std::pair<std::string, std::string>> records_;  /**< key id -> public key, key meta */
+};
+
+/**
+ * Read only store of many keys in one file, memory mapped.
+ *
+ * Open maps the file and checks its header, without reading the keys, so opening a store of any size is
+ * immediate and only the pages of the keys looked up become resident. Find is a binary search of the
+ * index. On Windows, where there is no mmap, Open reads the whole file into memory instead.
+ *
+ * A store opened is safe to share between threads.
+ */
+class KeyStore{
+public:
+    KeyStore();
+    ~KeyStore();
+
+    KeyStore(const KeyStore &) = delete;
+    KeyStore &operator=(const KeyStore &) = delete;
+
+    /**
+     * Map a file written by KeyStoreWriter, or read it on Windows.
+     * @param[in] path
+     * @return true on success, false on error.
+     */
+    bool Open(const std::string &path);
+
+    /**
+     * Use a buffer written by KeyStoreWriter::Serialize instead of a file.
+     * @param[in] data not copied, must outlive the store
+     * @param[in] size
+     * @return true on success, false on error.
+     */
+    bool OpenBuffer(const uint8_t *data, size_t size);
+
+    /**
+     * Unmap, or free, the file. The entries found become invalid.
+     */
+    void Close();
+
+    /**
+     * @return number of keys.
+     */
+    size_t size() const;
+
+    /**
+     * Look a key up.
+     * @param[in] key_id
+     * @param[out] entry
+     * @return true on success, false if there is no such key or its record is malformed.
+     */
+    bool Find(const std::string &key_id, KeyStoreEntry &entry) const;
+
+private:
+    bool Init(const uint8_t *data, size_t size);
+
+private:
+    const uint8_t *data_;
+    size_t size_;
+    size_t count_;
+    void *map_;       /**< mapping of Open, nullptr for OpenBuffer */
+    size_t map_size_;
+    std::string file_;  /**< contents of the file read by Open, on Windows only */
+};
+
+};
+};
+
+#endif //SAFEHERON_TSS_RSA_KEY_STORE_H
@@ -0,0 +1,41 @@
+#ifndef SAFEHERON_TSS_RSA_MEMBERSHIP_FILTER_H
+#define SAFEHERON_TSS_RSA_MEMBERSHIP_FILTER_H
+
+#include <string>
+
+namespace safeheron {
+namespace tss_rsa{
+
+/**
+ * Interface of the approximate membership filters (BloomFilter, BlockedBloomFilter, CuckooFilter).
+ *
+ * Membership queries may return false positives but never false negatives.
+ */
+class MembershipFilter{
+public:
+    virtual ~MembershipFilter() {}
+
+    /**
+     * Insert an element.
+     * @param[in] element
+     * @return true on success, false if the filter is full.
+     */
+    virtual bool Add(const std::string &element) = 0;
+
+    /**
+     * Test whether an element may have been inserted.
+     * @param[in] element
+     * @return false if the element is definitely absent, true if it may be present.
+     */
+    virtual bool Contains(const std::string &element) const = 0;
+
+    /**
+     * Reset the filter to the empty state.
+     */
+    virtual void Clear() = 0;
+};
+
+};
+};
+
+#endif //SAFEHERON_TSS_RSA_MEMBERSHIP_FILTER_H
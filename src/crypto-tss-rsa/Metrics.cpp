@@ -0,0 +1,145 @@
+#include "Metrics.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace safeheron {
+namespace tss_rsa{
+
+static const size_t METRIC_COUNT = (size_t)Metric::Count;
+
+static const char *METRIC_NAMES[METRIC_COUNT] = {
+        "keygen",
+        "prime_search",
+        "sign",
+        "prove",
+        "verify",
+        "proof_hash",
+        "combine",
+        "powm",
+        "pss_encode",
+        "pss_verify",
+        "serialize",
+        "deserialize",
+};
+
+namespace {
+
+/**
+ * Counters of one thread. Written by that thread only, read by TakeMetricsSnapshot.
+ */
+struct ThreadMetrics {
+    std::atomic<uint64_t> count[METRIC_COUNT];
+    std::atomic<uint64_t> nanos[METRIC_COUNT];
+    std::atomic<uint64_t> bytes[METRIC_COUNT];
+
+    ThreadMetrics();
+    ~ThreadMetrics();
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<ThreadMetrics *> threads;
+    MetricValue retired[METRIC_COUNT];  /**< totals of the threads that exited */
+
+    Registry() : retired() {}
+};
+
+// Never destroyed, so that the threads exiting after main do not outlive it.
+Registry &GetRegistry() {
+    static Registry *registry = new Registry();
+    return *registry;
+}
+
+ThreadMetrics::ThreadMetrics() {
+    for (size_t m = 0; m < METRIC_COUNT; ++m) {
+        count[m].store(0, std::memory_order_relaxed);
+        nanos[m].store(0, std::memory_order_relaxed);
+        bytes[m].store(0, std::memory_order_relaxed);
+    }
+    Registry &registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.threads.push_back(this);
+}
+
+ThreadMetrics::~ThreadMetrics() {
+    Registry &registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (size_t m = 0; m < METRIC_COUNT; ++m) {
+        registry.retired[m].count += count[m].load(std::memory_order_relaxed);
+        registry.retired[m].nanos += nanos[m].load(std::memory_order_relaxed);
+        registry.retired[m].bytes += bytes[m].load(std::memory_order_relaxed);
+    }
+    for (size_t t = 0; t < registry.threads.size(); ++t) {
+        if (registry.threads[t] == this) {
+            registry.threads[t] = registry.threads.back();
+            registry.threads.pop_back();
+            break;
+        }
+    }
+}
+
+// Single writer: a load and a store instead of a locked read-modify-write.
+inline void Bump(std::atomic<uint64_t> &counter, uint64_t v) {
+    counter.store(counter.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+}
+
+}
+
+bool MetricsEnabled() {
+#ifdef ENABLE_METRICS
+    return true;
+#else
+    return false;
+#endif
+}
+
+void TakeMetricsSnapshot(MetricsSnapshot &snapshot) {
+    Registry &registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (size_t m = 0; m < METRIC_COUNT; ++m) {
+        snapshot.values[m] = registry.retired[m];
+    }
+    for (const ThreadMetrics *thread : registry.threads) {
+        for (size_t m = 0; m < METRIC_COUNT; ++m) {
+            snapshot.values[m].count += thread->count[m].load(std::memory_order_relaxed);
+            snapshot.values[m].nanos += thread->nanos[m].load(std::memory_order_relaxed);
+            snapshot.values[m].bytes += thread->bytes[m].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+const char *MetricName(Metric metric) {
+    size_t m = (size_t)metric;
+    return m < METRIC_COUNT ? METRIC_NAMES[m] : "";
+}
+
+std::string ToPrometheusText(const MetricsSnapshot &snapshot) {
+    std::string text;
+    for (size_t m = 0; m < METRIC_COUNT; ++m) {
+        const std::string name = std::string("safeheron_tss_rsa_") + METRIC_NAMES[m];
+        const MetricValue &v = snapshot.values[m];
+        text += "# TYPE " + name + "_total counter\n";
+        text += name + "_total " + std::to_string(v.count) + "\n";
+        text += "# TYPE " + name + "_seconds_total counter\n";
+        text += name + "_seconds_total " + std::to_string((double)v.nanos / 1e9) + "\n";
+        text += "# TYPE " + name + "_bytes_total counter\n";
+        text += name + "_bytes_total " + std::to_string(v.bytes) + "\n";
+    }
+    return text;
+}
+
+namespace metrics {
+
+void Add(Metric metric, uint64_t count, uint64_t nanos, uint64_t bytes) {
+    thread_local ThreadMetrics thread_metrics;
+    size_t m = (size_t)metric;
+    Bump(thread_metrics.count[m], count);
+    Bump(thread_metrics.nanos[m], nanos);
+    Bump(thread_metrics.bytes[m], bytes);
+}
+
+}
+
+};
+};
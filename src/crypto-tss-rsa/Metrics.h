@@ -0,0 +1,130 @@
+#ifndef SAFEHERON_TSS_RSA_METRICS_H
+#define SAFEHERON_TSS_RSA_METRICS_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace safeheron {
+namespace tss_rsa{
+
+/**
+ * Instrumented phases and operations.
+ */
+enum class Metric {
+    KeyGen,        /**< GenerateKey, GenerateKeyEx, ReshareKey */
+    PrimeSearch,   /**< safe prime search of key generation */
+    Sign,          /**< a signature share, proof included */
+    Prove,         /**< proof of a signature share */
+    Verify,        /**< verification of the proof of a signature share */
+    ProofHash,     /**< Fiat-Shamir challenge of Prove and Verify */
+    Combine,       /**< combination of the shares of a signature */
+    PowM,          /**< modular exponentiations of MontgomeryContext */
+    PssEncode,     /**< EMSA-PSS-Encode, bytes of the messages */
+    PssVerify,     /**< EMSA-PSS-VERIFY, bytes of the messages */
+    Serialize,     /**< ToBytes of the key and signature objects, bytes written */
+    Deserialize,   /**< FromBytes of the key and signature objects and KeyStore::Find, bytes read */
+    Count
+};
+
+/**
+ * Totals of one metric over all the threads.
+ */
+struct MetricValue {
+    uint64_t count;   /**< number of operations */
+    uint64_t nanos;   /**< time spent in them, 0 for the untimed ones */
+    uint64_t bytes;   /**< bytes processed, 0 where it does not apply */
+};
+
+struct MetricsSnapshot {
+    MetricValue values[(size_t)Metric::Count];
+
+    const MetricValue &operator[](Metric metric) const { return values[(size_t)metric]; }
+};
+
+/**
+ * @return true if the library is built with -DENABLE_METRICS, otherwise the counters stay 0.
+ */
+bool MetricsEnabled();
+
+/**
+ * Read the counters. Every thread counts into its own counters, without locks; the snapshot adds them up,
+ * with the ones of the threads that exited. The counters of a thread may be read in the middle of an update of
+ * another metric, so a snapshot is exact only when the library is idle. Compare two snapshots to measure an
+ * interval.
+ * @param[out] snapshot
+ */
+void TakeMetricsSnapshot(MetricsSnapshot &snapshot);
+
+/**
+ * @param[in] metric
+ * @return name of the metric in snake case, e.g. "prime_search".
+ */
+const char *MetricName(Metric metric);
+
+/**
+ * Format a snapshot in the Prometheus text exposition format: per metric
+ * safeheron_tss_rsa_<name>_total, safeheron_tss_rsa_<name>_seconds_total and safeheron_tss_rsa_<name>_bytes_total.
+ * @param[in] snapshot
+ * @return text.
+ */
+std::string ToPrometheusText(const MetricsSnapshot &snapshot);
+
+namespace metrics {
+
+/**
+ * Add to the counters of the calling thread. Use the macros below instead, they compile to nothing without
+ * ENABLE_METRICS.
+ */
+void Add(Metric metric, uint64_t count, uint64_t nanos, uint64_t bytes);
+
+class ScopedTimer {
+public:
+    /**
+     * @param[in] metric
+     * @param[in] bytes bytes processed
+     * @param[in] count operations, 0 for a part of an operation counted elsewhere
+     */
+    explicit ScopedTimer(Metric metric, uint64_t bytes = 0, uint64_t count = 1)
+            : metric_(metric), bytes_(bytes), count_(count), start_(std::chrono::steady_clock::now()) {}
+
+    ~ScopedTimer() {
+        auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_);
+        Add(metric_, count_, (uint64_t)nanos.count(), bytes_);
+    }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+    Metric metric_;
+    uint64_t bytes_;
+    uint64_t count_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+}
+
+};
+};
+
+#ifdef ENABLE_METRICS
+#define SAFEHERON_TSS_RSA_METRIC_CONCAT_(a, b) a##b
+#define SAFEHERON_TSS_RSA_METRIC_CONCAT(a, b) SAFEHERON_TSS_RSA_METRIC_CONCAT_(a, b)
+/** Time the rest of the enclosing scope as one operation of metric, processing bytes bytes. */
+#define SAFEHERON_TSS_RSA_METRIC_SCOPE(metric, bytes) \
+    safeheron::tss_rsa::metrics::ScopedTimer SAFEHERON_TSS_RSA_METRIC_CONCAT(metric_timer_, __LINE__)(safeheron::tss_rsa::Metric::metric, (bytes))
+/** Time the rest of the enclosing scope as a part of an operation of metric counted elsewhere. */
+#define SAFEHERON_TSS_RSA_METRIC_SCOPE_PART(metric, bytes) \
+    safeheron::tss_rsa::metrics::ScopedTimer SAFEHERON_TSS_RSA_METRIC_CONCAT(metric_timer_, __LINE__)(safeheron::tss_rsa::Metric::metric, (bytes), 0)
+/** Count one untimed operation of metric, processing bytes bytes. */
+#define SAFEHERON_TSS_RSA_METRIC_COUNT(metric, bytes) \
+    safeheron::tss_rsa::metrics::Add(safeheron::tss_rsa::Metric::metric, 1, 0, (bytes))
+#else
+#define SAFEHERON_TSS_RSA_METRIC_SCOPE(metric, bytes) do {} while (0)
+#define SAFEHERON_TSS_RSA_METRIC_SCOPE_PART(metric, bytes) do {} while (0)
+#define SAFEHERON_TSS_RSA_METRIC_COUNT(metric, bytes) do {} while (0)
+#endif
+
+#endif //SAFEHERON_TSS_RSA_METRICS_H
@@ -0,0 +1,384 @@
+#include "MontgomeryContext.h"
+#include <string>
+#include <openssl/crypto.h>
+#include "exception/safeheron_exceptions.h"
+#include "FixedBN.h"
+#include "Metrics.h"
+
+using safeheron::bignum::BN;
+using safeheron::exception::LocatedException;
+using safeheron::exception::OpensslException;
+using safeheron::exception::BadAllocException;
+
+namespace safeheron {
+namespace tss_rsa{
+
+// Exponentiation on a FixedMontgomery kernel, the size is chosen at run time from the modulus.
+class FixedWidthKernel {
+public:
+    virtual ~FixedWidthKernel() {}
+    // base^exp mod n, 0 <= base < n, exp >= 0
+    virtual BN PowM(const BN &base, const BN &exp) const = 0;
+};
+
+namespace {
+
+#if defined(ENABLE_FIXED_BN) && defined(SAFEHERON_TSS_RSA_HAS_FIXED_BN)
+template <size_t BITS>
+class FixedWidthKernelImpl : public FixedWidthKernel {
+public:
+    typedef FixedBN<BITS> Num;
+
+    explicit FixedWidthKernelImpl(const BN &n) : mont_(Load(n), Load((BN(1) << (int)(128 * Num::LIMBS)) % n)) {}
+
+    BN PowM(const BN &base, const BN &exp) const override {
+        Num a = Load(base);
+        std::string e;
+        exp.ToBytesBE(e);
+        mont_.ToMontgomery(a, a);
+        mont_.Pow(a, a, (const uint8_t *)e.data(), e.size());
+        mont_.FromMontgomery(a, a);
+        std::string out;
+        a.ToBytesBE(out);
+        return BN::FromBytesBE(out);
+    }
+
+private:
+    static Num Load(const BN &a) {
+        std::string buf;
+        a.ToBytesBE(buf);
+        Num r;
+        r.FromBytesBE((const uint8_t *)buf.data(), buf.size());
+        return r;
+    }
+
+    FixedMontgomery<BITS> mont_;
+};
+
+FixedWidthKernel *NewFixedWidthKernel(const BN &n) {
+    switch ((n.BitLength() + 63) / 64 * 64) {
+        case 1024: return new FixedWidthKernelImpl<1024>(n);
+        case 2048: return new FixedWidthKernelImpl<2048>(n);
+        case 3072: return new FixedWidthKernelImpl<3072>(n);
+        case 4096: return new FixedWidthKernelImpl<4096>(n);
+        default: return nullptr;
+    }
+}
+#else
+FixedWidthKernel *NewFixedWidthKernel(const BN &) {
+    return nullptr;
+}
+#endif
+
+// Per thread BN_CTX, freed when the thread exits.
+struct ThreadBNCtx {
+    BN_CTX *ctx;
+    ThreadBNCtx() : ctx(BN_CTX_new()) {}
+    ~ThreadBNCtx() { BN_CTX_free(ctx); }
+};
+
+}
+
+BN_CTX *MontgomeryContext::ThreadCtx() {
+    static thread_local ThreadBNCtx holder;
+    if (holder.ctx == nullptr) {
+        throw BadAllocException(__FILE__, __LINE__, __FUNCTION__, -1, "BN_CTX_new failed");
+    }
+    return holder.ctx;
+}
+
+BIGNUMPtr MontgomeryContext::ToBIGNUM(const BN &a) {
+    std::string buf;
+    a.ToBytesBE(buf);
+    BIGNUMPtr r(BN_bin2bn((const unsigned char *)buf.data(), (int)buf.size(), nullptr));
+    if (!r) {
+        throw BadAllocException(__FILE__, __LINE__, __FUNCTION__, -1, "BN_bin2bn failed");
+    }
+    if (a < 0) BN_set_negative(r.get(), 1);
+    return r;
+}
+
+BN MontgomeryContext::ToBN(const BIGNUM *a) {
+    static thread_local std::string scratch;
+    scratch.resize((size_t)BN_num_bytes(a));
+    if (!scratch.empty()) BN_bn2bin(a, (unsigned char *)&scratch[0]);
+    BN r = BN::FromBytesBE((const uint8_t *)scratch.data(), scratch.size());
+    return BN_is_negative(a) ? r.Neg() : r;
+}
+
+namespace {
+
+// A frame of the BN_CTX of the calling thread, ended on scope exit whatever happens.
+class CtxFrame {
+public:
+    CtxFrame() : ctx_(MontgomeryContext::ThreadCtx()) { BN_CTX_start(ctx_); }
+    ~CtxFrame() { BN_CTX_end(ctx_); }
+
+    CtxFrame(const CtxFrame &) = delete;
+    CtxFrame &operator=(const CtxFrame &) = delete;
+
+    BN_CTX *ctx() const { return ctx_; }
+
+    BIGNUM *Get() {
+        BIGNUM *r = BN_CTX_get(ctx_);
+        if (r == nullptr) {
+            throw BadAllocException(__FILE__, __LINE__, __FUNCTION__, -1, "BN_CTX_get failed");
+        }
+        return r;
+    }
+
+private:
+    BN_CTX *ctx_;
+};
+
+// Copy a into r without allocating a BIGNUM; the bytes of a secret are wiped after use.
+void Load(const BN &a, BIGNUM *r, bool secret) {
+    static thread_local std::string scratch;
+    a.ToBytesBE(scratch);
+    bool ok = BN_bin2bn((const unsigned char *)scratch.data(), (int)scratch.size(), r) != nullptr;
+    if (secret && !scratch.empty()) OPENSSL_cleanse(&scratch[0], scratch.size());
+    if (!ok) {
+        throw BadAllocException(__FILE__, __LINE__, __FUNCTION__, -1, "BN_bin2bn failed");
+    }
+    BN_set_negative(r, a < 0 ? 1 : 0);
+}
+
+}
+
+MontgomeryContext::MontgomeryContext(const BN &n) : n_(n), mont_(nullptr) {
+    if (n <= 1 || n.IsEven()) {
+        throw LocatedException(__FILE__, __LINE__, __FUNCTION__, -1, "n must be odd and > 1");
+    }
+    n_bn_ = ToBIGNUM(n);
+    mont_ = BN_MONT_CTX_new();
+    if (mont_ == nullptr || !BN_MONT_CTX_set(mont_, n_bn_.get(), ThreadCtx())) {
+        BN_MONT_CTX_free(mont_);
+        throw OpensslException(__FILE__, __LINE__, __FUNCTION__, -1, "BN_MONT_CTX_set failed");
+    }
+    fixed_.reset(NewFixedWidthKernel(n));
+}
+
+MontgomeryContext::~MontgomeryContext() {
+    BN_MONT_CTX_free(mont_);
+}
+
+const BN &MontgomeryContext::n() const {
+    return n_;
+}
+
+BN MontgomeryContext::PowM(const BN &base, const BN &exp) const {
+    if (exp < 0) {
+        return PowM(base.InvM(n_), exp.Neg());
+    }
+    SAFEHERON_TSS_RSA_METRIC_SCOPE(PowM, 0);
+    if (fixed_) {
+        BN b = base % n_;
+        if (b < 0) b = b + n_;
+        return fixed_->PowM(b, exp);
+    }
+    BN_CTX *ctx = ThreadCtx();
+    BIGNUMPtr b = ToBIGNUM(base % n_);
+    BIGNUMPtr e = ToBIGNUM(exp);
+    BIGNUMPtr r(BN_new());
+    if (!r || !BN_mod_exp_mont(r.get(), b.get(), e.get(), n_bn_.get(), ctx, mont_)) {
+        throw OpensslException(__FILE__, __LINE__, __FUNCTION__, -1, "BN_mod_exp_mont failed");
+    }
+    return ToBN(r.get());
+}
+
+BN MontgomeryContext::PowMSecret(const BN &base, const BN &exp) const {
+    if (exp < 0) {
+        throw LocatedException(__FILE__, __LINE__, __FUNCTION__, -1, "exp must be >= 0");
+    }
+    SAFEHERON_TSS_RSA_METRIC_SCOPE(PowM, 0);
+    CtxFrame frame;
+    BIGNUM *t = frame.Get();
+    BIGNUM *b = frame.Get();
+    BIGNUM *e = frame.Get();
+    BIGNUM *r = frame.Get();
+    Load(base, t, false);
+    if (!BN_nnmod(b, t, n_bn_.get(), frame.ctx())) {
+        throw OpensslException(__FILE__, __LINE__, __FUNCTION__, -1, "BN_nnmod failed");
+    }
+    Load(exp, e, true);
+    BN_set_flags(e, BN_FLG_CONSTTIME);
+    bool ok = BN_mod_exp_mont_consttime(r, b, e, n_bn_.get(), frame.ctx(), mont_) == 1;
+    BN_clear(e);
+    if (!ok) {
+        throw OpensslException(__FILE__, __LINE__, __FUNCTION__, -1, "BN_mod_exp_mont_consttime failed");
+    }
+    return ToBN(r);
+}
+
+bool MontgomeryContext::fixed_width() const {
+    return fixed_ != nullptr;
+}
+
+// Window minimizing 2^w + t / w, the cost per base of a t-bit exponent
+static size_t StrausWindow(size_t exp_bits) {
+    size_t best = 1;
+    size_t best_cost = 2 + exp_bits;
+    for (size_t w = 2; w <= 6; w++) {
+        size_t cost = ((size_t)1 << w) + (exp_bits + w - 1) / w;
+        if (cost < best_cost) {
+            best = w;
+            best_cost = cost;
+        }
+    }
+    return best;
+}
+
+BN MontgomeryContext::MultiPowM(const std::vector<BN> &bases, const std::vector<BN> &exps) const {
+    SAFEHERON_TSS_RSA_METRIC_SCOPE(PowM, 0);
+    if (bases.size() != exps.size()) {
+        throw LocatedException(__FILE__, __LINE__, __FUNCTION__, -1, "bases.size() != exps.size()");
+    }
+
+    // g_i^-1 for the negative exponents: invert the product once, then peel off each inverse.
+    std::vector<BN> g(bases);
+    std::vector<BN> e(exps);
+    std::vector<size_t> neg;
+    for (size_t i = 0; i < e.size(); i++) {
+        if (e[i] < 0) {
+            neg.push_back(i);
+            e[i] = e[i].Neg();
+        }
+    }
+    if (!neg.empty()) {
+        std::vector<BN> prefix(neg.size());
+        prefix[0] = g[neg[0]] % n_;
+        for (size_t t = 1; t < neg.size(); t++) {
+            prefix[t] = MulM(prefix[t - 1], g[neg[t]]);
+        }
+        BN inv = prefix.back().InvM(n_);
+        for (size_t t = neg.size() - 1; t > 0; t--) {
+            BN g_t = g[neg[t]];
+            g[neg[t]] = MulM(inv, prefix[t - 1]);
+            inv = MulM(inv, g_t);
+        }
+        g[neg[0]] = inv;
+    }
+
+    size_t max_bits = 0;
+    for (const auto &ei : e) {
+        if (ei.BitLength() > max_bits) max_bits = ei.BitLength();
+    }
+    if (max_bits == 0) return BN(1);
+
+    // table[i][d] = g_i^d, d in [1, 2^w)
+    const size_t w = StrausWindow(max_bits);
+    const size_t table_size = (size_t)1 << w;
+    std::vector<std::vector<BIGNUMPtr>> table(g.size());
+    std::vector<BIGNUMPtr> e_bn;
+    for (size_t i = 0; i < g.size(); i++) {
+        e_bn.emplace_back(ToBIGNUM(e[i]));
+        if (e[i] == 0) continue;
+        size_t digits = e[i].BitLength() < w ? ((size_t)1 << e[i].BitLength()) : table_size;
+        table[i].resize(digits);
+        table[i][1] = ToMontgomery(g[i]);
+        for (size_t d = 2; d < digits; d++) {
+            table[i][d].reset(BN_new());
+            if (!table[i][d]) {
+                throw BadAllocException(__FILE__, __LINE__, __FUNCTION__, -1, "BN_new failed");
+            }
+            Mul(table[i][d].get(), table[i][d - 1].get(), table[i][1].get());
+        }
+    }
+
+    BIGNUMPtr acc = One();
+    bool started = false;
+    for (size_t j = (max_bits + w - 1) / w; j-- > 0; ) {
+        if (started) {
+            for (size_t s = 0; s < w; s++) Sqr(acc.get(), acc.get());
+        }
+        for (size_t i = 0; i < g.size(); i++) {
+            size_t digit = 0;
+            for (size_t s = 0; s < w; s++) {
+                if (BN_is_bit_set(e_bn[i].get(), (int)(j * w + s))) digit |= (size_t)1 << s;
+            }
+            if (digit != 0) {
+                Mul(acc.get(), acc.get(), table[i][digit].get());
+                started = true;
+            }
+        }
+    }
+    return FromMontgomery(acc.get());
+}
+
+BN MontgomeryContext::MulM(const BN &a, const BN &b) const {
+    // (a * R) * b * R^-1 = a * b mod n: one conversion and one multiplication
+    CtxFrame frame;
+    BIGNUM *t = frame.Get();
+    BIGNUM *am = frame.Get();
+    BIGNUM *bm = frame.Get();
+    Load(a, t, false);
+    if (!BN_nnmod(am, t, n_bn_.get(), frame.ctx()) || !BN_to_montgomery(am, am, mont_, frame.ctx())) {
+        throw OpensslException(__FILE__, __LINE__, __FUNCTION__, -1, "BN_to_montgomery failed");
+    }
+    Load(b, t, false);
+    if (!BN_nnmod(bm, t, n_bn_.get(), frame.ctx())) {
+        throw OpensslException(__FILE__, __LINE__, __FUNCTION__, -1, "BN_nnmod failed");
+    }
+    Mul(am, am, bm);
+    return ToBN(am);
+}
+
+BIGNUMPtr MontgomeryContext::ToMontgomery(const BN &a) const {
+    BIGNUMPtr r = ToBIGNUM(a % n_);
+    if (BN_is_negative(r.get())) BN_add(r.get(), r.get(), n_bn_.get());
+    if (!BN_to_montgomery(r.get(), r.get(), mont_, ThreadCtx())) {
+        throw OpensslException(__FILE__, __LINE__, __FUNCTION__, -1, "BN_to_montgomery failed");
+    }
+    return r;
+}
+
+BIGNUMPtr MontgomeryContext::ToMontgomery(const BIGNUM *a) const {
+    BN_CTX *ctx = ThreadCtx();
+    BIGNUMPtr r(BN_new());
+    if (!r || !BN_nnmod(r.get(), a, n_bn_.get(), ctx) || !BN_to_montgomery(r.get(), r.get(), mont_, ctx)) {
+        throw OpensslException(__FILE__, __LINE__, __FUNCTION__, -1, "BN_to_montgomery failed");
+    }
+    return r;
+}
+
+BN MontgomeryContext::FromMontgomery(const BIGNUM *a) const {
+    BIGNUMPtr r(BN_new());
+    if (!r || !BN_from_montgomery(r.get(), a, mont_, ThreadCtx())) {
+        throw OpensslException(__FILE__, __LINE__, __FUNCTION__, -1, "BN_from_montgomery failed");
+    }
+    return ToBN(r.get());
+}
+
+BIGNUMPtr MontgomeryContext::One() const {
+    return ToMontgomery(BN(1));
+}
+
+void MontgomeryContext::Mul(BIGNUM *r, const BIGNUM *a, const BIGNUM *b) const {
+    if (!BN_mod_mul_montgomery(r, a, b, mont_, ThreadCtx())) {
+        throw OpensslException(__FILE__, __LINE__, __FUNCTION__, -1, "BN_mod_mul_montgomery failed");
+    }
+}
+
+void MontgomeryContext::Sqr(BIGNUM *r, const BIGNUM *a) const {
+    Mul(r, a, a);
+}
+
+void MontgomeryContext::PowPublic(BIGNUM *r, const BIGNUM *a, const BN &e) const {
+    if (e <= 0) {
+        throw LocatedException(__FILE__, __LINE__, __FUNCTION__, -1, "e must be > 0");
+    }
+    BIGNUMPtr acc(BN_dup(a));
+    if (!acc) {
+        throw BadAllocException(__FILE__, __LINE__, __FUNCTION__, -1, "BN_dup failed");
+    }
+    for (size_t i = e.BitLength() - 1; i-- > 0; ) {
+        Sqr(acc.get(), acc.get());
+        if (e.IsBitSet(i)) Mul(acc.get(), acc.get(), a);
+    }
+    if (!BN_copy(r, acc.get())) {
+        throw BadAllocException(__FILE__, __LINE__, __FUNCTION__, -1, "BN_copy failed");
+    }
+}
+
+};
+};
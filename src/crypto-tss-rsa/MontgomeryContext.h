@@ -0,0 +1,160 @@
+#ifndef SAFEHERON_TSS_RSA_MONTGOMERY_CONTEXT_H
+#define SAFEHERON_TSS_RSA_MONTGOMERY_CONTEXT_H
+
+#include <memory>
+#include <vector>
+#include <openssl/bn.h>
+#include "crypto-bn/bn.h"
+
+namespace safeheron {
+namespace tss_rsa{
+
+struct BIGNUMDeleter {
+    void operator()(BIGNUM *a) const { BN_clear_free(a); }
+};
+
+typedef std::unique_ptr<BIGNUM, BIGNUMDeleter> BIGNUMPtr;
+
+class FixedWidthKernel;
+
+/**
+ * Montgomery arithmetic modulo a fixed odd modulus n.
+ *
+ * The OpenSSL BN_MONT_CTX is built once, instead of once per BN::PowM call, and is read-only
+ * afterwards, so a single context can be shared by many threads.
+ *
+ * When the library is built with ENABLE_FIXED_BN, PowM of a 1024, 2048, 3072 or 4096-bit modulus runs on the
+ * stack allocated FixedMontgomery kernel of that size instead of BN_mod_exp_mont. The option is off by default:
+ * on x86-64 the portable kernel is slower than the assembly Montgomery code of OpenSSL. It is meant for OpenSSL
+ * builds without assembly (no-asm), where BN_mod_exp_mont runs on generic C code as well and the kernel saves
+ * the allocations. Only PowM dispatches there, so the kernel only ever sees public exponents.
+ *
+ * PowMSecret and MulM, the operations of the signer, take their operands from the BN_CTX of the calling
+ * thread: the BIGNUMs and their limbs are reused from call to call instead of allocated.
+ */
+class MontgomeryContext{
+public:
+    /**
+     * Constructor.
+     * @param[in] n odd modulus, n > 1
+     */
+    explicit MontgomeryContext(const bignum::BN &n);
+
+    ~MontgomeryContext();
+
+    MontgomeryContext(const MontgomeryContext &) = delete;
+    MontgomeryContext &operator=(const MontgomeryContext &) = delete;
+
+    const bignum::BN &n() const;
+
+    /**
+     * base^exp mod n for a public exponent. The time depends on the bits of exp, both on BN_mod_exp_mont and on
+     * the fixed-width kernel: never pass a secret exponent, use PowMSecret instead.
+     * @param[in] base
+     * @param[in] exp public exponent, may be negative if base is invertible mod n
+     * @return base^exp mod n
+     */
+    bignum::BN PowM(const bignum::BN &base, const bignum::BN &exp) const;
+
+    /**
+     * base^exp mod n for a secret exponent, with BN_mod_exp_mont_consttime: the time does not depend on the
+     * bits of exp, only on its bit length. Never runs on the fixed-width kernel, which skips the zero windows.
+     * @param[in] base
+     * @param[in] exp exponent, >= 0
+     * @return base^exp mod n
+     */
+    bignum::BN PowMSecret(const bignum::BN &base, const bignum::BN &exp) const;
+
+    /**
+     * @return true if PowM runs on a fixed-width kernel.
+     */
+    bool fixed_width() const;
+
+    /**
+     * Simultaneous multi-exponentiation, prod_i bases[i]^exps[i] mod n.
+     *
+     * Straus / Shamir interleaving with a fixed window: one chain of squarings is shared by all the bases,
+     * so k exponentiations of t bits cost about t squarings and k * t / w multiplications, instead of
+     * k * t squarings. The bases with a negative exponent are inverted together with a single modular
+     * inversion (Montgomery's trick).
+     * @param[in] bases
+     * @param[in] exps exponents, bases.size() == exps.size()
+     * @return prod_i bases[i]^exps[i] mod n
+     */
+    bignum::BN MultiPowM(const std::vector<bignum::BN> &bases, const std::vector<bignum::BN> &exps) const;
+
+    /**
+     * a * b mod n
+     * @param[in] a
+     * @param[in] b
+     * @return a * b mod n
+     */
+    bignum::BN MulM(const bignum::BN &a, const bignum::BN &b) const;
+
+    /**
+     * Convert a BN into a Montgomery form BIGNUM: a * R mod n.
+     * @param[in] a
+     * @return a new BIGNUM.
+     */
+    BIGNUMPtr ToMontgomery(const bignum::BN &a) const;
+
+    /**
+     * Convert a BIGNUM into a Montgomery form BIGNUM: a * R mod n.
+     * @param[in] a
+     * @return a new BIGNUM.
+     */
+    BIGNUMPtr ToMontgomery(const BIGNUM *a) const;
+
+    /**
+     * Convert a Montgomery form BIGNUM back into a BN.
+     * @param[in] a
+     * @return a * R^-1 mod n
+     */
+    bignum::BN FromMontgomery(const BIGNUM *a) const;
+
+    /**
+     * @return 1 in Montgomery form: R mod n.
+     */
+    BIGNUMPtr One() const;
+
+    /**
+     * Montgomery multiplication, r = a * b * R^-1 mod n. r may alias a or b.
+     */
+    void Mul(BIGNUM *r, const BIGNUM *a, const BIGNUM *b) const;
+
+    /**
+     * Montgomery squaring, r = a * a * R^-1 mod n. r may alias a.
+     */
+    void Sqr(BIGNUM *r, const BIGNUM *a) const;
+
+    /**
+     * Exponentiation by a public exponent in Montgomery form, left-to-right square and multiply.
+     * For e = 65537 this is the chain of 16 squarings and 1 multiplication. Not constant time in e.
+     * @param[out] r a^e, may alias a
+     * @param[in] a Montgomery form
+     * @param[in] e exponent, > 0
+     */
+    void PowPublic(BIGNUM *r, const BIGNUM *a, const bignum::BN &e) const;
+
+    /**
+     * Convert between BN and BIGNUM. BN does not expose its BIGNUM, so the value is copied.
+     */
+    static BIGNUMPtr ToBIGNUM(const bignum::BN &a);
+    static bignum::BN ToBN(const BIGNUM *a);
+
+    /**
+     * @return a BN_CTX owned by the calling thread.
+     */
+    static BN_CTX *ThreadCtx();
+
+private:
+    bignum::BN n_;
+    BIGNUMPtr n_bn_;
+    BN_MONT_CTX *mont_;
+    std::unique_ptr<FixedWidthKernel> fixed_;  /**< nullptr unless built with ENABLE_FIXED_BN */
+};
+
+};
+};
+
+#endif //SAFEHERON_TSS_RSA_MONTGOMERY_CONTEXT_H
@@ -0,0 +1,26 @@
+#include "ProofTranscript.h"
+#include <string>
+
+using safeheron::bignum::BN;
+using safeheron::hash::CSHA256;
+
+namespace safeheron {
+namespace tss_rsa{
+
+ProofTranscript &ProofTranscript::Append(const BN &a) {
+    // Keeps its capacity, a modulus worth of bytes, for the life of the thread
+    static thread_local std::string scratch;
+    a.ToBytesBE(scratch);
+    sha256_.Write((const uint8_t *)scratch.data(), scratch.size());
+    return *this;
+}
+
+BN ProofTranscript::Challenge() const {
+    uint8_t digest[CSHA256::OUTPUT_SIZE];
+    CSHA256 sha256 = sha256_;
+    sha256.Finalize(digest);
+    return BN::FromBytesBE(digest, CSHA256::OUTPUT_SIZE);
+}
+
+};
+};
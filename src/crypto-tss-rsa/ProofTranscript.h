@@ -0,0 +1,39 @@
+#ifndef SAFEHERON_TSS_RSA_PROOF_TRANSCRIPT_H
+#define SAFEHERON_TSS_RSA_PROOF_TRANSCRIPT_H
+
+#include "crypto-bn/bn.h"
+#include "crypto-hash/sha256.h"
+
+namespace safeheron {
+namespace tss_rsa{
+
+/**
+ * Fiat-Shamir transcript of the signature share proofs, c = H(v, x_tilde, vi, x^2, v', x'): SHA256 over the
+ * big endian magnitudes of the numbers, concatenated without length prefix.
+ *
+ * The numbers are encoded into a scratch buffer of the calling thread, reused from one call to the next.
+ * A transcript is a value holding the hash midstate: copy it after a common prefix, v for a key or
+ * (v, x_tilde) for a document, and that prefix is hashed once for all the proofs.
+ */
+class ProofTranscript{
+public:
+    /**
+     * Append the big endian magnitude of a, no byte for 0.
+     * @param[in] a
+     * @return this transcript.
+     */
+    ProofTranscript &Append(const bignum::BN &a);
+
+    /**
+     * @return the digest of the numbers appended so far, as a number. The transcript is unchanged.
+     */
+    bignum::BN Challenge() const;
+
+private:
+    safeheron::hash::CSHA256 sha256_;
+};
+
+};
+};
+
+#endif //SAFEHERON_TSS_RSA_PROOF_TRANSCRIPT_H
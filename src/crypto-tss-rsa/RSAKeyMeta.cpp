@@ -1,6 +1,10 @@
 #include "RSAKeyMeta.h"
+#include <climits>
+#include <mutex>
 #include <google/protobuf/util/json_util.h>
 #include "crypto-encode/base64.h"
+#include "WireFormat.h"
+#include "KeyMetaPrecompute.h"
 
 using std::string;
 using google::protobuf::util::Status;
@@ -13,11 +17,19 @@ using safeheron::bignum::BN;
 namespace safeheron {
 namespace tss_rsa{
 
+struct KeyMetaPrecomputeSlot {
+    std::mutex mutex;
+    std::shared_ptr<const KeyMetaPrecompute> value;
+};
+
+RSAKeyMeta::RSAKeyMeta() : precompute_enabled_(true), precompute_(std::make_shared<KeyMetaPrecomputeSlot>()) {}
+
 RSAKeyMeta::RSAKeyMeta(int k,
            int l,
            const safeheron::bignum::BN &vkv,
            const std::vector<safeheron::bignum::BN> &vki_arr,
-           const safeheron::bignum::BN &vku){
+           const safeheron::bignum::BN &vku)
+           : precompute_enabled_(true), precompute_(std::make_shared<KeyMetaPrecomputeSlot>()){
     this->k_ = k;
     this->l_ = l;
     this->vkv_ = vkv;
@@ -47,6 +59,7 @@ const bignum::BN &RSAKeyMeta::vkv() const {
 
 void RSAKeyMeta::set_vkv(const bignum::BN &vkv) {
     vkv_ = vkv;
+    precompute_ = std::make_shared<KeyMetaPrecomputeSlot>();
 }
 
 const std::vector<safeheron::bignum::BN> &RSAKeyMeta::vki_arr() const {
@@ -56,6 +69,7 @@ const std::vector<safeheron::bignum::BN> &RSAKeyMeta::vki_arr() const {
 void RSAKeyMeta::set_vki_arr(const std::vector<safeheron::bignum::BN> &vki_arr) {
     this->vki_arr_.clear();
     this->vki_arr_.insert(this->vki_arr_.begin(), vki_arr.begin(), vki_arr.end());
+    precompute_ = std::make_shared<KeyMetaPrecomputeSlot>();
 }
 
 const safeheron::bignum::BN &RSAKeyMeta::vki(size_t index) const {
@@ -70,6 +84,25 @@ void RSAKeyMeta::set_vku(const bignum::BN &vku) {
     vku_ = vku;
 }
 
+std::shared_ptr<const KeyMetaPrecompute> RSAKeyMeta::Precompute(const bignum::BN &n) const {
+    // No slot after a move, until vkv or vki_arr is set again
+    if (!precompute_enabled_ || !precompute_) return nullptr;
+
+    std::lock_guard<std::mutex> lock(precompute_->mutex);
+    if (!precompute_->value || precompute_->value->n() != n) {
+        precompute_->value = std::make_shared<KeyMetaPrecompute>(n, vkv_, vki_arr_);
+    }
+    return precompute_->value;
+}
+
+void RSAKeyMeta::set_precompute_enabled(bool enabled) {
+    precompute_enabled_ = enabled;
+}
+
+bool RSAKeyMeta::precompute_enabled() const {
+    return precompute_enabled_;
+}
+
 bool RSAKeyMeta::ToProtoObject(proto::RSAKeyMeta &proof) const {
     bool ok = true;
 
@@ -79,16 +112,12 @@ bool RSAKeyMeta::ToProtoObject(proto::RSAKeyMeta &proof) const {
     if(l_ < 2) return false;
     proof.set_l(l_);
 
-    std::string str;
-    vkv_.ToHexStr(str);
-    proof.mutable_vkv()->assign(str);
+    vkv_.ToHexStr(*proof.mutable_vkv());
 
-    vku_.ToHexStr(str);
-    proof.mutable_vku()->assign(str);
+    vku_.ToHexStr(*proof.mutable_vku());
 
     for(size_t i = 0; i < vki_arr_.size(); ++i){
-        vki_arr_[i].ToHexStr(str);
-        proof.add_vki_arr(str);
+        vki_arr_[i].ToHexStr(*proof.add_vki_arr());
     }
     return true;
 }
@@ -110,6 +139,7 @@ bool RSAKeyMeta::FromProtoObject(const proto::RSAKeyMeta &proof) {
         BN alpha = BN::FromHexStr(proof.vki_arr(i));
         vki_arr_.push_back(alpha);
     }
+    precompute_ = std::make_shared<KeyMetaPrecomputeSlot>();
     return true;
 }
 
@@ -117,27 +147,87 @@ typedef RSAKeyMeta TheClass;
 typedef safeheron::proto::RSAKeyMeta ProtoObject;
 
 bool TheClass::ToBase64(string &b64) const {
-    bool ok = true;
     b64.clear();
-    safeheron::proto::RSAKeyMeta proto_object;
-    ok = ToProtoObject(proto_object);
-    if (!ok) return false;
+    google::protobuf::Arena arena;
+    string proto_bin;
+    if (!ToProtoBytes(arena, proto_bin)) return false;
 
-    string proto_bin = proto_object.SerializeAsString();
     b64 = encode::base64::EncodeToBase64(proto_bin, true);
     return true;
 }
 
 bool TheClass::FromBase64(const string &b64) {
-    bool ok = true;
-
     string data = encode::base64::DecodeFromBase64(b64);
 
-    safeheron::proto::RSAKeyMeta proto_object;
-    ok = proto_object.ParseFromString(data);
-    if (!ok) return false;
+    google::protobuf::Arena arena;
+    return FromProtoBytes(arena, data.data(), data.size());
+}
 
-    return FromProtoObject(proto_object);
+bool TheClass::ToProtoBytes(google::protobuf::Arena &arena, string &buf) const {
+    ProtoObject *proto_object = google::protobuf::Arena::CreateMessage<ProtoObject>(&arena);
+    if (!ToProtoObject(*proto_object)) return false;
+
+    size_t size = proto_object->ByteSizeLong();
+    if (size > INT_MAX) return false;
+    buf.resize(size);
+    return size == 0 || proto_object->SerializeToArray(&buf[0], (int)size);
+}
+
+bool TheClass::FromProtoBytes(google::protobuf::Arena &arena, const char *data, size_t size) {
+    if (size > INT_MAX) return false;
+    ProtoObject *proto_object = google::protobuf::Arena::CreateMessage<ProtoObject>(&arena);
+    if (!proto_object->ParseFromArray(data, (int)size)) return false;
+
+    return FromProtoObject(*proto_object);
+}
+
+bool TheClass::ToBytes(string &bytes) const {
+    if (k_ < 2 || l_ < 2) return false;
+    WireWriter writer(bytes);
+    writer.AddInt32(1, k_);
+    writer.AddInt32(2, l_);
+    bool ok = writer.AddBN(3, vkv_) && writer.AddBN(4, vku_);
+    for (size_t i = 0; ok && i < vki_arr_.size(); ++i) {
+        ok = writer.AddBN(5, vki_arr_[i]);
+    }
+    return ok;
+}
+
+bool TheClass::FromBytes(const string &bytes) {
+    return FromBytes(bytes.data(), bytes.size());
+}
+
+bool TheClass::FromBytes(const char *data, size_t size) {
+    bool ok = true;
+    int32_t k = 0, l = 0;
+    BN vkv, vku;
+    std::vector<BN> vki_arr;
+    WireReader reader((const uint8_t *)data, size);
+    while (ok && reader.Next()) {
+        switch (reader.field()) {
+            case 1: ok = reader.ReadInt32(k); break;
+            case 2: ok = reader.ReadInt32(l); break;
+            case 3: ok = reader.ReadBN(vkv); break;
+            case 4: ok = reader.ReadBN(vku); break;
+            case 5: {
+                BN vki;
+                ok = reader.ReadBN(vki);
+                vki_arr.push_back(vki);
+                break;
+            }
+            default: break;
+        }
+    }
+    if (!ok || !reader.Done()) return false;
+    if (k == 0 || l == 0) return false;
+
+    k_ = k;
+    l_ = l;
+    vkv_ = vkv;
+    vku_ = vku;
+    vki_arr_ = vki_arr;
+    precompute_ = std::make_shared<KeyMetaPrecomputeSlot>();
+    return true;
 }
 
 bool TheClass::ToJsonString(string &json_str) const {
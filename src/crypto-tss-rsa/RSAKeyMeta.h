@@ -1,6 +1,7 @@
 #ifndef SAFEHERON_RSA_KEY_META_H
 #define SAFEHERON_RSA_KEY_META_H
 
+#include <memory>
 #include <vector>
 #include "crypto-bn/bn.h"
 #include "proto_gen/tss_rsa.pb.switch.h"
@@ -8,12 +9,15 @@
 namespace safeheron {
 namespace tss_rsa{
 
+class KeyMetaPrecompute;
+struct KeyMetaPrecomputeSlot;
+
 class RSAKeyMeta{
 public:
     /**
      * Constructor.
      */
-    RSAKeyMeta(){}
+    RSAKeyMeta();
 
     /**
      * Constructor.
@@ -45,6 +49,22 @@ public:
     const bignum::BN &vku() const;
     void set_vku(const bignum::BN &vku);
 
+    /**
+     * Fixed-base exponentiation tables of vkv and vki, used to prove and verify signature shares.
+     * Built on first use and then shared by all the copies of this object, until vkv or vki_arr is changed.
+     * @param[in] n n = pq, from the public key
+     * @return the tables, or nullptr if precomputation is disabled or this object was moved from.
+     */
+    std::shared_ptr<const KeyMetaPrecompute> Precompute(const bignum::BN &n) const;
+
+    /**
+     * Enable or disable Precompute(). Enabled by default.
+     * The tables take about (L(N) + 512) / 6 residues for vkv, and 52 residues per party.
+     * @param[in] enabled
+     */
+    void set_precompute_enabled(bool enabled);
+    bool precompute_enabled() const;
+
     /**
      * Convert this object into a protobuf object.
      * @param[out] proof
@@ -73,6 +93,48 @@ public:
      */
     bool FromBase64(const std::string& base64);
 
+    /**
+     * Serialize the protobuf object of this object, the message ToBase64 encodes, into a caller provided buffer.
+     * The protobuf object is allocated on arena, call arena.Reset() to release it, e.g. once per batch.
+     * @param[in] arena
+     * @param[out] buf resized to the message size, its capacity is reused from call to call.
+     * @return true on success, false on error.
+     */
+    bool ToProtoBytes(google::protobuf::Arena &arena, std::string &buf) const;
+
+    /**
+     * Parse a protobuf message, the bytes FromBase64 decodes, into this object.
+     * The protobuf object is allocated on arena, call arena.Reset() to release it, e.g. once per batch.
+     * @param[in] arena
+     * @param[in] data message, not copied
+     * @param[in] size size of the message
+     * @return true on success, false on error.
+     */
+    bool FromProtoBytes(google::protobuf::Arena &arena, const char *data, size_t size);
+
+    /**
+     * Convert this object into bytes, the protobuf encoding of proto/tss_rsa_v2.proto:
+     * the big numbers are big endian bytes instead of hex strings.
+     * @param[out] bytes
+     * @return true on success, false on error.
+     */
+    bool ToBytes(std::string &bytes) const;
+
+    /**
+     * Convert bytes written by ToBytes into this object.
+     * @param[in] bytes
+     * @return true on success, false on error.
+     */
+    bool FromBytes(const std::string &bytes);
+
+    /**
+     * Convert bytes written by ToBytes into this object.
+     * @param[in] data message, not copied
+     * @param[in] size size of the message
+     * @return true on success, false on error.
+     */
+    bool FromBytes(const char *data, size_t size);
+
     /**
      * Convert this object into a json string.
      * @param[out] json_str
@@ -92,6 +154,8 @@ private:
     safeheron::bignum::BN vkv_;  /**< validation key */
     std::vector<safeheron::bignum::BN> vki_arr_;  /**< validation key array of all parties */
     safeheron::bignum::BN vku_;  /**< safe parameter for protocol 2 */
+    bool precompute_enabled_;  /**< whether Precompute() builds tables */
+    std::shared_ptr<KeyMetaPrecomputeSlot> precompute_;  /**< lazily built tables, shared by copies */
 
 };
 
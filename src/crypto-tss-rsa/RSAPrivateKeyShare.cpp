@@ -1,9 +1,14 @@
 #include "RSAPrivateKeyShare.h"
+#include <climits>
 #include "RSASigShare.h"
 #include "RSASigShareProof.h"
 #include "common.h"
+#include "MontgomeryContext.h"
+#include "KeyMetaPrecompute.h"
 #include <google/protobuf/util/json_util.h>
 #include "crypto-encode/base64.h"
+#include "WireFormat.h"
+#include "Metrics.h"
 #include "crypto-hash/hash256.h"
 
 using std::string;
@@ -40,20 +45,41 @@ void RSAPrivateKeyShare::set_i(int i) {
     i_ = i;
 }
 
+// Montgomery context of n: the one of the key meta tables when they are enabled, a new one otherwise.
+static std::shared_ptr<const MontgomeryContext> GetMontgomeryContext(const RSAKeyMeta &key_meta, const RSAPublicKey &public_key){
+    std::shared_ptr<const KeyMetaPrecompute> pre = key_meta.Precompute(public_key.n());
+    if(pre) return pre->mont_ptr();
+    std::shared_ptr<const MontgomeryContext> mont = public_key.mont();
+    if(mont) return mont;
+    return std::make_shared<MontgomeryContext>(public_key.n());
+}
+
 RSASigShare RSAPrivateKeyShare::InternalSign(const safeheron::bignum::BN &_x,
                                              const safeheron::tss_rsa::RSAKeyMeta &key_meta,
                                              const safeheron::tss_rsa::RSAPublicKey &public_key){
+    std::shared_ptr<const MontgomeryContext> mont = GetMontgomeryContext(key_meta, public_key);
+    BN vku_e(0);
+    return InternalSign(_x, key_meta, public_key, *mont, vku_e);
+}
+
+RSASigShare RSAPrivateKeyShare::InternalSign(const safeheron::bignum::BN &_x,
+                                             const safeheron::tss_rsa::RSAKeyMeta &key_meta,
+                                             const safeheron::tss_rsa::RSAPublicKey &public_key,
+                                             const MontgomeryContext &mont,
+                                             safeheron::bignum::BN &vku_e){
+    SAFEHERON_TSS_RSA_METRIC_SCOPE(Sign, 0);
     // x = x*u^e, if (m, n) == -1
     BN x = _x;
     if(BN::JacobiSymbol(x, public_key.n()) == -1){
-        x = (x * key_meta.vku().PowM(public_key.e(), public_key.n())) % public_key.n();
+        if(vku_e == 0) vku_e = mont.PowM(key_meta.vku(), public_key.e());
+        x = mont.MulM(x, vku_e);
     }
 
-    // x_i = x^{2 * s_i}
-    BN xi = x.PowM(si_ * 2, public_key.n());
+    // x_i = x^{2 * s_i}, constant time in s_i
+    BN xi = mont.PowMSecret(x, si_ * 2);
 
     RSASigShareProof proof;
-    proof.Prove(si_, key_meta.vkv(), key_meta.vki(i_-1), x, public_key.n(), xi);
+    proof.Prove(si_, key_meta, i_-1, x, public_key.n(), xi);
 
 
     return {i_, xi, proof.z(), proof.c()};
@@ -66,15 +92,27 @@ RSASigShare RSAPrivateKeyShare::Sign(const std::string &doc,
     return InternalSign(x, key_meta, public_key);
 }
 
+std::vector<RSASigShare> RSAPrivateKeyShare::SignBatch(const std::vector<std::string> &docs,
+                                                       const safeheron::tss_rsa::RSAKeyMeta &key_meta,
+                                                       const safeheron::tss_rsa::RSAPublicKey &public_key){
+    std::shared_ptr<const MontgomeryContext> mont = GetMontgomeryContext(key_meta, public_key);
+    BN vku_e(0);
+    std::vector<RSASigShare> sig_arr;
+    sig_arr.reserve(docs.size());
+    for(const auto &doc : docs){
+        BN x = BN::FromBytesBE(doc);
+        sig_arr.emplace_back(InternalSign(x, key_meta, public_key, *mont, vku_e));
+    }
+    return sig_arr;
+}
+
 bool RSAPrivateKeyShare::ToProtoObject(proto::RSAPrivateKeyShare &proof) const {
     bool ok = true;
 
     if(i_ == 0) return false;
     proof.set_i(i_);
 
-    std::string str;
-    si_.ToHexStr(str);
-    proof.mutable_si()->assign(str);
+    si_.ToHexStr(*proof.mutable_si());
 
     return true;
 }
@@ -94,27 +132,69 @@ typedef RSAPrivateKeyShare TheClass;
 typedef safeheron::proto::RSAPrivateKeyShare ProtoObject;
 
 bool TheClass::ToBase64(string &b64) const {
-    bool ok = true;
     b64.clear();
-    safeheron::proto::RSAPrivateKeyShare proto_object;
-    ok = ToProtoObject(proto_object);
-    if (!ok) return false;
+    google::protobuf::Arena arena;
+    string proto_bin;
+    if (!ToProtoBytes(arena, proto_bin)) return false;
 
-    string proto_bin = proto_object.SerializeAsString();
     b64 = encode::base64::EncodeToBase64(proto_bin, true);
     return true;
 }
 
 bool TheClass::FromBase64(const string &b64) {
-    bool ok = true;
-
     string data = encode::base64::DecodeFromBase64(b64);
 
-    safeheron::proto::RSAPrivateKeyShare proto_object;
-    ok = proto_object.ParseFromString(data);
-    if (!ok) return false;
+    google::protobuf::Arena arena;
+    return FromProtoBytes(arena, data.data(), data.size());
+}
 
-    return FromProtoObject(proto_object);
+bool TheClass::ToProtoBytes(google::protobuf::Arena &arena, string &buf) const {
+    ProtoObject *proto_object = google::protobuf::Arena::CreateMessage<ProtoObject>(&arena);
+    if (!ToProtoObject(*proto_object)) return false;
+
+    size_t size = proto_object->ByteSizeLong();
+    if (size > INT_MAX) return false;
+    buf.resize(size);
+    return size == 0 || proto_object->SerializeToArray(&buf[0], (int)size);
+}
+
+bool TheClass::FromProtoBytes(google::protobuf::Arena &arena, const char *data, size_t size) {
+    if (size > INT_MAX) return false;
+    ProtoObject *proto_object = google::protobuf::Arena::CreateMessage<ProtoObject>(&arena);
+    if (!proto_object->ParseFromArray(data, (int)size)) return false;
+
+    return FromProtoObject(*proto_object);
+}
+
+bool TheClass::ToBytes(string &bytes) const {
+    if (i_ == 0) return false;
+    WireWriter writer(bytes);
+    writer.AddInt32(1, i_);
+    return writer.AddBN(2, si_);
+}
+
+bool TheClass::FromBytes(const string &bytes) {
+    return FromBytes(bytes.data(), bytes.size());
+}
+
+bool TheClass::FromBytes(const char *data, size_t size) {
+    bool ok = true;
+    int32_t i = 0;
+    BN si;
+    WireReader reader((const uint8_t *)data, size);
+    while (ok && reader.Next()) {
+        switch (reader.field()) {
+            case 1: ok = reader.ReadInt32(i); break;
+            case 2: ok = reader.ReadBN(si); break;
+            default: break;
+        }
+    }
+    if (!ok || !reader.Done()) return false;
+    if (i == 0) return false;
+
+    i_ = i;
+    si_ = si;
+    return true;
 }
 
 bool TheClass::ToJsonString(string &json_str) const {
@@ -12,6 +12,8 @@
 namespace safeheron {
 namespace tss_rsa{
 
+class MontgomeryContext;
+
 class RSAPrivateKeyShare{
 public:
     /**
@@ -39,6 +41,18 @@ public:
                      const safeheron::tss_rsa::RSAKeyMeta &key_meta,
                      const safeheron::tss_rsa::RSAPublicKey &public_key);
 
+    /**
+     * Sign a batch of messages and create one signature share per message.
+     * The Montgomery context of n and vku^e mod n are computed once for the whole batch.
+     * @param[in] docs messages to sign.
+     * @param[in] key_meta meta data of key
+     * @param[in] public_key public key
+     * @return the RSASigShare objects, in the order of docs.
+     */
+    std::vector<RSASigShare> SignBatch(const std::vector<std::string> &docs,
+                                       const safeheron::tss_rsa::RSAKeyMeta &key_meta,
+                                       const safeheron::tss_rsa::RSAPublicKey &public_key);
+
     /**
      * Convert this object into a protobuf object.
      * @param[out] proof
@@ -67,6 +81,48 @@ public:
      */
     bool FromBase64(const std::string& base64);
 
+    /**
+     * Serialize the protobuf object of this object, the message ToBase64 encodes, into a caller provided buffer.
+     * The protobuf object is allocated on arena, call arena.Reset() to release it, e.g. once per batch.
+     * @param[in] arena
+     * @param[out] buf resized to the message size, its capacity is reused from call to call.
+     * @return true on success, false on error.
+     */
+    bool ToProtoBytes(google::protobuf::Arena &arena, std::string &buf) const;
+
+    /**
+     * Parse a protobuf message, the bytes FromBase64 decodes, into this object.
+     * The protobuf object is allocated on arena, call arena.Reset() to release it, e.g. once per batch.
+     * @param[in] arena
+     * @param[in] data message, not copied
+     * @param[in] size size of the message
+     * @return true on success, false on error.
+     */
+    bool FromProtoBytes(google::protobuf::Arena &arena, const char *data, size_t size);
+
+    /**
+     * Convert this object into bytes, the protobuf encoding of proto/tss_rsa_v2.proto:
+     * the big numbers are big endian bytes instead of hex strings.
+     * @param[out] bytes
+     * @return true on success, false on error.
+     */
+    bool ToBytes(std::string &bytes) const;
+
+    /**
+     * Convert bytes written by ToBytes into this object.
+     * @param[in] bytes
+     * @return true on success, false on error.
+     */
+    bool FromBytes(const std::string &bytes);
+
+    /**
+     * Convert bytes written by ToBytes into this object.
+     * @param[in] data message, not copied
+     * @param[in] size size of the message
+     * @return true on success, false on error.
+     */
+    bool FromBytes(const char *data, size_t size);
+
     /**
      * Convert this object into a json string.
      * @param[out] json_str
@@ -93,6 +149,21 @@ private:
                              const safeheron::tss_rsa::RSAKeyMeta &key_meta,
                              const safeheron::tss_rsa::RSAPublicKey &public_key);
 
+    /**
+     * Sign the message and create the signature share.
+     * @param x a BN object which indicate the message to sign.
+     * @param key_meta meta data of key
+     * @param public_key public key
+     * @param mont Montgomery context of n
+     * @param[in,out] vku_e vku^e mod n, computed on first need if 0
+     * @return a RSASigShare object.
+     */
+    RSASigShare InternalSign(const safeheron::bignum::BN &x,
+                             const safeheron::tss_rsa::RSAKeyMeta &key_meta,
+                             const safeheron::tss_rsa::RSAPublicKey &public_key,
+                             const MontgomeryContext &mont,
+                             safeheron::bignum::BN &vku_e);
+
 private:
     int i_;   /**< index of party. */
     safeheron::bignum::BN si_;  /**< secret share of party i. */
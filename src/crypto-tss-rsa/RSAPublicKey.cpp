@@ -1,8 +1,15 @@
 #include "RSAPublicKey.h"
+#include <climits>
+#include <algorithm>
+#include <mutex>
+#include <utility>
 #include "exception/safeheron_exceptions.h"
 #include <google/protobuf/util/json_util.h>
 #include "crypto-encode/base64.h"
+#include "WireFormat.h"
 #include "crypto-hash/hash256.h"
+#include "MontgomeryContext.h"
+#include "ThreadPool.h"
 
 using std::string;
 using google::protobuf::util::Status;
@@ -22,14 +29,44 @@ namespace safeheron {
 namespace tss_rsa{
 
 
-RSAPublicKey::RSAPublicKey(const safeheron::bignum::BN &n, const safeheron::bignum::BN &e){
+struct MontgomeryContextSlot {
+    std::mutex mutex;
+    std::shared_ptr<const MontgomeryContext> value;
+};
+
+RSAPublicKey::RSAPublicKey() : mont_(std::make_shared<MontgomeryContextSlot>()) {}
+
+RSAPublicKey::RSAPublicKey(const safeheron::bignum::BN &n, const safeheron::bignum::BN &e)
+        : mont_(std::make_shared<MontgomeryContextSlot>()){
     this->n_ = n;
     this->e_ = e;
 }
 
+RSAPublicKey::RSAPublicKey(RSAPublicKey &&other) noexcept
+        : n_(std::move(other.n_)), e_(std::move(other.e_)), mont_(other.mont_) {}
+
+RSAPublicKey &RSAPublicKey::operator=(RSAPublicKey &&other) noexcept {
+    n_ = std::move(other.n_);
+    e_ = std::move(other.e_);
+    mont_ = other.mont_;
+    return *this;
+}
+
+std::shared_ptr<const MontgomeryContext> RSAPublicKey::mont() const {
+    if (n_ <= 1 || n_.IsEven()) return nullptr;
+
+    std::lock_guard<std::mutex> lock(mont_->mutex);
+    if (!mont_->value || mont_->value->n() != n_) {
+        mont_->value = std::make_shared<MontgomeryContext>(n_);
+    }
+    return mont_->value;
+}
+
 bool RSAPublicKey::InternalVerifySignature(const safeheron::bignum::BN &x, const safeheron::bignum::BN &sig) {
     // check y^e = x  mod n, where y = sig
-    return sig.PowM(e_, n_) == (x % n_);
+    std::shared_ptr<const MontgomeryContext> mont = this->mont();
+    if (!mont) return sig.PowM(e_, n_) == (x % n_);
+    return mont->PowM(sig, e_) == (x % n_);
 }
 
 bool RSAPublicKey::VerifySignature(const string &doc, const safeheron::bignum::BN &sig){
@@ -37,12 +74,101 @@ bool RSAPublicKey::VerifySignature(const string &doc, const safeheron::bignum::B
     return InternalVerifySignature(x, sig);
 }
 
+const uint8_t RSAPublicKey::SIG_INVALID;
+const uint8_t RSAPublicKey::SIG_VALID;
+const uint8_t RSAPublicKey::SIG_SCREENED;
+
+// Maximum number of pairs per task of VerifySignatures.
+static const size_t VERIFY_CHUNK_SIZE = 64;
+
+bool RSAPublicKey::VerifySignatures(const std::vector<std::string> &doc_arr,
+                                    const std::vector<BN> &sig_arr,
+                                    std::vector<uint8_t> &result_arr,
+                                    bool screen,
+                                    ThreadPool *pool) const {
+    result_arr.assign(doc_arr.size(), SIG_INVALID);
+    if (sig_arr.size() != doc_arr.size()) return false;
+
+    std::shared_ptr<const MontgomeryContext> mont = this->mont();
+    if (!mont || e_ <= 0) {
+        for (size_t i = 0; i < doc_arr.size(); ++i) {
+            result_arr[i] = sig_arr[i].PowM(e_, n_) == (BN::FromBytesBE(doc_arr[i]) % n_) ? SIG_VALID : SIG_INVALID;
+        }
+        return std::find(result_arr.begin(), result_arr.end(), SIG_INVALID) == result_arr.end();
+    }
+
+    // At least 4 chunks per thread, so that idle threads have something to steal.
+    size_t chunk_size = VERIFY_CHUNK_SIZE;
+    if (pool) {
+        size_t per_thread = (doc_arr.size() + pool->thread_count() * 4 - 1) / (pool->thread_count() * 4);
+        chunk_size = std::max<size_t>(1, std::min(chunk_size, per_thread));
+    }
+
+    auto verify_chunk = [&](size_t chunk) {
+        const size_t begin = chunk * chunk_size;
+        const size_t end = std::min(begin + chunk_size, doc_arr.size());
+
+        // x_i and sig_i in Montgomery form, both reduced mod n
+        std::vector<BIGNUMPtr> x_arr, s_arr;
+        for (size_t i = begin; i < end; ++i) {
+            BIGNUMPtr x(BN_bin2bn((const unsigned char *)doc_arr[i].data(), (int)doc_arr[i].size(), nullptr));
+            if (!x) {
+                throw BadAllocException(__FILE__, __LINE__, __FUNCTION__, -1, "BN_bin2bn failed");
+            }
+            x_arr.emplace_back(mont->ToMontgomery(x.get()));
+            s_arr.emplace_back(mont->ToMontgomery(MontgomeryContext::ToBIGNUM(sig_arr[i]).get()));
+        }
+
+        // Zero residues would make both products zero whatever the other pairs are, so they are left out of the screen.
+        if (screen && end - begin > 1) {
+            BIGNUMPtr px = mont->One();
+            BIGNUMPtr ps = mont->One();
+            for (size_t j = 0; j < x_arr.size(); ++j) {
+                if (BN_is_zero(x_arr[j].get()) || BN_is_zero(s_arr[j].get())) continue;
+                mont->Mul(px.get(), px.get(), x_arr[j].get());
+                mont->Mul(ps.get(), ps.get(), s_arr[j].get());
+            }
+            mont->PowPublic(ps.get(), ps.get(), e_);
+            if (BN_cmp(ps.get(), px.get()) == 0) {
+                for (size_t j = 0; j < x_arr.size(); ++j) {
+                    bool zero = BN_is_zero(x_arr[j].get()) || BN_is_zero(s_arr[j].get());
+                    if (zero) {
+                        result_arr[begin + j] = BN_cmp(x_arr[j].get(), s_arr[j].get()) == 0 ? SIG_VALID : SIG_INVALID;
+                    } else {
+                        result_arr[begin + j] = SIG_SCREENED;
+                    }
+                }
+                return;
+            }
+        }
+
+        // sig_i^e == x_i mod n, compared in Montgomery form
+        for (size_t j = 0; j < x_arr.size(); ++j) {
+            if (BN_is_zero(s_arr[j].get())) {
+                result_arr[begin + j] = BN_is_zero(x_arr[j].get()) ? SIG_VALID : SIG_INVALID;
+                continue;
+            }
+            mont->PowPublic(s_arr[j].get(), s_arr[j].get(), e_);
+            result_arr[begin + j] = BN_cmp(s_arr[j].get(), x_arr[j].get()) == 0 ? SIG_VALID : SIG_INVALID;
+        }
+    };
+
+    const size_t chunk_count = (doc_arr.size() + chunk_size - 1) / chunk_size;
+    if (pool) {
+        pool->ParallelFor(chunk_count, verify_chunk);
+    } else {
+        for (size_t chunk = 0; chunk < chunk_count; ++chunk) verify_chunk(chunk);
+    }
+    return std::find(result_arr.begin(), result_arr.end(), SIG_INVALID) == result_arr.end();
+}
+
 const bignum::BN &RSAPublicKey::n() const {
     return n_;
 }
 
 void RSAPublicKey::set_n(const bignum::BN &n) {
     n_ = n;
+    mont_ = std::make_shared<MontgomeryContextSlot>();
 }
 
 const bignum::BN &RSAPublicKey::e() const {
@@ -56,12 +182,9 @@ void RSAPublicKey::set_e(const bignum::BN &e) {
 bool RSAPublicKey::ToProtoObject(proto::RSAPublicKey &proof) const {
     bool ok = true;
 
-    std::string str;
-    n_.ToHexStr(str);
-    proof.mutable_n()->assign(str);
+    n_.ToHexStr(*proof.mutable_n());
 
-    e_.ToHexStr(str);
-    proof.mutable_e()->assign(str);
+    e_.ToHexStr(*proof.mutable_e());
 
     return true;
 }
@@ -71,6 +194,7 @@ bool RSAPublicKey::FromProtoObject(const proto::RSAPublicKey &proof) {
 
     n_ = BN::FromHexStr(proof.n());
     e_ = BN::FromHexStr(proof.e());
+    mont_ = std::make_shared<MontgomeryContextSlot>();
 
     return true;
 }
@@ -79,27 +203,66 @@ typedef RSAPublicKey TheClass;
 typedef safeheron::proto::RSAPublicKey ProtoObject;
 
 bool TheClass::ToBase64(string &b64) const {
-    bool ok = true;
     b64.clear();
-    safeheron::proto::RSAPublicKey proto_object;
-    ok = ToProtoObject(proto_object);
-    if (!ok) return false;
+    google::protobuf::Arena arena;
+    string proto_bin;
+    if (!ToProtoBytes(arena, proto_bin)) return false;
 
-    string proto_bin = proto_object.SerializeAsString();
     b64 = encode::base64::EncodeToBase64(proto_bin, true);
     return true;
 }
 
 bool TheClass::FromBase64(const string &b64) {
-    bool ok = true;
-
     string data = encode::base64::DecodeFromBase64(b64);
 
-    safeheron::proto::RSAPublicKey proto_object;
-    ok = proto_object.ParseFromString(data);
-    if (!ok) return false;
+    google::protobuf::Arena arena;
+    return FromProtoBytes(arena, data.data(), data.size());
+}
 
-    return FromProtoObject(proto_object);
+bool TheClass::ToProtoBytes(google::protobuf::Arena &arena, string &buf) const {
+    ProtoObject *proto_object = google::protobuf::Arena::CreateMessage<ProtoObject>(&arena);
+    if (!ToProtoObject(*proto_object)) return false;
+
+    size_t size = proto_object->ByteSizeLong();
+    if (size > INT_MAX) return false;
+    buf.resize(size);
+    return size == 0 || proto_object->SerializeToArray(&buf[0], (int)size);
+}
+
+bool TheClass::FromProtoBytes(google::protobuf::Arena &arena, const char *data, size_t size) {
+    if (size > INT_MAX) return false;
+    ProtoObject *proto_object = google::protobuf::Arena::CreateMessage<ProtoObject>(&arena);
+    if (!proto_object->ParseFromArray(data, (int)size)) return false;
+
+    return FromProtoObject(*proto_object);
+}
+
+bool TheClass::ToBytes(string &bytes) const {
+    WireWriter writer(bytes);
+    return writer.AddBN(1, n_) && writer.AddBN(2, e_);
+}
+
+bool TheClass::FromBytes(const string &bytes) {
+    return FromBytes(bytes.data(), bytes.size());
+}
+
+bool TheClass::FromBytes(const char *data, size_t size) {
+    bool ok = true;
+    BN n, e;
+    WireReader reader((const uint8_t *)data, size);
+    while (ok && reader.Next()) {
+        switch (reader.field()) {
+            case 1: ok = reader.ReadBN(n); break;
+            case 2: ok = reader.ReadBN(e); break;
+            default: break;
+        }
+    }
+    if (!ok || !reader.Done()) return false;
+
+    n_ = n;
+    e_ = e;
+    mont_ = std::make_shared<MontgomeryContextSlot>();
+    return true;
 }
 
 bool TheClass::ToJsonString(string &json_str) const {
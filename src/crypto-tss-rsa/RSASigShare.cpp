@@ -1,6 +1,8 @@
 #include "RSASigShare.h"
+#include <climits>
 #include <google/protobuf/util/json_util.h>
 #include "crypto-encode/base64.h"
+#include "WireFormat.h"
 
 using std::string;
 using google::protobuf::util::Status;
@@ -63,15 +65,11 @@ bool RSASigShare::ToProtoObject(proto::RSASigShare &proof) const {
     if(index_ == 0) return false;
     proof.set_index(index_);
 
-    std::string str;
-    sig_share_.ToHexStr(str);
-    proof.mutable_sig_share()->assign(str);
+    sig_share_.ToHexStr(*proof.mutable_sig_share());
 
-    z_.ToHexStr(str);
-    proof.mutable_z()->assign(str);
+    z_.ToHexStr(*proof.mutable_z());
 
-    c_.ToHexStr(str);
-    proof.mutable_c()->assign(str);
+    c_.ToHexStr(*proof.mutable_c());
 
     return true;
 }
@@ -95,27 +93,73 @@ typedef RSASigShare TheClass;
 typedef safeheron::proto::RSASigShare ProtoObject;
 
 bool TheClass::ToBase64(string &b64) const {
-    bool ok = true;
     b64.clear();
-    safeheron::proto::RSASigShare proto_object;
-    ok = ToProtoObject(proto_object);
-    if (!ok) return false;
+    google::protobuf::Arena arena;
+    string proto_bin;
+    if (!ToProtoBytes(arena, proto_bin)) return false;
 
-    string proto_bin = proto_object.SerializeAsString();
     b64 = encode::base64::EncodeToBase64(proto_bin, true);
     return true;
 }
 
 bool TheClass::FromBase64(const string &b64) {
-    bool ok = true;
-
     string data = encode::base64::DecodeFromBase64(b64);
 
-    safeheron::proto::RSASigShare proto_object;
-    ok = proto_object.ParseFromString(data);
-    if (!ok) return false;
+    google::protobuf::Arena arena;
+    return FromProtoBytes(arena, data.data(), data.size());
+}
 
-    return FromProtoObject(proto_object);
+bool TheClass::ToProtoBytes(google::protobuf::Arena &arena, string &buf) const {
+    ProtoObject *proto_object = google::protobuf::Arena::CreateMessage<ProtoObject>(&arena);
+    if (!ToProtoObject(*proto_object)) return false;
+
+    size_t size = proto_object->ByteSizeLong();
+    if (size > INT_MAX) return false;
+    buf.resize(size);
+    return size == 0 || proto_object->SerializeToArray(&buf[0], (int)size);
+}
+
+bool TheClass::FromProtoBytes(google::protobuf::Arena &arena, const char *data, size_t size) {
+    if (size > INT_MAX) return false;
+    ProtoObject *proto_object = google::protobuf::Arena::CreateMessage<ProtoObject>(&arena);
+    if (!proto_object->ParseFromArray(data, (int)size)) return false;
+
+    return FromProtoObject(*proto_object);
+}
+
+bool TheClass::ToBytes(string &bytes) const {
+    if (index_ == 0) return false;
+    WireWriter writer(bytes);
+    writer.AddInt32(1, index_);
+    return writer.AddBN(2, sig_share_) && writer.AddBN(3, z_) && writer.AddBN(4, c_);
+}
+
+bool TheClass::FromBytes(const string &bytes) {
+    return FromBytes(bytes.data(), bytes.size());
+}
+
+bool TheClass::FromBytes(const char *data, size_t size) {
+    bool ok = true;
+    int32_t index = 0;
+    BN sig_share, z, c;
+    WireReader reader((const uint8_t *)data, size);
+    while (ok && reader.Next()) {
+        switch (reader.field()) {
+            case 1: ok = reader.ReadInt32(index); break;
+            case 2: ok = reader.ReadBN(sig_share); break;
+            case 3: ok = reader.ReadBN(z); break;
+            case 4: ok = reader.ReadBN(c); break;
+            default: break;
+        }
+    }
+    if (!ok || !reader.Done()) return false;
+    if (index == 0) return false;
+
+    index_ = index;
+    sig_share_ = sig_share;
+    z_ = z;
+    c_ = c;
+    return true;
 }
 
 bool TheClass::ToJsonString(string &json_str) const {
@@ -67,6 +67,48 @@ public:
      */
     bool FromBase64(const std::string& base64);
 
+    /**
+     * Serialize the protobuf object of this object, the message ToBase64 encodes, into a caller provided buffer.
+     * The protobuf object is allocated on arena, call arena.Reset() to release it, e.g. once per batch.
+     * @param[in] arena
+     * @param[out] buf resized to the message size, its capacity is reused from call to call.
+     * @return true on success, false on error.
+     */
+    bool ToProtoBytes(google::protobuf::Arena &arena, std::string &buf) const;
+
+    /**
+     * Parse a protobuf message, the bytes FromBase64 decodes, into this object.
+     * The protobuf object is allocated on arena, call arena.Reset() to release it, e.g. once per batch.
+     * @param[in] arena
+     * @param[in] data message, not copied
+     * @param[in] size size of the message
+     * @return true on success, false on error.
+     */
+    bool FromProtoBytes(google::protobuf::Arena &arena, const char *data, size_t size);
+
+    /**
+     * Convert this object into bytes, the protobuf encoding of proto/tss_rsa_v2.proto:
+     * the big numbers are big endian bytes instead of hex strings.
+     * @param[out] bytes
+     * @return true on success, false on error.
+     */
+    bool ToBytes(std::string &bytes) const;
+
+    /**
+     * Convert bytes written by ToBytes into this object.
+     * @param[in] bytes
+     * @return true on success, false on error.
+     */
+    bool FromBytes(const std::string &bytes);
+
+    /**
+     * Convert bytes written by ToBytes into this object.
+     * @param[in] data message, not copied
+     * @param[in] size size of the message
+     * @return true on success, false on error.
+     */
+    bool FromBytes(const char *data, size_t size);
+
     /**
      * Convert this object into a json string.
      * @param[out] json_str
@@ -3,8 +3,11 @@
 #include <google/protobuf/util/json_util.h>
 #include "exception/safeheron_exceptions.h"
 #include "crypto-bn/rand.h"
-#include "crypto-hash/sha256.h"
 #include "crypto-encode/base64.h"
+#include "WireFormat.h"
+#include "KeyMetaPrecompute.h"
+#include "FixedBaseTable.h"
+#include "Metrics.h"
 
 using std::string;
 using google::protobuf::util::Status;
@@ -17,7 +20,6 @@ using safeheron::exception::LocatedException;
 using safeheron::exception::OpensslException;
 using safeheron::exception::BadAllocException;
 using safeheron::exception::RandomSourceException;
-using safeheron::hash::CSHA256;
 
 namespace safeheron {
 namespace tss_rsa{
@@ -25,6 +27,18 @@ namespace tss_rsa{
 // Output length of SHA256 is 256
 static int L1 = 256;
 
+// c = H(v, x_tilde, vi, x^2, v', x'), the transcript holding (v, x_tilde)
+static BN Challenge(ProofTranscript transcript, const BN &vi, const BN &sig2, const BN &vp, const BN &xp){
+    SAFEHERON_TSS_RSA_METRIC_SCOPE(ProofHash, 0);
+    return transcript.Append(vi).Append(sig2).Append(vp).Append(xp).Challenge();
+}
+
+// c = H(v, x_tilde, vi, x^2, v', x')
+static BN Challenge(const BN &v, const BN &x_tilde, const BN &vi, const BN &sig2, const BN &vp, const BN &xp){
+    SAFEHERON_TSS_RSA_METRIC_SCOPE(ProofHash, 0);
+    return ProofTranscript().Append(v).Append(x_tilde).Append(vi).Append(sig2).Append(vp).Append(xp).Challenge();
+}
+
 RSASigShareProof::RSASigShareProof() : z_(bignum::BN::ZERO), c_(bignum::BN::ZERO) {}
 
 RSASigShareProof::RSASigShareProof(const bignum::BN &z, const bignum::BN &c) : z_(z), c_(c) {}
@@ -51,30 +65,22 @@ void RSASigShareProof::Prove(const safeheron::bignum::BN &si,
                              const safeheron::bignum::BN &x,
                              const safeheron::bignum::BN &n,
                              const safeheron::bignum::BN &sig_i){
+    SAFEHERON_TSS_RSA_METRIC_SCOPE(Prove, 0);
     // sample random r in (0, 2^(L(N) + 2*L1 + 1) )
     BN upper_bound = BN::TWO << (n.BitLength() + L1 * 2);
     BN r = safeheron::rand::RandomBNLt(upper_bound);
-    // v' = v^r
-    BN vp = v.PowM(r, n);
+    MontgomeryContext mont(n);
+    // v' = v^r, r hides si in z: constant time
+    BN vp = mont.PowMSecret(v, r);
     // x_tilde = x^4
-    BN x_tilde = x.PowM(BN::FOUR, n);
+    BN x_tilde = mont.PowM(x, BN::FOUR);
     // x' = x_tilde^r
-    BN xp = x_tilde.PowM(r, n);
+    BN xp = mont.PowMSecret(x_tilde, r);
     // sig^2
-    BN sig2 = sig_i.PowM(BN::TWO, n);
+    BN sig2 = mont.MulM(sig_i, sig_i);
 
     // c = H(v, x_tilde, vi, x^2, v', x')
-    uint8_t digest[CSHA256::OUTPUT_SIZE];
-    CSHA256 sha256;
-    std::string buf;
-    v.ToBytesBE(buf);         sha256.Write((const uint8_t *)buf.c_str(), buf.size());
-    x_tilde.ToBytesBE(buf);   sha256.Write((const uint8_t *)buf.c_str(), buf.size());
-    vi.ToBytesBE(buf);        sha256.Write((const uint8_t *)buf.c_str(), buf.size());
-    sig2.ToBytesBE(buf);      sha256.Write((const uint8_t *)buf.c_str(), buf.size());
-    vp.ToBytesBE(buf);        sha256.Write((const uint8_t *)buf.c_str(), buf.size());
-    xp.ToBytesBE(buf);        sha256.Write((const uint8_t *)buf.c_str(), buf.size());
-    sha256.Finalize(digest);
-    BN c = BN::FromBytesBE(digest, CSHA256::OUTPUT_SIZE);
+    BN c = Challenge(v, x_tilde, vi, sig2, vp, xp);
 
     // z = si * c + r
     BN z = si * c + r;
@@ -88,32 +94,140 @@ bool RSASigShareProof::Verify(const safeheron::bignum::BN &v,
                               const safeheron::bignum::BN &x,
                               const safeheron::bignum::BN &n,
                               const safeheron::bignum::BN &sig_i){
+    SAFEHERON_TSS_RSA_METRIC_SCOPE(Verify, 0);
+    MontgomeryContext mont(n);
     // v' = v^z * vi^(-c)  mod n
-    BN vp = ( v.PowM(z_, n) * vi.PowM(c_ * (-1), n) ) % n;
+    BN vp = mont.MultiPowM({v, vi}, {z_, c_ * (-1)});
     // x_tilde = x^4  mod n
-    BN x_tilde = x.PowM(BN::FOUR, n);
+    BN x_tilde = mont.PowM(x, BN::FOUR);
     // x' = x_tilde^z * x^(-2c)  mod n
-    BN xp = ( x_tilde.PowM(z_, n) * sig_i.PowM(c_ * (-2), n) ) % n;
+    BN xp = mont.MultiPowM({x_tilde, sig_i}, {z_, c_ * (-2)});
     // sig^2  mod n
-    BN sig2 = sig_i.PowM(BN::TWO, n);
+    BN sig2 = mont.MulM(sig_i, sig_i);
 
     // c = H(v, x_tilde, vi, x^2, v', x')
-    uint8_t digest[CSHA256::OUTPUT_SIZE];
-    CSHA256 sha256;
-    std::string buf;
-    v.ToBytesBE(buf);         sha256.Write((const uint8_t *)buf.c_str(), buf.size());
-    x_tilde.ToBytesBE(buf);   sha256.Write((const uint8_t *)buf.c_str(), buf.size());
-    vi.ToBytesBE(buf);        sha256.Write((const uint8_t *)buf.c_str(), buf.size());
-    sig2.ToBytesBE(buf);      sha256.Write((const uint8_t *)buf.c_str(), buf.size());
-    vp.ToBytesBE(buf);        sha256.Write((const uint8_t *)buf.c_str(), buf.size());
-    xp.ToBytesBE(buf);        sha256.Write((const uint8_t *)buf.c_str(), buf.size());
-    sha256.Finalize(digest);
-    BN c = BN::FromBytesBE(digest, CSHA256::OUTPUT_SIZE);
+    BN c = Challenge(v, x_tilde, vi, sig2, vp, xp);
 
     // check c == c_
     return c == c_;
 }
 
+void RSASigShareProof::Prove(const safeheron::bignum::BN &si,
+                             const RSAKeyMeta &key_meta,
+                             size_t index,
+                             const safeheron::bignum::BN &x,
+                             const safeheron::bignum::BN &n,
+                             const safeheron::bignum::BN &sig_i){
+    std::shared_ptr<const KeyMetaPrecompute> pre = key_meta.Precompute(n);
+    if(!pre){
+        Prove(si, key_meta.vkv(), key_meta.vki(index), x, n, sig_i);
+        return;
+    }
+    SAFEHERON_TSS_RSA_METRIC_SCOPE(Prove, 0);
+    const MontgomeryContext &mont = pre->mont();
+    const BN &v = key_meta.vkv();
+    const BN &vi = key_meta.vki(index);
+
+    // sample random r in (0, 2^(L(N) + 2*L1 + 1) )
+    BN upper_bound = BN::TWO << (n.BitLength() + L1 * 2);
+    BN r = safeheron::rand::RandomBNLt(upper_bound);
+    // v' = v^r, r hides si in z: constant time, not from the vkv table
+    BN vp = mont.PowMSecret(v, r);
+    // x_tilde = x^4
+    BN x_tilde = mont.PowM(x, BN::FOUR);
+    // x' = x_tilde^r
+    BN xp = mont.PowMSecret(x_tilde, r);
+    // sig^2
+    BN sig2 = mont.MulM(sig_i, sig_i);
+
+    // c = H(v, x_tilde, vi, x^2, v', x'), continuing the transcript of v
+    ProofTranscript transcript = pre->vkv_transcript();
+    transcript.Append(x_tilde);
+    BN c = Challenge(transcript, vi, sig2, vp, xp);
+
+    // z = si * c + r
+    z_ = si * c + r;
+    c_ = c;
+}
+
+bool RSASigShareProof::Verify(const RSAKeyMeta &key_meta,
+                              size_t index,
+                              const safeheron::bignum::BN &x,
+                              const safeheron::bignum::BN &n,
+                              const safeheron::bignum::BN &sig_i){
+    SigShareVerifyContext ctx(key_meta, x, n, 1);
+    return Verify(ctx, index, sig_i);
+}
+
+bool RSASigShareProof::Verify(const SigShareVerifyContext &ctx,
+                              size_t index,
+                              const safeheron::bignum::BN &sig_i) const{
+    SAFEHERON_TSS_RSA_METRIC_SCOPE(Verify, 0);
+    const BN &v = ctx.key_meta_.vkv();
+    const BN &vi = ctx.key_meta_.vki(index);
+    const BN &x_tilde = ctx.x_tilde_;
+    BN vp, xp, sig2;
+
+    const MontgomeryContext &mont = *ctx.mont_;
+    if(!ctx.pre_){
+        // v' = v^z * vi^(-c)  mod n
+        vp = mont.MultiPowM({v, vi}, {z_, c_ * (-1)});
+        // x' = x_tilde^z * x^(-2c)  mod n
+        xp = mont.MultiPowM({x_tilde, sig_i}, {z_, c_ * (-2)});
+        // sig^2  mod n
+        sig2 = mont.MulM(sig_i, sig_i);
+    }else{
+        // v' = v^z * vi^(-c)  mod n
+        vp = mont.MulM(ctx.pre_->PowVkv(z_), ctx.pre_->PowVkiInv(index, c_));
+        // x' = x_tilde^z * x^(-2c)  mod n
+        if(ctx.x_tilde_table_){
+            xp = mont.MulM(ctx.x_tilde_table_->PowM(z_), mont.PowM(sig_i, c_ * (-2)));
+        }else{
+            xp = mont.MultiPowM({x_tilde, sig_i}, {z_, c_ * (-2)});
+        }
+        // sig^2  mod n
+        sig2 = mont.MulM(sig_i, sig_i);
+    }
+
+    // c = H(v, x_tilde, vi, x^2, v', x')
+    BN c = Challenge(ctx.transcript_, vi, sig2, vp, xp);
+
+    // check c == c_
+    return c == c_;
+}
+
+SigShareVerifyContext::SigShareVerifyContext(const RSAKeyMeta &key_meta,
+                                             const safeheron::bignum::BN &x,
+                                             const safeheron::bignum::BN &n,
+                                             size_t share_count)
+        : key_meta_(key_meta), x_(x), n_(n), pre_(key_meta.Precompute(n)){
+    mont_ = pre_ ? pre_->mont_ptr() : std::make_shared<MontgomeryContext>(n);
+    // x_tilde = x^4  mod n
+    x_tilde_ = mont_->PowM(x, BN::FOUR);
+    transcript_ = pre_ ? pre_->vkv_transcript() : ProofTranscript().Append(key_meta.vkv());
+    transcript_.Append(x_tilde_);
+    if(pre_ && share_count > 1){
+        // z = si * c + r < 2^(L(N) + 2*L1 + 2)
+        x_tilde_table_ = std::make_shared<FixedBaseTable>(pre_->mont_ptr(), x_tilde_, n.BitLength() + 2 * L1 + 2);
+    }
+}
+
+const RSAKeyMeta &SigShareVerifyContext::key_meta() const {
+    return key_meta_;
+}
+
+const bignum::BN &SigShareVerifyContext::x() const {
+    return x_;
+}
+
+const bignum::BN &SigShareVerifyContext::n() const {
+    return n_;
+}
+
+const bignum::BN &SigShareVerifyContext::x_tilde() const {
+    return x_tilde_;
+}
+
 bool RSASigShareProof::ToProtoObject(proto::RSASigShareProof &proof) const {
     bool ok = true;
 
@@ -163,6 +277,29 @@ bool TheClass::FromBase64(const string &b64) {
     return FromProtoObject(proto_object);
 }
 
+bool TheClass::ToBytes(string &bytes) const {
+    WireWriter writer(bytes);
+    return writer.AddBN(1, z_) && writer.AddBN(2, c_);
+}
+
+bool TheClass::FromBytes(const string &bytes) {
+    bool ok = true;
+    BN z, c;
+    WireReader reader((const uint8_t *)bytes.data(), bytes.size());
+    while (ok && reader.Next()) {
+        switch (reader.field()) {
+            case 1: ok = reader.ReadBN(z); break;
+            case 2: ok = reader.ReadBN(c); break;
+            default: break;
+        }
+    }
+    if (!ok || !reader.Done()) return false;
+
+    z_ = z;
+    c_ = c;
+    return true;
+}
+
 bool TheClass::ToJsonString(string &json_str) const {
     bool ok = true;
     json_str.clear();
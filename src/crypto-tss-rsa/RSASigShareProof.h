@@ -1,13 +1,21 @@
 #ifndef SAFEHERON_RSA_SIGNATURE_SHARE_PROOF_H
 #define SAFEHERON_RSA_SIGNATURE_SHARE_PROOF_H
 
+#include <memory>
 #include "crypto-bn/bn.h"
 #include "proto_gen/tss_rsa.pb.switch.h"
+#include "RSAKeyMeta.h"
+#include "ProofTranscript.h"
 
 
 namespace safeheron {
 namespace tss_rsa{
 
+class KeyMetaPrecompute;
+class FixedBaseTable;
+class MontgomeryContext;
+class SigShareVerifyContext;
+
 class RSASigShareProof{
 public:
     /**
@@ -61,6 +69,48 @@ public:
                 const safeheron::bignum::BN &n,
                 const safeheron::bignum::BN &sig_i);
 
+    /**
+     * Create a proof of the signature share, with the fixed-base tables of key_meta (see RSAKeyMeta::Precompute).
+     * @param[in] si secret share of party i
+     * @param[in] key_meta key meta data
+     * @param[in] index index of party i in key_meta.vki_arr(), starting from 0
+     * @param[in] x x which represents the message
+     * @param[in] n n = pq
+     * @param[in] sig_i signature share of party i
+     */
+    void Prove(const safeheron::bignum::BN &si,
+               const RSAKeyMeta &key_meta,
+               size_t index,
+               const safeheron::bignum::BN &x,
+               const safeheron::bignum::BN &n,
+               const safeheron::bignum::BN &sig_i);
+
+    /**
+     * Verify the proof of the signature share, with the fixed-base tables of key_meta (see RSAKeyMeta::Precompute).
+     * @param[in] key_meta key meta data
+     * @param[in] index index of party i in key_meta.vki_arr(), starting from 0
+     * @param[in] x x which represents the message
+     * @param[in] n n = pq
+     * @param[in] sig_i signature share of party i
+     * @return true on success, false on error.
+     */
+    bool Verify(const RSAKeyMeta &key_meta,
+                size_t index,
+                const safeheron::bignum::BN &x,
+                const safeheron::bignum::BN &n,
+                const safeheron::bignum::BN &sig_i);
+
+    /**
+     * Verify the proof of the signature share, reusing the per-document state of ctx.
+     * @param[in] ctx verification context of the document
+     * @param[in] index index of party i in key_meta.vki_arr(), starting from 0
+     * @param[in] sig_i signature share of party i
+     * @return true on success, false on error.
+     */
+    bool Verify(const SigShareVerifyContext &ctx,
+                size_t index,
+                const safeheron::bignum::BN &sig_i) const;
+
     /**
      * Convert this object into a protobuf object.
      * @param[out] proof
@@ -89,6 +139,21 @@ public:
      */
     bool FromBase64(const std::string& base64);
 
+    /**
+     * Convert this object into bytes, the protobuf encoding of proto/tss_rsa_v2.proto:
+     * the big numbers are big endian bytes instead of hex strings.
+     * @param[out] bytes
+     * @return true on success, false on error.
+     */
+    bool ToBytes(std::string &bytes) const;
+
+    /**
+     * Convert bytes written by ToBytes into this object.
+     * @param[in] bytes
+     * @return true on success, false on error.
+     */
+    bool FromBytes(const std::string &bytes);
+
     /**
      * Convert this object into a json string.
      * @param[out] json_str
@@ -107,6 +172,50 @@ private:
     safeheron::bignum::BN c_;
 };
 
+/**
+ * Per-document state for verifying several signature share proofs of the same x.
+ *
+ * x_tilde = x^4 is computed once and, when more than one share is expected, a fixed-base table of
+ * x_tilde is built for the x_tilde^z term, so that each share only pays for the short exponentiation
+ * sig_i^(-2c). Together with the tables of RSAKeyMeta::Precompute(), this takes most of the cost out of
+ * validated combining.
+ *
+ * The proofs are (c, z) with c = H(..., v', x'). Every v' and x' must be rebuilt exactly before hashing,
+ * so the proofs can not be merged into one random linear combination. Each share is still checked on
+ * its own, which directly identifies a bad share.
+ */
+class SigShareVerifyContext{
+public:
+    /**
+     * Constructor.
+     * @param[in] key_meta key meta data, must outlive the context
+     * @param[in] x x which represents the message
+     * @param[in] n n = pq
+     * @param[in] share_count number of shares to be verified, a fixed-base table of x_tilde is built if > 1
+     */
+    SigShareVerifyContext(const RSAKeyMeta &key_meta,
+                          const safeheron::bignum::BN &x,
+                          const safeheron::bignum::BN &n,
+                          size_t share_count);
+
+    const RSAKeyMeta &key_meta() const;
+    const safeheron::bignum::BN &x() const;
+    const safeheron::bignum::BN &n() const;
+    const safeheron::bignum::BN &x_tilde() const;
+
+private:
+    friend class RSASigShareProof;
+
+    const RSAKeyMeta &key_meta_;
+    safeheron::bignum::BN x_;
+    safeheron::bignum::BN n_;
+    std::shared_ptr<const KeyMetaPrecompute> pre_;    /**< nullptr if precomputation is disabled */
+    std::shared_ptr<const MontgomeryContext> mont_;   /**< Montgomery context of n */
+    safeheron::bignum::BN x_tilde_;                   /**< x^4 mod n */
+    std::shared_ptr<const FixedBaseTable> x_tilde_table_;  /**< nullptr for a single share */
+    ProofTranscript transcript_;                      /**< proof transcript holding v and x_tilde */
+};
+
 
 };
 };
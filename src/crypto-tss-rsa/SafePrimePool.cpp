@@ -0,0 +1,226 @@
+#include "SafePrimePool.h"
+#include <memory>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include "crypto-bn/rand.h"
+#include "exception/safeheron_exceptions.h"
+#include "SafePrimeSearch.h"
+
+using safeheron::bignum::BN;
+using safeheron::exception::LocatedException;
+using safeheron::exception::OpensslException;
+
+namespace safeheron {
+namespace tss_rsa{
+
+namespace {
+
+const size_t KEY_SIZE = 32;
+const size_t NONCE_SIZE = 12;
+const size_t TAG_SIZE = 16;
+
+struct CipherCtxDeleter {
+    void operator()(EVP_CIPHER_CTX *ctx) const { EVP_CIPHER_CTX_free(ctx); }
+};
+
+void AppendUint32BE(std::string &out, uint32_t v) {
+    for (int i = 3; i >= 0; --i) out.push_back((char)((v >> (8 * i)) & 0xff));
+}
+
+uint32_t ReadUint32BE(const std::string &in, size_t pos) {
+    uint32_t v = 0;
+    for (size_t i = 0; i < 4; ++i) v = (v << 8) | (uint8_t)in[pos + i];
+    return v;
+}
+
+void Cleanse(std::string &s) {
+    if (!s.empty()) OPENSSL_cleanse(&s[0], s.size());
+}
+
+}
+
+SafePrimePool::SafePrimePool(const std::vector<size_t> &key_bits_length_arr,
+                             size_t capacity,
+                             size_t low_water_mark,
+                             size_t thread_count)
+        : capacity_(capacity), low_water_mark_(low_water_mark), thread_count_(thread_count),
+          key_(KEY_SIZE, '\0'), nonce_counter_(0), stop_(false), cancel_(false) {
+    if (key_bits_length_arr.empty() || capacity == 0 || low_water_mark >= capacity) {
+        throw LocatedException(__FILE__, __LINE__, __FUNCTION__, -1, "invalid pool parameters");
+    }
+    for (size_t key_bits_length : key_bits_length_arr) {
+        stores_[key_bits_length].refilling = true;
+    }
+    safeheron::rand::RandomBytes((uint8_t *)&key_[0], key_.size());
+    worker_ = std::thread(&SafePrimePool::Run, this);
+}
+
+SafePrimePool::~SafePrimePool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cancel_ = true;
+    cv_.notify_all();
+    worker_.join();
+    for (auto &item : stores_) {
+        for (auto &sealed : item.second.pairs) Cleanse(sealed);
+    }
+    Cleanse(key_);
+}
+
+bool SafePrimePool::Supports(size_t key_bits_length) const {
+    return stores_.find(key_bits_length) != stores_.end();
+}
+
+SafePrimePoolStats SafePrimePool::Stats(size_t key_bits_length) const {
+    SafePrimePoolStats stats = {0, 0, 0, 0, 0, 0};
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = stores_.find(key_bits_length);
+    if (iter == stores_.end()) return stats;
+    stats.available = iter->second.pairs.size();
+    stats.capacity = capacity_;
+    stats.low_water_mark = low_water_mark_;
+    stats.generated = iter->second.generated;
+    stats.taken = iter->second.taken;
+    stats.misses = iter->second.misses;
+    return stats;
+}
+
+bool SafePrimePool::TryTake(size_t key_bits_length, BN &p, BN &q) {
+    std::string sealed;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto iter = stores_.find(key_bits_length);
+        if (iter == stores_.end()) return false;
+        Store &store = iter->second;
+        if (store.pairs.empty()) {
+            store.misses++;
+        } else {
+            sealed.swap(store.pairs.front());
+            store.pairs.pop_front();
+            store.taken++;
+        }
+        if (store.pairs.size() <= low_water_mark_ && !store.refilling) {
+            store.refilling = true;
+            cv_.notify_all();
+        }
+    }
+    if (sealed.empty()) return false;
+    Open(sealed, p, q);
+    return true;
+}
+
+void SafePrimePool::Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        size_t key_bits_length = 0;
+        cv_.wait(lock, [&] {
+            if (stop_) return true;
+            for (auto &item : stores_) {
+                if (item.second.refilling) {
+                    key_bits_length = item.first;
+                    return true;
+                }
+            }
+            return false;
+        });
+        if (stop_) return;
+
+        lock.unlock();
+        BN p, q;
+        bool ok = true;
+        try {
+            ok = RandomSafePrimePairParallel(key_bits_length / 2, key_bits_length / 2 - 1, thread_count_, p, q,
+                                             &cancel_);
+        } catch (...) {
+            ok = false;
+        }
+        lock.lock();
+        if (stop_) return;
+
+        Store &store = stores_[key_bits_length];
+        std::string sealed;
+        if (ok) {
+            try {
+                sealed = Seal(p, q);
+            } catch (...) {
+                ok = false;
+            }
+        }
+        if (!ok) {
+            // Give up this refill, the next TryTake below the low-water mark starts another one.
+            store.refilling = false;
+            continue;
+        }
+        store.pairs.push_back(std::move(sealed));
+        store.generated++;
+        if (store.pairs.size() >= capacity_) store.refilling = false;
+    }
+}
+
+// Called with mutex_ held, for nonce_counter_.
+std::string SafePrimePool::Seal(const BN &p, const BN &q) {
+    std::string plain, p_bytes, q_bytes;
+    p.ToBytesBE(p_bytes);
+    q.ToBytesBE(q_bytes);
+    AppendUint32BE(plain, (uint32_t)p_bytes.size());
+    plain += p_bytes;
+    plain += q_bytes;
+    Cleanse(p_bytes);
+    Cleanse(q_bytes);
+
+    std::string nonce(NONCE_SIZE, '\0');
+    uint64_t counter = nonce_counter_++;
+    for (size_t i = 0; i < 8; ++i) nonce[NONCE_SIZE - 1 - i] = (char)((counter >> (8 * i)) & 0xff);
+
+    std::string out = nonce;
+    out.resize(NONCE_SIZE + plain.size() + TAG_SIZE);
+    unsigned char *ct = (unsigned char *)&out[NONCE_SIZE];
+    int len = 0;
+    std::unique_ptr<EVP_CIPHER_CTX, CipherCtxDeleter> ctx(EVP_CIPHER_CTX_new());
+    bool ok = ctx &&
+              EVP_EncryptInit_ex(ctx.get(), EVP_aes_256_gcm(), nullptr,
+                                 (const unsigned char *)key_.data(), (const unsigned char *)nonce.data()) == 1 &&
+              EVP_EncryptUpdate(ctx.get(), ct, &len, (const unsigned char *)plain.data(), (int)plain.size()) == 1 &&
+              EVP_EncryptFinal_ex(ctx.get(), ct + len, &len) == 1 &&
+              EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_GET_TAG, (int)TAG_SIZE, ct + plain.size()) == 1;
+    Cleanse(plain);
+    if (!ok) {
+        throw OpensslException(__FILE__, __LINE__, __FUNCTION__, -1, "AES-256-GCM encryption failed");
+    }
+    return out;
+}
+
+void SafePrimePool::Open(const std::string &sealed, BN &p, BN &q) const {
+    if (sealed.size() < NONCE_SIZE + 4 + TAG_SIZE) {
+        throw LocatedException(__FILE__, __LINE__, __FUNCTION__, -1, "invalid sealed pair");
+    }
+    size_t ct_size = sealed.size() - NONCE_SIZE - TAG_SIZE;
+    const unsigned char *ct = (const unsigned char *)sealed.data() + NONCE_SIZE;
+    std::string plain(ct_size, '\0');
+    std::string tag = sealed.substr(NONCE_SIZE + ct_size);
+    int len = 0;
+    std::unique_ptr<EVP_CIPHER_CTX, CipherCtxDeleter> ctx(EVP_CIPHER_CTX_new());
+    bool ok = ctx &&
+              EVP_DecryptInit_ex(ctx.get(), EVP_aes_256_gcm(), nullptr,
+                                 (const unsigned char *)key_.data(), (const unsigned char *)sealed.data()) == 1 &&
+              EVP_DecryptUpdate(ctx.get(), (unsigned char *)&plain[0], &len, ct, (int)ct_size) == 1 &&
+              EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_SET_TAG, (int)TAG_SIZE, &tag[0]) == 1 &&
+              EVP_DecryptFinal_ex(ctx.get(), (unsigned char *)&plain[len], &len) == 1;
+    if (!ok) {
+        Cleanse(plain);
+        throw OpensslException(__FILE__, __LINE__, __FUNCTION__, -1, "AES-256-GCM decryption failed");
+    }
+    uint32_t p_size = ReadUint32BE(plain, 0);
+    if (4 + (size_t)p_size > plain.size()) {
+        Cleanse(plain);
+        throw LocatedException(__FILE__, __LINE__, __FUNCTION__, -1, "invalid sealed pair");
+    }
+    p = BN::FromBytesBE((const uint8_t *)plain.data() + 4, p_size);
+    q = BN::FromBytesBE((const uint8_t *)plain.data() + 4 + p_size, plain.size() - 4 - p_size);
+    Cleanse(plain);
+}
+
+};
+};
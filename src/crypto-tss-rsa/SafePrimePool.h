@@ -0,0 +1,119 @@
+#ifndef SAFEHERON_TSS_RSA_SAFE_PRIME_POOL_H
+#define SAFEHERON_TSS_RSA_SAFE_PRIME_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "crypto-bn/bn.h"
+
+namespace safeheron {
+namespace tss_rsa{
+
+/**
+ * Fill level and counters of the pool of one key length.
+ */
+struct SafePrimePoolStats {
+    size_t available;   /**< pairs ready to be taken */
+    size_t capacity;    /**< maximum number of pairs kept */
+    size_t low_water_mark;  /**< a refill starts when available <= low_water_mark */
+    uint64_t generated; /**< pairs generated since construction */
+    uint64_t taken;     /**< pairs handed out */
+    uint64_t misses;    /**< TryTake calls that found the pool empty */
+};
+
+/**
+ * A pool of pre-generated safe prime pairs (p, q) for key generation.
+ *
+ * For every key length given to the constructor, the pool keeps up to "capacity" pairs with the sizes used
+ * by GenerateKey: p of key_bits_length / 2 bits and q of key_bits_length / 2 - 1 bits. A background thread
+ * fills all the pools to capacity on construction, and refills a pool once its fill level drops to the
+ * low-water mark. The pairs are searched with RandomSafePrimePairParallel on thread_count threads.
+ *
+ * The pool is in memory only: nothing is persisted, and the pairs are lost with the object. They are kept
+ * encrypted with AES-256-GCM under a random key generated by the constructor and held in the same object
+ * as the ciphertexts. This only keeps the primes from sitting in plain text in memory until they are
+ * taken; it does not protect them from anyone who can read the memory of the process.
+ *
+ * All the methods are thread safe.
+ */
+class SafePrimePool {
+public:
+    /**
+     * Constructor. Starts the background generation.
+     * @param[in] key_bits_length_arr key lengths to keep pairs for, e.g. {2048, 3072, 4096}.
+     * @param[in] capacity maximum number of pairs per key length, > 0.
+     * @param[in] low_water_mark refill threshold, < capacity.
+     * @param[in] thread_count threads of the prime search, 0 for std::thread::hardware_concurrency().
+     */
+    SafePrimePool(const std::vector<size_t> &key_bits_length_arr,
+                  size_t capacity,
+                  size_t low_water_mark,
+                  size_t thread_count = 1);
+
+    /**
+     * Destructor. Cancels the current search, which stops at its next candidate, and joins the background thread.
+     */
+    ~SafePrimePool();
+
+    SafePrimePool(const SafePrimePool &) = delete;
+    SafePrimePool &operator=(const SafePrimePool &) = delete;
+
+    /**
+     * Take a pair without waiting.
+     * @param[in] key_bits_length key length the pair is for.
+     * @param[out] p safe prime of key_bits_length / 2 bits.
+     * @param[out] q safe prime of key_bits_length / 2 - 1 bits.
+     * @return true on success, false if the pool of key_bits_length is empty or does not exist.
+     */
+    bool TryTake(size_t key_bits_length, safeheron::bignum::BN &p, safeheron::bignum::BN &q);
+
+    /**
+     * @param[in] key_bits_length
+     * @return true if the pool keeps pairs for key_bits_length.
+     */
+    bool Supports(size_t key_bits_length) const;
+
+    /**
+     * @param[in] key_bits_length
+     * @return fill level and counters of the pool of key_bits_length, all zero if it does not exist.
+     */
+    SafePrimePoolStats Stats(size_t key_bits_length) const;
+
+private:
+    struct Store {
+        std::deque<std::string> pairs;  /**< nonce | ciphertext | tag */
+        uint64_t generated = 0;
+        uint64_t taken = 0;
+        uint64_t misses = 0;
+        bool refilling = false;         /**< filling up to capacity, until it is full */
+    };
+
+    void Run();
+    std::string Seal(const safeheron::bignum::BN &p, const safeheron::bignum::BN &q);
+    void Open(const std::string &sealed, safeheron::bignum::BN &p, safeheron::bignum::BN &q) const;
+
+private:
+    const size_t capacity_;
+    const size_t low_water_mark_;
+    const size_t thread_count_;
+    std::string key_;                 /**< AES-256-GCM key */
+    uint64_t nonce_counter_;          /**< nonce = counter, never reused under key_ */
+    std::map<size_t, Store> stores_;  /**< key_bits_length => pairs */
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_;
+    std::atomic<bool> cancel_;        /**< polled by the running search, set with stop_ */
+    std::thread worker_;
+};
+
+};
+};
+
+#endif //SAFEHERON_TSS_RSA_SAFE_PRIME_POOL_H
@@ -0,0 +1,216 @@
+#include "SafePrimeSearch.h"
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "crypto-bn/rand.h"
+
+using safeheron::bignum::BN;
+
+namespace safeheron {
+namespace tss_rsa{
+
+namespace {
+
+// Odd primes below SIEVE_LIMIT are used to sieve the candidates.
+const uint32_t SIEVE_LIMIT = 1 << 13;
+
+// Number of consecutive candidates p', p' + 2, ... tried from one random start.
+const uint32_t RUN_LENGTH = 1 << 14;
+
+// Below this size the sieve may reject the small safe primes themselves.
+const size_t MIN_SIEVE_BITS = 64;
+
+const std::vector<uint32_t> &SmallPrimes() {
+    static const std::vector<uint32_t> primes = [] {
+        std::vector<uint32_t> r;
+        std::vector<bool> composite(SIEVE_LIMIT, false);
+        for (uint32_t i = 3; i < SIEVE_LIMIT; i += 2) {
+            if (composite[i]) continue;
+            r.push_back(i);
+            for (uint32_t j = i * i; j < SIEVE_LIMIT; j += 2 * i) composite[j] = true;
+        }
+        return r;
+    }();
+    return primes;
+}
+
+// a^(n-1) == 1 mod n for a = 2
+bool FermatBase2(const BN &n) {
+    return BN::TWO.PowM(n - 1, n) == 1;
+}
+
+struct Slot {
+    size_t bits;
+    std::atomic<bool> found;
+    BN prime;
+
+    explicit Slot(size_t b) : bits(b), found(false) {}
+};
+
+class SafePrimeSearch {
+public:
+    SafePrimeSearch(const std::vector<size_t> &bits_arr, const std::atomic<bool> *cancel)
+            : aborted_(false), cancel_(cancel) {
+        for (size_t bits : bits_arr) slots_.emplace_back(new Slot(bits));
+    }
+
+    ~SafePrimeSearch() {
+        for (Slot *slot : slots_) delete slot;
+    }
+
+    // Empty if cancelled before every slot was filled.
+    std::vector<BN> Run(size_t thread_count) {
+        if (thread_count == 0) thread_count = std::thread::hardware_concurrency();
+        if (thread_count == 0) thread_count = 1;
+
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < thread_count; ++i) {
+            threads.emplace_back(&SafePrimeSearch::Work, this, i);
+        }
+        Work(0);
+        for (auto &t : threads) t.join();
+
+        if (error_) std::rethrow_exception(error_);
+
+        std::vector<BN> r;
+        for (Slot *slot : slots_) {
+            if (!slot->found.load()) return std::vector<BN>();
+            r.push_back(slot->prime);
+        }
+        return r;
+    }
+
+private:
+    bool Stopped() const {
+        return aborted_.load() || (cancel_ && cancel_->load());
+    }
+
+    // The slot with index id % slot_count first, then any slot that is still open.
+    Slot *Pick(size_t id) {
+        if (Stopped()) return nullptr;
+        Slot *preferred = slots_[id % slots_.size()];
+        if (!preferred->found.load()) return preferred;
+        for (Slot *slot : slots_) {
+            if (!slot->found.load()) return slot;
+        }
+        return nullptr;
+    }
+
+    void Work(size_t id) {
+        try {
+            while (Slot *slot = Pick(id)) {
+                Search(*slot);
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!error_) error_ = std::current_exception();
+            aborted_ = true;
+        }
+    }
+
+    // One run of candidates from a random start, stops early once the slot is filled.
+    void Search(Slot &slot) {
+        const std::vector<uint32_t> &primes = SmallPrimes();
+
+        // p' has bits - 1 bits with the two top bits set, so that p = 2p' + 1 has the two top bits set too.
+        const size_t pp_bits = slot.bits - 1;
+        std::string buf((pp_bits + 7) / 8, '\0');
+        safeheron::rand::RandomBytes((uint8_t *)&buf[0], buf.size());
+        size_t top_bits = pp_bits - (buf.size() - 1) * 8;
+        uint8_t &top = (uint8_t &)buf[0];
+        top &= (uint8_t)((1u << top_bits) - 1);
+        if (top_bits >= 2) {
+            top |= (uint8_t)(3u << (top_bits - 2));
+        } else {
+            top |= 1;
+            ((uint8_t &)buf[1]) |= 0x80;
+        }
+        ((uint8_t &)buf[buf.size() - 1]) |= 1;
+        const BN start = BN::FromBytesBE(buf);
+
+        // residues[i] = p' mod primes[i]
+        std::vector<uint32_t> residues(primes.size());
+        for (size_t i = 0; i < primes.size(); ++i) {
+            uint64_t r = 0;
+            for (char c : buf) r = ((r << 8) | (uint8_t)c) % primes[i];
+            residues[i] = (uint32_t)r;
+        }
+
+        for (uint32_t offset = 0; offset < RUN_LENGTH; offset += 2) {
+            if (slot.found.load() || Stopped()) return;
+
+            // p' is sieved out if p' = 0 or 2p' + 1 = 0 mod r, that is p' = 0 or (r - 1) / 2 mod r
+            bool sieved = false;
+            for (size_t i = 0; i < primes.size(); ++i) {
+                if (offset != 0) {
+                    residues[i] += 2;
+                    if (residues[i] >= primes[i]) residues[i] -= primes[i];
+                }
+                if (residues[i] == 0 || residues[i] == (primes[i] - 1) / 2) sieved = true;
+            }
+            if (sieved) continue;
+
+            BN pp = start + (long)offset;
+            if (pp.BitLength() != pp_bits) return;
+            if (!FermatBase2(pp)) continue;
+            BN p = pp * 2 + 1;
+            if (!FermatBase2(p)) continue;
+            if (slot.found.load() || Stopped()) return;
+            if (!pp.IsProbablyPrime() || !p.IsProbablyPrime()) continue;
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!slot.found.load()) {
+                slot.prime = p;
+                slot.found = true;
+            }
+            return;
+        }
+    }
+
+private:
+    std::vector<Slot *> slots_;
+    std::atomic<bool> aborted_;
+    const std::atomic<bool> *cancel_;
+    std::mutex mutex_;
+    std::exception_ptr error_;
+};
+
+}
+
+BN RandomSafePrimeParallel(size_t bits, size_t thread_count) {
+    if (bits < MIN_SIEVE_BITS) {
+        return safeheron::rand::RandomSafePrime(bits);
+    }
+    SafePrimeSearch search({bits}, nullptr);
+    return search.Run(thread_count)[0];
+}
+
+bool RandomSafePrimePairParallel(size_t p_bits, size_t q_bits, size_t thread_count, BN &p, BN &q,
+                                 const std::atomic<bool> *cancel) {
+    if (p_bits < MIN_SIEVE_BITS || q_bits < MIN_SIEVE_BITS) {
+        p = safeheron::rand::RandomSafePrime(p_bits);
+        do {
+            q = safeheron::rand::RandomSafePrime(q_bits);
+        } while (p == q);
+        return true;
+    }
+    SafePrimeSearch search({p_bits, q_bits}, cancel);
+    std::vector<BN> r = search.Run(thread_count);
+    if (r.empty()) return false;
+    p = r[0];
+    q = r[1];
+    while (p == q) {
+        SafePrimeSearch retry({q_bits}, cancel);
+        r = retry.Run(thread_count);
+        if (r.empty()) return false;
+        q = r[0];
+    }
+    return true;
+}
+
+};
+};
@@ -0,0 +1,47 @@
+#ifndef SAFEHERON_TSS_RSA_SAFE_PRIME_SEARCH_H
+#define SAFEHERON_TSS_RSA_SAFE_PRIME_SEARCH_H
+
+#include <atomic>
+#include <cstddef>
+#include "crypto-bn/bn.h"
+
+namespace safeheron {
+namespace tss_rsa{
+
+/**
+ * Generate a random safe prime p = 2p' + 1 of "bits" bits, with the two top bits set,
+ * by searching on several threads at once.
+ *
+ * Every thread walks its own run of candidates p' = s, s + 2, s + 4, ... from a random start s.
+ * Candidates where p' or 2p' + 1 has a small prime factor are sieved out with incrementally
+ * updated residues, the survivors go through a base-2 Fermat test on p' and p, and only then
+ * through the Miller-Rabin test of BN::IsProbablyPrime. The first thread to find a safe prime
+ * cancels the others.
+ *
+ * @param[in] bits bit length of p.
+ * @param[in] thread_count number of threads, 0 for std::thread::hardware_concurrency().
+ * @return a safe prime.
+ */
+safeheron::bignum::BN RandomSafePrimeParallel(size_t bits, size_t thread_count);
+
+/**
+ * Generate two random safe primes at the same time, see RandomSafePrimeParallel.
+ * The threads are split between p and q, and the threads of the first one found join the search for the other.
+ *
+ * @param[in] p_bits bit length of p.
+ * @param[in] q_bits bit length of q.
+ * @param[in] thread_count number of threads, 0 for std::thread::hardware_concurrency().
+ * @param[out] p a safe prime of p_bits bits.
+ * @param[out] q a safe prime of q_bits bits, q != p.
+ * @param[in] cancel if not nullptr, the search gives up once *cancel is true; it is polled between two
+ *            candidates. Sizes below 64 bits are not sieved and not cancellable, they only take a moment.
+ * @return true on success, false if cancelled.
+ */
+bool RandomSafePrimePairParallel(size_t p_bits, size_t q_bits, size_t thread_count,
+                                 safeheron::bignum::BN &p, safeheron::bignum::BN &q,
+                                 const std::atomic<bool> *cancel = nullptr);
+
+};
+};
+
+#endif //SAFEHERON_TSS_RSA_SAFE_PRIME_SEARCH_H
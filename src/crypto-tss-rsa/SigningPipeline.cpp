@@ -0,0 +1,238 @@
+#include "SigningPipeline.h"
+#include <algorithm>
+#include <set>
+#include "exception/safeheron_exceptions.h"
+#include "RSASigShareProof.h"
+#include "tss_rsa.h"
+
+using safeheron::bignum::BN;
+using safeheron::exception::LocatedException;
+
+namespace safeheron {
+namespace tss_rsa{
+
+struct SigningPipeline::Job {
+    std::string doc;
+    std::once_flag prepared;
+    std::unique_ptr<SigShareVerifyContext> verify_ctx;  /**< built by the first share to be verified */
+    std::set<int> seen;                                 /**< parties that handed in a share */
+    std::vector<RSASigShare> valid;                     /**< verified shares, fixed once combining */
+    std::vector<int> invalid_indices;
+    BN sig;
+    bool combining = false;
+    bool done = false;
+};
+
+SigningPipeline::SigningPipeline(const CombineContext &ctx,
+                                 size_t max_pending,
+                                 size_t max_queued_shares,
+                                 ThreadPool *pool)
+        : ctx_(ctx), max_pending_(max_pending), max_queued_shares_(max_queued_shares), pool_(pool),
+          queued_shares_(0), scheduled_(0), next_id_(1), stop_(false) {
+    if (max_pending == 0 || max_queued_shares == 0) {
+        throw LocatedException(__FILE__, __LINE__, __FUNCTION__, -1, "invalid pipeline parameters");
+    }
+}
+
+SigningPipeline::~SigningPipeline() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+    space_cv_.notify_all();
+    result_cv_.notify_all();
+    // The tasks still queued in the pool find stop_ set and return at once.
+    idle_cv_.wait(lock, [this] { return scheduled_ == 0; });
+}
+
+size_t SigningPipeline::pending() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return jobs_.size() + results_.size();
+}
+
+void SigningPipeline::RegisterLocked(const std::string &doc, uint64_t id) {
+    std::shared_ptr<Job> job = std::make_shared<Job>();
+    job->doc = doc;
+    jobs_[id] = job;
+}
+
+uint64_t SigningPipeline::Submit(const std::string &doc) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    space_cv_.wait(lock, [this] { return stop_ || jobs_.size() + results_.size() < max_pending_; });
+    if (stop_) {
+        throw LocatedException(__FILE__, __LINE__, __FUNCTION__, -1, "pipeline stopped");
+    }
+    uint64_t id = next_id_++;
+    RegisterLocked(doc, id);
+    return id;
+}
+
+bool SigningPipeline::TrySubmit(const std::string &doc, uint64_t &id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stop_ || jobs_.size() + results_.size() >= max_pending_) return false;
+    id = next_id_++;
+    RegisterLocked(doc, id);
+    return true;
+}
+
+bool SigningPipeline::AddShare(uint64_t id, const RSASigShare &share) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    space_cv_.wait(lock, [this] { return stop_ || queued_shares_ < max_queued_shares_; });
+    if (stop_) return false;
+
+    auto iter = jobs_.find(id);
+    if (iter == jobs_.end()) return false;
+    std::shared_ptr<Job> job = iter->second;
+    if (job->combining) return false;
+    if (share.index() < 1 || share.index() > ctx_.key_meta().l()) return false;
+    if (!job->seen.insert(share.index()).second) return false;
+
+    queued_shares_++;
+    PushTaskLocked([this, id, job, share] { Verify(id, job, share); });
+    lock.unlock();
+    Schedule();
+    return true;
+}
+
+bool SigningPipeline::Cancel(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = jobs_.find(id);
+    if (iter == jobs_.end()) return false;
+    FinishLocked(id, *iter->second, false);
+    return true;
+}
+
+void SigningPipeline::WaitResult(SigningResult &result) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    result_cv_.wait(lock, [this] { return stop_ || !results_.empty(); });
+    if (results_.empty()) {
+        throw LocatedException(__FILE__, __LINE__, __FUNCTION__, -1, "pipeline stopped");
+    }
+    result = std::move(results_.front());
+    results_.pop_front();
+    space_cv_.notify_all();
+}
+
+bool SigningPipeline::TryTakeResult(SigningResult &result) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (results_.empty()) return false;
+    result = std::move(results_.front());
+    results_.pop_front();
+    space_cv_.notify_all();
+    return true;
+}
+
+void SigningPipeline::FinishLocked(uint64_t id, Job &job, bool ok) {
+    job.done = true;
+    SigningResult result;
+    result.id = id;
+    result.ok = ok;
+    result.invalid_indices = job.invalid_indices;
+    if (ok) {
+        result.sig = job.sig;
+        for (const auto &share : job.valid) result.signers.push_back(share.index());
+        std::sort(result.signers.begin(), result.signers.end());
+    }
+    results_.push_back(std::move(result));
+    jobs_.erase(id);
+    result_cv_.notify_all();
+}
+
+void SigningPipeline::PushTaskLocked(std::function<void()> task) {
+    tasks_.push_back(std::move(task));
+    scheduled_++;
+}
+
+void SigningPipeline::Schedule() {
+    if (pool_) {
+        try {
+            pool_->Submit([this] { RunTask(); });
+            return;
+        } catch (...) {
+            // Not queued: run it here, scheduled_ must still go down.
+        }
+    }
+    RunTask();
+}
+
+// Every task queued by PushTaskLocked is matched by one RunTask, which runs the oldest queued task.
+void SigningPipeline::RunTask() {
+    std::function<void()> task;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!stop_ && !tasks_.empty()) {
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+    }
+    if (task) task();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--scheduled_ == 0) idle_cv_.notify_all();
+}
+
+void SigningPipeline::Verify(uint64_t id, std::shared_ptr<Job> job, RSASigShare share) {
+    bool combine = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queued_shares_--;
+        space_cv_.notify_all();
+        // Complete, or enough shares already: the proof is not needed any more.
+        if (job->done || job->combining) return;
+    }
+
+    bool valid = false;
+    try {
+        // Per document: x and the verification context shared by its shares, as in CombineSignaturesBatch.
+        std::call_once(job->prepared, [&] {
+            const RSAPublicKey &public_key = ctx_.public_key();
+            BN x = BN::FromBytesBE(job->doc);
+            if (BN::JacobiSymbol(x, public_key.n()) == -1) {
+                x = ctx_.mont().MulM(x, ctx_.vku_e());
+            }
+            job->verify_ctx.reset(new SigShareVerifyContext(ctx_.key_meta(), x, public_key.n(),
+                                                            (size_t)ctx_.key_meta().k()));
+        });
+        RSASigShareProof proof(share.z(), share.c());
+        valid = proof.Verify(*job->verify_ctx, share.index() - 1, share.sig_share());
+    } catch (...) {
+        valid = false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (job->done || job->combining) return;
+        if (valid) {
+            job->valid.push_back(share);
+            if (job->valid.size() == (size_t)ctx_.key_meta().k()) {
+                job->combining = true;
+                PushTaskLocked([this, id, job] { Combine(id, job); });
+                combine = true;
+            }
+        } else {
+            job->invalid_indices.push_back(share.index());
+            // Fewer than k parties left that could still hand in a valid share
+            if ((int)job->invalid_indices.size() > ctx_.key_meta().l() - ctx_.key_meta().k()) {
+                FinishLocked(id, *job, false);
+            }
+        }
+    }
+    if (combine) Schedule();
+}
+
+void SigningPipeline::Combine(uint64_t id, std::shared_ptr<Job> job) {
+    // job->valid does not change once combining is set.
+    BN sig;
+    bool ok = false;
+    try {
+        ok = CombineSignaturesWithoutValidation(job->doc, job->valid, ctx_, sig);
+    } catch (...) {
+        ok = false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (job->done) return;
+    job->sig = sig;
+    FinishLocked(id, *job, ok);
+}
+
+};
+};
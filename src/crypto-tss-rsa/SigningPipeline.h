@@ -0,0 +1,158 @@
+#ifndef SAFEHERON_TSS_RSA_SIGNING_PIPELINE_H
+#define SAFEHERON_TSS_RSA_SIGNING_PIPELINE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "crypto-bn/bn.h"
+#include "CombineContext.h"
+#include "RSASigShare.h"
+#include "ThreadPool.h"
+
+namespace safeheron {
+namespace tss_rsa{
+
+/**
+ * Outcome of one document of a SigningPipeline.
+ */
+struct SigningResult {
+    uint64_t id;                       /**< id returned by Submit */
+    bool ok;                           /**< true if sig is the signature of the document */
+    safeheron::bignum::BN sig;         /**< the signature, if ok */
+    std::vector<int> signers;          /**< indices of the k parties whose shares were combined, if ok */
+    std::vector<int> invalid_indices;  /**< indices of the parties whose share did not verify */
+};
+
+/**
+ * Asynchronous collection and combination of signature shares.
+ *
+ * A document is registered with Submit, then the shares of the parties are handed in with AddShare as they
+ * arrive, in any order. The proof of every share is verified on the threads of a ThreadPool, and as soon as
+ * k shares of a document are valid they are combined, without waiting for the other l - k parties. The
+ * shares arriving after that are dropped, so the latency of a signature is the time to the k-th fastest
+ * valid share. A document fails as soon as too many shares are invalid to ever reach k valid ones.
+ *
+ * The pipeline is bounded: Submit blocks while max_pending documents are in flight (submitted and not yet
+ * taken with WaitResult / TryTakeResult), and AddShare blocks while max_queued_shares shares wait for
+ * verification.
+ *
+ * All the methods are thread safe.
+ */
+class SigningPipeline {
+public:
+    /**
+     * Constructor.
+     * @param[in] ctx combine context of the key, must outlive the pipeline.
+     * @param[in] max_pending maximum number of documents in flight, > 0.
+     * @param[in] max_queued_shares maximum number of shares waiting for verification, > 0.
+     * @param[in] pool thread pool running the verifications and combinations, must outlive the pipeline;
+     *            nullptr to run them on the thread calling AddShare.
+     */
+    SigningPipeline(const CombineContext &ctx,
+                    size_t max_pending,
+                    size_t max_queued_shares,
+                    ThreadPool *pool = nullptr);
+
+    /**
+     * Destructor. Drops the queued tasks and waits for the tasks handed to the pool to return.
+     * Must not be called from a task of the pool.
+     */
+    ~SigningPipeline();
+
+    SigningPipeline(const SigningPipeline &) = delete;
+    SigningPipeline &operator=(const SigningPipeline &) = delete;
+
+    /**
+     * Register a document, waiting while max_pending documents are in flight.
+     * @param[in] doc document to sign, the same as given to RSAPrivateKeyShare::Sign.
+     * @return id of the document.
+     */
+    uint64_t Submit(const std::string &doc);
+
+    /**
+     * Register a document without waiting.
+     * @param[in] doc document to sign.
+     * @param[out] id id of the document.
+     * @return true on success, false if max_pending documents are in flight.
+     */
+    bool TrySubmit(const std::string &doc, uint64_t &id);
+
+    /**
+     * Hand in a share of a document, waiting while max_queued_shares shares wait for verification.
+     * @param[in] id id of the document.
+     * @param[in] share share of signature.
+     * @return true if the share is queued for verification, false if it is dropped: the document is unknown
+     *         or already complete, or a share of the same party was already handed in.
+     */
+    bool AddShare(uint64_t id, const RSASigShare &share);
+
+    /**
+     * Give up a document, e.g. on a timeout. Its result is reported with ok == false.
+     * @param[in] id id of the document.
+     * @return true if the document was still in progress.
+     */
+    bool Cancel(uint64_t id);
+
+    /**
+     * Wait for the next complete document.
+     * @param[out] result
+     */
+    void WaitResult(SigningResult &result);
+
+    /**
+     * Take the next complete document without waiting.
+     * @param[out] result
+     * @return true on success, false if no document is complete.
+     */
+    bool TryTakeResult(SigningResult &result);
+
+    /**
+     * @return number of documents in flight.
+     */
+    size_t pending() const;
+
+private:
+    struct Job;
+
+    // Called with mutex_ held.
+    void RegisterLocked(const std::string &doc, uint64_t id);
+    void FinishLocked(uint64_t id, Job &job, bool ok);
+    void PushTaskLocked(std::function<void()> task);
+
+    // Hand one queued task to the pool, without mutex_ held: the pool may run it right away.
+    void Schedule();
+    void RunTask();
+
+    void Verify(uint64_t id, std::shared_ptr<Job> job, RSASigShare share);
+    void Combine(uint64_t id, std::shared_ptr<Job> job);
+
+private:
+    const CombineContext &ctx_;
+    const size_t max_pending_;
+    const size_t max_queued_shares_;
+    ThreadPool *pool_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable idle_cv_;     /**< a task handed to the pool returned */
+    std::condition_variable space_cv_;    /**< a document slot or a share slot is free */
+    std::condition_variable result_cv_;   /**< a result is ready */
+    std::deque<std::function<void()>> tasks_;
+    size_t queued_shares_;                /**< verification tasks in tasks_ */
+    size_t scheduled_;                    /**< tasks handed to the pool and not returned yet */
+    std::map<uint64_t, std::shared_ptr<Job>> jobs_;  /**< documents in progress */
+    std::deque<SigningResult> results_;   /**< complete documents, not yet taken */
+    uint64_t next_id_;
+    bool stop_;
+};
+
+};
+};
+
+#endif //SAFEHERON_TSS_RSA_SIGNING_PIPELINE_H
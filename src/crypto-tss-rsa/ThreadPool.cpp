@@ -0,0 +1,143 @@
+#include "ThreadPool.h"
+#include <exception>
+
+namespace safeheron {
+namespace tss_rsa{
+
+namespace {
+
+// Pool and queue of the current worker thread, if any.
+thread_local const void *tls_pool = nullptr;
+thread_local size_t tls_worker_id = 0;
+
+const size_t NOT_A_WORKER = (size_t)-1;
+
+}
+
+ThreadPool::ThreadPool(size_t thread_count) : pending_(0), next_queue_(0), stop_(false) {
+    if (thread_count == 0) thread_count = std::thread::hardware_concurrency();
+    if (thread_count == 0) thread_count = 1;
+    for (size_t i = 1; i < thread_count; ++i) {
+        queues_.emplace_back(new Queue());
+    }
+    for (size_t i = 0; i < queues_.size(); ++i) {
+        workers_.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto &t : workers_) t.join();
+}
+
+size_t ThreadPool::thread_count() const {
+    return workers_.size() + 1;
+}
+
+void ThreadPool::Push(std::function<void()> task) {
+    size_t q = (tls_pool == this) ? tls_worker_id : next_queue_++ % queues_.size();
+    {
+        std::lock_guard<std::mutex> lock(queues_[q]->mutex);
+        queues_[q]->tasks.push_back(std::move(task));
+    }
+    pending_++;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+    }
+    cv_.notify_one();
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+    if (workers_.empty()) {
+        task();
+        return;
+    }
+    Push(std::move(task));
+}
+
+// Pop the newest task of the own queue, or steal the oldest task of another queue.
+bool ThreadPool::TryRunOne(size_t self) {
+    std::function<void()> task;
+    const size_t count = queues_.size();
+    if (self != NOT_A_WORKER) {
+        Queue &own = *queues_[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+        }
+    }
+    for (size_t i = 1; !task && i <= count; ++i) {
+        size_t victim = (self == NOT_A_WORKER) ? i - 1 : (self + i) % count;
+        if (victim == self) continue;
+        Queue &q = *queues_[victim];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (!q.tasks.empty()) {
+            task = std::move(q.tasks.front());
+            q.tasks.pop_front();
+        }
+    }
+    if (!task) return false;
+    pending_--;
+    task();
+    return true;
+}
+
+void ThreadPool::WorkerLoop(size_t id) {
+    tls_pool = this;
+    tls_worker_id = id;
+    while (true) {
+        if (TryRunOne(id)) continue;
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return stop_ || pending_.load() > 0; });
+        if (stop_ && pending_.load() == 0) return;
+    }
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)> &fn) {
+    if (workers_.empty() || count <= 1) {
+        for (size_t i = 0; i < count; ++i) fn(i);
+        return;
+    }
+
+    // Shared with the tasks, which may still be unlocking it once the last of them is seen as done.
+    struct Batch {
+        std::atomic<size_t> remaining;
+        std::mutex mutex;
+        std::condition_variable done;
+        std::exception_ptr error;
+    };
+    std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+    batch->remaining = count;
+
+    for (size_t i = 0; i < count; ++i) {
+        Push([batch, &fn, i] {
+            try {
+                fn(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(batch->mutex);
+                if (!batch->error) batch->error = std::current_exception();
+            }
+            std::lock_guard<std::mutex> lock(batch->mutex);
+            if (--batch->remaining == 0) batch->done.notify_all();
+        });
+    }
+
+    // Help instead of blocking, then wait for the tasks still running on other threads.
+    const size_t self = (tls_pool == this) ? tls_worker_id : NOT_A_WORKER;
+    while (batch->remaining.load() > 0) {
+        if (TryRunOne(self)) continue;
+        std::unique_lock<std::mutex> lock(batch->mutex);
+        batch->done.wait(lock, [&] { return batch->remaining.load() == 0; });
+    }
+
+    std::lock_guard<std::mutex> lock(batch->mutex);
+    if (batch->error) std::rethrow_exception(batch->error);
+}
+
+};
+};
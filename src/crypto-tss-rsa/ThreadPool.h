@@ -0,0 +1,87 @@
+#ifndef SAFEHERON_TSS_RSA_THREAD_POOL_H
+#define SAFEHERON_TSS_RSA_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace safeheron {
+namespace tss_rsa{
+
+/**
+ * A work-stealing thread pool.
+ *
+ * Every worker owns a task queue. Tasks submitted from a worker go to its own queue and are run last in,
+ * first out; an idle worker steals the oldest task of another queue. A thread waiting in ParallelFor runs
+ * queued tasks instead of blocking, so ParallelFor may be nested.
+ *
+ * Big number scratch space is per thread (see MontgomeryContext::ThreadCtx), so tasks share nothing unless
+ * they capture it.
+ */
+class ThreadPool{
+public:
+    /**
+     * Constructor.
+     * @param[in] thread_count number of threads running the tasks, the thread calling ParallelFor included,
+     *                         so thread_count - 1 workers are started. 0 for std::thread::hardware_concurrency().
+     */
+    explicit ThreadPool(size_t thread_count = 0);
+
+    /**
+     * Destructor. Runs the queued tasks and stops the workers.
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     * @return number of threads running the tasks, the calling thread included.
+     */
+    size_t thread_count() const;
+
+    /**
+     * Run fn(0), ..., fn(count - 1) on the pool and wait for all of them.
+     * The first exception thrown by fn is rethrown once all the calls are done.
+     * @param[in] count number of calls
+     * @param[in] fn task, called concurrently from several threads
+     */
+    void ParallelFor(size_t count, const std::function<void(size_t)> &fn);
+
+    /**
+     * Queue a task and return without waiting for it. With no worker (thread_count() == 1), the task runs
+     * on the calling thread before Submit returns.
+     * @param[in] task task, must not throw
+     */
+    void Submit(std::function<void()> task);
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void Push(std::function<void()> task);
+    bool TryRunOne(size_t self);
+    void WorkerLoop(size_t id);
+
+private:
+    std::vector<std::unique_ptr<Queue>> queues_;  /**< one per worker */
+    std::vector<std::thread> workers_;
+    std::atomic<size_t> pending_;                 /**< queued tasks */
+    std::atomic<size_t> next_queue_;              /**< round robin for tasks submitted from outside */
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_;
+};
+
+};
+};
+
+#endif //SAFEHERON_TSS_RSA_THREAD_POOL_H
@@ -0,0 +1,164 @@
+#include "WireFormat.h"
+#include "Metrics.h"
+
+using safeheron::bignum::BN;
+
+namespace safeheron {
+namespace tss_rsa{
+
+namespace {
+
+const uint32_t WIRE_VARINT = 0;
+const uint32_t WIRE_FIXED64 = 1;
+const uint32_t WIRE_BYTES = 2;
+const uint32_t WIRE_FIXED32 = 5;
+
+}
+
+WireWriter::WireWriter(std::string &out) : out_(out) {
+#ifdef ENABLE_METRICS
+    start_ = std::chrono::steady_clock::now();
+#endif
+    out_.clear();
+    AddVarint((VERSION_FIELD << 3) | WIRE_VARINT);
+    AddVarint(VERSION);
+}
+
+WireWriter::~WireWriter() {
+#ifdef ENABLE_METRICS
+    auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_);
+    metrics::Add(Metric::Serialize, 1, (uint64_t)nanos.count(), out_.size());
+#endif
+}
+
+void WireWriter::AddVarint(uint64_t v) {
+    while (v >= 0x80) {
+        out_.push_back((char)((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    out_.push_back((char)v);
+}
+
+void WireWriter::AddInt32(uint32_t field, int32_t v) {
+    AddVarint(((uint64_t)field << 3) | WIRE_VARINT);
+    // Negative int32 values are sign extended to 64 bits, as protobuf does
+    AddVarint((uint64_t)(int64_t)v);
+}
+
+void WireWriter::AddBytes(uint32_t field, const uint8_t *data, size_t size) {
+    AddVarint(((uint64_t)field << 3) | WIRE_BYTES);
+    AddVarint(size);
+    out_.append((const char *)data, size);
+}
+
+bool WireWriter::AddBN(uint32_t field, const BN &v) {
+    if (v < 0) return false;
+    std::string buf;
+    if (v != 0) v.ToBytesBE(buf);
+    AddBytes(field, (const uint8_t *)buf.data(), buf.size());
+    return true;
+}
+
+WireReader::WireReader(const uint8_t *data, size_t size)
+        : pos_(data), end_(data + size),
+          error_(false), version_seen_(false), field_(0), wire_type_(0), varint_(0), data_(nullptr), size_(0),
+          message_size_(size) {
+#ifdef ENABLE_METRICS
+    start_ = std::chrono::steady_clock::now();
+#endif
+}
+
+WireReader::~WireReader() {
+#ifdef ENABLE_METRICS
+    auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_);
+    metrics::Add(Metric::Deserialize, 1, (uint64_t)nanos.count(), message_size_);
+#endif
+}
+
+bool WireReader::ReadVarint(uint64_t &v) {
+    v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos_ == end_) return false;
+        uint8_t b = *pos_++;
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if ((b & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+bool WireReader::Next() {
+    while (!error_ && pos_ != end_) {
+        uint64_t tag = 0;
+        if (!ReadVarint(tag) || (tag >> 3) == 0 || (tag >> 3) > 0x1fffffff) {
+            error_ = true;
+            break;
+        }
+        field_ = (uint32_t)(tag >> 3);
+        wire_type_ = (uint32_t)(tag & 7);
+        data_ = nullptr;
+        size_ = 0;
+        switch (wire_type_) {
+            case WIRE_VARINT:
+                error_ = !ReadVarint(varint_);
+                break;
+            case WIRE_BYTES: {
+                uint64_t size = 0;
+                error_ = !ReadVarint(size) || size > (uint64_t)(end_ - pos_);
+                if (!error_) {
+                    data_ = pos_;
+                    size_ = (size_t)size;
+                    pos_ += size_;
+                }
+                break;
+            }
+            case WIRE_FIXED64:
+            case WIRE_FIXED32: {
+                size_t size = wire_type_ == WIRE_FIXED64 ? 8 : 4;
+                error_ = size > (size_t)(end_ - pos_);
+                if (!error_) pos_ += size;
+                break;
+            }
+            default:
+                error_ = true;
+                break;
+        }
+        if (error_) break;
+        if (field_ == WireWriter::VERSION_FIELD) {
+            error_ = wire_type_ != WIRE_VARINT || varint_ != WireWriter::VERSION;
+            version_seen_ = !error_;
+            continue;
+        }
+        return true;
+    }
+    return false;
+}
+
+bool WireReader::Done() const {
+    return !error_ && pos_ == end_ && version_seen_;
+}
+
+uint32_t WireReader::field() const {
+    return field_;
+}
+
+bool WireReader::ReadInt32(int32_t &v) const {
+    if (wire_type_ != WIRE_VARINT) return false;
+    v = (int32_t)(uint32_t)varint_;
+    return true;
+}
+
+bool WireReader::ReadBN(BN &v) const {
+    if (wire_type_ != WIRE_BYTES) return false;
+    v = size_ == 0 ? BN::ZERO : BN::FromBytesBE(data_, size_);
+    return true;
+}
+
+bool WireReader::ReadBytes(const uint8_t *&data, size_t &size) const {
+    if (wire_type_ != WIRE_BYTES) return false;
+    data = data_;
+    size = size_;
+    return true;
+}
+
+};
+};
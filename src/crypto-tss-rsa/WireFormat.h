@@ -0,0 +1,141 @@
+#ifndef SAFEHERON_TSS_RSA_WIRE_FORMAT_H
+#define SAFEHERON_TSS_RSA_WIRE_FORMAT_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "crypto-bn/bn.h"
+
+namespace safeheron {
+namespace tss_rsa{
+
+/**
+ * Writer of the protobuf wire format of proto/tss_rsa_v2.proto.
+ *
+ * The v2 messages only hold int32 and bytes fields, so they are encoded here directly instead of through
+ * generated code, which is checked in once per protobuf version under proto_gen. Big numbers are written as
+ * their big endian magnitude instead of a hex string, half the size and no hex conversion.
+ */
+class WireWriter{
+public:
+    static const uint32_t VERSION = 2;
+    static const uint32_t VERSION_FIELD = 15;
+
+    /**
+     * Constructor. Clears out and writes the version field.
+     * @param[out] out buffer receiving the message
+     */
+    explicit WireWriter(std::string &out);
+
+    /**
+     * Destructor. Counts the message in Metric::Serialize.
+     */
+    ~WireWriter();
+
+    void AddInt32(uint32_t field, int32_t v);
+
+    void AddBytes(uint32_t field, const uint8_t *data, size_t size);
+
+    /**
+     * @param[in] field
+     * @param[in] v non-negative
+     * @return true on success, false if v < 0.
+     */
+    bool AddBN(uint32_t field, const bignum::BN &v);
+
+private:
+    void AddVarint(uint64_t v);
+
+private:
+    std::string &out_;
+    std::chrono::steady_clock::time_point start_;  /**< set with ENABLE_METRICS only */
+};
+
+/**
+ * Reader of the protobuf wire format of proto/tss_rsa_v2.proto.
+ *
+ * Usage:
+ *     WireReader reader(data, size);
+ *     bool ok = true;
+ *     while (ok && reader.Next()) {
+ *         switch (reader.field()) {
+ *             case 1: ok = reader.ReadInt32(i); break;
+ *             case 2: ok = reader.ReadBN(si); break;
+ *             default: break;
+ *         }
+ *     }
+ *     if (!ok || !reader.Done()) return false;
+ *
+ * Unknown fields are skipped. The version field is checked by Next and not returned.
+ */
+class WireReader{
+public:
+    /**
+     * Constructor.
+     * @param[in] data message, not copied, must outlive the reader
+     * @param[in] size size of the message
+     */
+    WireReader(const uint8_t *data, size_t size);
+
+    /**
+     * Destructor. Counts the message in Metric::Deserialize.
+     */
+    ~WireReader();
+
+    /**
+     * Move to the next field.
+     * @return true if there is one, false at the end of the message or on malformed input.
+     */
+    bool Next();
+
+    /**
+     * @return true if the whole message was read without error and it carries version 2.
+     */
+    bool Done() const;
+
+    /**
+     * @return field number of the current field.
+     */
+    uint32_t field() const;
+
+    /**
+     * @param[out] v value of the current field
+     * @return true on success, false if it is not a varint.
+     */
+    bool ReadInt32(int32_t &v) const;
+
+    /**
+     * @param[out] v value of the current field
+     * @return true on success, false if it is not a bytes field.
+     */
+    bool ReadBN(bignum::BN &v) const;
+
+    /**
+     * @param[out] data value of the current field, points into the message
+     * @param[out] size size of the value
+     * @return true on success, false if it is not a bytes field.
+     */
+    bool ReadBytes(const uint8_t *&data, size_t &size) const;
+
+private:
+    bool ReadVarint(uint64_t &v);
+
+private:
+    const uint8_t *pos_;
+    const uint8_t *end_;
+    bool error_;
+    bool version_seen_;
+    uint32_t field_;
+    uint32_t wire_type_;
+    uint64_t varint_;
+    const uint8_t *data_;
+    size_t size_;
+    size_t message_size_;
+    std::chrono::steady_clock::time_point start_;  /**< set with ENABLE_METRICS only */
+};
+
+};
+};
+
+#endif //SAFEHERON_TSS_RSA_WIRE_FORMAT_H
@@ -1,10 +1,13 @@
 #include "emsa_pss.h"
+#include <algorithm>
 #include <cstring>
 #include <memory>
+#include <openssl/crypto.h>
 #include "crypto-bn/bn.h"
 #include "crypto-bn/rand.h"
 #include "exception/located_exception.h"
-#include "crypto-hash/sha256.h"
+#include "ThreadPool.h"
+#include "Metrics.h"
 
 using std::string;
 using safeheron::hash::CSHA256;
@@ -12,39 +15,55 @@ using safeheron::exception::LocatedException;
 namespace safeheron {
     namespace tss_rsa {
 
-        std::string MGF1(const uint8_t *seed, size_t seedLen, size_t maskLen) {
-            string mask;
-            // Allocate CSHA256::OUTPUT_SIZE-1 more bytes.
-            mask.reserve(maskLen + CSHA256::OUTPUT_SIZE - 1);
-            for(size_t i = 0; i < (maskLen + CSHA256::OUTPUT_SIZE -1) / CSHA256::OUTPUT_SIZE; i++) {
+        // out ^= MGF1(seed, len), the mask is XORed into out in place, 8 bytes at a time.
+        static void MGF1Xor(const uint8_t *seed, size_t seedLen, uint8_t *out, size_t len) {
+            // The seed is absorbed once, every block starts from a copy of that state.
+            CSHA256 seeded;
+            seeded.Write(seed, seedLen);
+            uint8_t digest[CSHA256::OUTPUT_SIZE];
+            for(size_t i = 0, pos = 0; pos < len; i++, pos += CSHA256::OUTPUT_SIZE) {
                 uint8_t cnt[4];
                 cnt[0] = (unsigned char)((i >> 24) & 255);
                 cnt[1] = (unsigned char)((i >> 16) & 255);
                 cnt[2] = (unsigned char)((i >> 8)) & 255;
                 cnt[3] = (unsigned char)(i & 255);
 
-                uint8_t digest[CSHA256::OUTPUT_SIZE];
-                CSHA256 sha256;
-                sha256.Write(seed, seedLen);
+                CSHA256 sha256(seeded);
                 sha256.Write(cnt, 4);
                 sha256.Finalize(digest);
 
-                mask.append(reinterpret_cast<const char *>(digest), CSHA256::OUTPUT_SIZE);
+                size_t n = std::min(len - pos, (size_t)CSHA256::OUTPUT_SIZE);
+                size_t j = 0;
+                for(; j + 8 <= n; j += 8) {
+                    uint64_t a, b;
+                    memcpy(&a, out + pos + j, 8);
+                    memcpy(&b, digest + j, 8);
+                    a ^= b;
+                    memcpy(out + pos + j, &a, 8);
+                }
+                for(; j < n; j++) {
+                    out[pos + j] ^= digest[j];
+                }
             }
-            return mask.substr(0, maskLen);
         }
 
-        std::string EncodeEMSA_PSS(const std::string &m, int keyBits, SaltLength saltLength) {
+        std::string MGF1(const uint8_t *seed, size_t seedLen, size_t maskLen) {
+            string mask(maskLen, '\0');
+            if(maskLen > 0) MGF1Xor(seed, seedLen, reinterpret_cast<uint8_t *>(&mask[0]), maskLen);
+            return mask;
+        }
+
+        // emLen and sLen of EMSA-PSS-Encode, throws if keyBits is too short.
+        static void EncodingLengths(int keyBits, SaltLength saltLength, size_t &emLen, size_t &sLen) {
             size_t emBits = keyBits - 1;
 
-            size_t emLen = (emBits + 7) / 8;
+            emLen = (emBits + 7) / 8;
 
             // check emLen
             if(emLen < CSHA256::OUTPUT_SIZE + 2) {
                 throw LocatedException(__FILE__, __LINE__, __FUNCTION__, -1, "emLen < CSHA256::OUTPUT_SIZE + 2");
             }
 
-            size_t sLen;
             switch (saltLength) {
                 case SaltLength::AutoLength:
                 {
@@ -59,20 +78,16 @@ namespace safeheron {
                 }
             }
 
-            // 2.  Let mHash = Hash(M), an octet string of length hLen.
-            uint8_t mHash[CSHA256::OUTPUT_SIZE];
-            CSHA256 sha256;
-            sha256.Write(reinterpret_cast<const uint8_t *>(m.c_str()), m.length());
-            sha256.Finalize(mHash);
-
             // 3.  If emLen < hLen + sLen + 2, output "encoding error" and stop.
             if(emLen < CSHA256::OUTPUT_SIZE + sLen + 2) {
                 throw LocatedException(__FILE__, __LINE__, __FUNCTION__, -1, "emLen error: KeyBitLength is too short.");
             }
+        }
 
-            // 4.  Generate a random octet string salt of length sLen; if sLen = 0, then salt is the empty string.
-            std::unique_ptr<uint8_t[]> salt(new uint8_t[sLen]);
-            if(sLen > 0) safeheron::rand::RandomBytes(salt.get(), sLen);
+        // Steps 5 to 12 of EMSA-PSS-Encode, from mHash = Hash(M) and a salt of sLen octets.
+        static std::string EncodeDigest(const uint8_t *mHash, int keyBits, size_t emLen, size_t sLen, const uint8_t *salt) {
+            size_t emBits = keyBits - 1;
+            size_t DBLen = emLen - CSHA256::OUTPUT_SIZE - 1;
 
             // 5.  Let M' = (0x)00 00 00 00 00 00 00 00 || mHash || salt;
             //     M' is an octet string of length 8 + hLen + sLen with eight initial zero octets.
@@ -80,51 +95,42 @@ namespace safeheron {
             uint8_t padding1[8] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
 
             uint8_t H[CSHA256::OUTPUT_SIZE];
-            sha256.Reset();
+            CSHA256 sha256;
             sha256.Write(padding1, 8);
             sha256.Write(mHash, CSHA256::OUTPUT_SIZE);
-            sha256.Write(salt.get(), sLen);
+            sha256.Write(salt, sLen);
             sha256.Finalize(H);
 
             // 7.  Generate an octet string PS consisting of emLen - sLen - hLen - 2
             //     zero octets.  The length of PS may be 0.
             //
             // 8.  Let DB = PS || 0x01 || salt; DB is an octet string of length
-            //       emLen - hLen - 1.
-            string DB;
-            DB.reserve(emLen - CSHA256::OUTPUT_SIZE - 1);
+            //       emLen - hLen - 1. DB is built in place, in the first DBLen octets of EM.
+            string em(emLen, '\0');
+            uint8_t *DB = reinterpret_cast<uint8_t *>(&em[0]);
             size_t PSLen = emLen - CSHA256::OUTPUT_SIZE - sLen - 2;
-            DB.append(PSLen, 0x00);
-            DB.append(1, 0x01);
-            DB.append(reinterpret_cast<const char *>(salt.get()), sLen);
+            DB[PSLen] = 0x01;
+            if(sLen > 0) memcpy(DB + PSLen + 1, salt, sLen);
 
             // 9.  Let dbMask = MGF(H, emLen - hLen - 1).  mask generation function
-            string dbMask = MGF1(H, CSHA256::OUTPUT_SIZE, emLen - CSHA256::OUTPUT_SIZE - 1);
-
             // 10. Let maskedDB = DB \xor dbMask.
-            string maskedDB;
-            maskedDB.reserve(emLen - CSHA256::OUTPUT_SIZE - 1);
-            for(size_t i = 0; i < emLen - CSHA256::OUTPUT_SIZE - 1; i++) {
-                maskedDB.append(1, DB[i] ^ dbMask[i]);
-            }
+            MGF1Xor(H, CSHA256::OUTPUT_SIZE, DB, DBLen);
 
             // 11. Set the leftmost 8emLen - emBits bits of the leftmost octet in maskedDB to zero.
             uint8_t c = 255;
             for(size_t i = 0; i < emLen * 8 -emBits; i++) {
                 c = c >> 1;
             }
-            maskedDB[0] &= (char)c;
+            DB[0] &= c;
 
             // 12. Let EM = maskedDB || H || 0xbc.
-            string em;
-            em.reserve(emLen);
-            em.append(maskedDB);
-            em.append(reinterpret_cast<const char *>(H), CSHA256::OUTPUT_SIZE);
-            em.append(1, (char)0xbc);
+            memcpy(DB + DBLen, H, CSHA256::OUTPUT_SIZE);
+            em[emLen - 1] = (char)0xbc;
             return em;
         }
 
-        bool VerifyEMSA_PSS(const std::string &m, int keyBits, SaltLength saltLength, const std::string &em) {
+        // Steps 3 to 14 of EMSA-PSS-Verify, from mHash = Hash(M).
+        static bool VerifyDigest(const uint8_t *mHash, int keyBits, SaltLength saltLength, const std::string &em) {
             size_t emBits = keyBits - 1;
             size_t emLen = (emBits + 7) / 8;
             if(em.length() != emLen) {
@@ -180,15 +186,11 @@ namespace safeheron {
             }
 
             // 7.  Let dbMask = MGF(H, emLen - hLen - 1).
-            string mask = MGF1(H, CSHA256::OUTPUT_SIZE, emLen - CSHA256::OUTPUT_SIZE - 1);
-            const uint8_t *dbMask = (uint8_t *) mask.c_str();
-
             // 8.  Let DB = maskedDB \xor dbMask.
             size_t DBLen = emLen - CSHA256::OUTPUT_SIZE - 1;
             std::unique_ptr<uint8_t[]> DB(new uint8_t[DBLen]);
-            for(size_t i = 0; i < DBLen; i++) {
-                DB[i] = maskedDB[i] ^ dbMask[i];
-            }
+            memcpy(DB.get(), maskedDB, DBLen);
+            MGF1Xor(H, CSHA256::OUTPUT_SIZE, DB.get(), DBLen);
 
             // 9.  Set the leftmost 8emLen - emBits bits of the leftmost octet in DB to zero.
             c = 255;
@@ -220,28 +222,113 @@ namespace safeheron {
             uint8_t padding1[8] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
             const uint8_t *solt = DB.get() + (emLen - CSHA256::OUTPUT_SIZE - 1 - sLen);
 
-            uint8_t mHash[CSHA256::OUTPUT_SIZE];
-            CSHA256 sha256;
-            sha256.Write(reinterpret_cast<const uint8_t *>(m.c_str()), m.length());
-            sha256.Finalize(mHash);
-
             // 12.  Let
             //          M' = (0x)00 00 00 00 00 00 00 00 || mHash || salt ;
             //      M' is an octet string of length 8 + hLen + sLen with eight initial zero octets.
             // 13. Let H' = Hash(M'), an octet string of length hLen.
             uint8_t HPrime[CSHA256::OUTPUT_SIZE];
-            sha256.Reset();
+            CSHA256 sha256;
             sha256.Write(padding1, 8);
             sha256.Write(mHash, CSHA256::OUTPUT_SIZE);
             sha256.Write(solt, sLen);
             sha256.Finalize(HPrime);
 
             // 14. If H = H', output "consistent." Otherwise, output "inconsistent."
-            if(strncmp((char*)H, (char*)HPrime, CSHA256::OUTPUT_SIZE) == 0) {
-                return true;
+            //     H is binary, it is compared in full rather than up to its first zero octet.
+            return CRYPTO_memcmp(H, HPrime, CSHA256::OUTPUT_SIZE) == 0;
+        }
+
+        std::string EncodeEMSA_PSS(const std::string &m, int keyBits, SaltLength saltLength) {
+            EmsaPssEncoder encoder(keyBits, saltLength);
+            encoder.Update(reinterpret_cast<const uint8_t *>(m.c_str()), m.length());
+            return encoder.Final();
+        }
+
+        bool VerifyEMSA_PSS(const std::string &m, int keyBits, SaltLength saltLength, const std::string &em) {
+            EmsaPssVerifier verifier(keyBits, saltLength, em);
+            verifier.Update(reinterpret_cast<const uint8_t *>(m.c_str()), m.length());
+            return verifier.Final();
+        }
+
+        std::vector<std::string> EncodeEMSA_PSSBatch(const std::vector<std::string> &m_arr, int keyBits,
+                                                     SaltLength saltLength, ThreadPool *pool) {
+            size_t emLen, sLen;
+            EncodingLengths(keyBits, saltLength, emLen, sLen);
+
+            // 4.  The salts of the whole batch, from a single call to the random source.
+            std::unique_ptr<uint8_t[]> salts(new uint8_t[sLen * m_arr.size() + 1]);
+            if(sLen * m_arr.size() > 0) safeheron::rand::RandomBytes(salts.get(), sLen * m_arr.size());
+
+            std::vector<std::string> em_arr(m_arr.size());
+            auto encode = [&](size_t i) {
+                // 2.  Let mHash = Hash(M), an octet string of length hLen.
+                SAFEHERON_TSS_RSA_METRIC_SCOPE(PssEncode, m_arr[i].length());
+                uint8_t mHash[CSHA256::OUTPUT_SIZE];
+                CSHA256 sha256;
+                sha256.Write(reinterpret_cast<const uint8_t *>(m_arr[i].c_str()), m_arr[i].length());
+                sha256.Finalize(mHash);
+                em_arr[i] = EncodeDigest(mHash, keyBits, emLen, sLen, salts.get() + i * sLen);
+            };
+            if(pool) {
+                pool->ParallelFor(m_arr.size(), encode);
             } else {
-                return false;
+                for(size_t i = 0; i < m_arr.size(); i++) encode(i);
+            }
+            OPENSSL_cleanse(salts.get(), sLen * m_arr.size());
+            return em_arr;
+        }
+
+        EmsaPssEncoder::EmsaPssEncoder(int keyBits, SaltLength saltLength)
+                : keyBits_(keyBits), saltLength_(saltLength), finalized_(false) {}
+
+        void EmsaPssEncoder::Update(const uint8_t *data, size_t size) {
+            if(finalized_) {
+                throw LocatedException(__FILE__, __LINE__, __FUNCTION__, -1, "Update after Final");
+            }
+            SAFEHERON_TSS_RSA_METRIC_SCOPE_PART(PssEncode, size);
+            sha256_.Write(data, size);
+        }
+
+        std::string EmsaPssEncoder::Final() {
+            if(finalized_) {
+                throw LocatedException(__FILE__, __LINE__, __FUNCTION__, -1, "Final called twice");
             }
+            SAFEHERON_TSS_RSA_METRIC_SCOPE(PssEncode, 0);
+            finalized_ = true;
+            size_t emLen, sLen;
+            EncodingLengths(keyBits_, saltLength_, emLen, sLen);
+
+            // 2.  Let mHash = Hash(M), an octet string of length hLen.
+            uint8_t mHash[CSHA256::OUTPUT_SIZE];
+            sha256_.Finalize(mHash);
+
+            // 4.  Generate a random octet string salt of length sLen; if sLen = 0, then salt is the empty string.
+            std::unique_ptr<uint8_t[]> salt(new uint8_t[sLen]);
+            if(sLen > 0) safeheron::rand::RandomBytes(salt.get(), sLen);
+            return EncodeDigest(mHash, keyBits_, emLen, sLen, salt.get());
+        }
+
+        EmsaPssVerifier::EmsaPssVerifier(int keyBits, SaltLength saltLength, const std::string &em)
+                : keyBits_(keyBits), saltLength_(saltLength), em_(em), finalized_(false) {}
+
+        void EmsaPssVerifier::Update(const uint8_t *data, size_t size) {
+            if(finalized_) {
+                throw LocatedException(__FILE__, __LINE__, __FUNCTION__, -1, "Update after Final");
+            }
+            SAFEHERON_TSS_RSA_METRIC_SCOPE_PART(PssVerify, size);
+            sha256_.Write(data, size);
+        }
+
+        bool EmsaPssVerifier::Final() {
+            if(finalized_) {
+                throw LocatedException(__FILE__, __LINE__, __FUNCTION__, -1, "Final called twice");
+            }
+            SAFEHERON_TSS_RSA_METRIC_SCOPE(PssVerify, 0);
+            finalized_ = true;
+            // 2.  Let mHash = Hash(M), an octet string of length hLen.
+            uint8_t mHash[CSHA256::OUTPUT_SIZE];
+            sha256_.Finalize(mHash);
+            return VerifyDigest(mHash, keyBits_, saltLength_, em_);
         }
 
     }
@@ -10,9 +10,14 @@
 
 #include "crypto-bn/bn.h"
 #include "crypto-bn/rand.h"
+#include <string>
+#include <vector>
+#include "crypto-hash/sha256.h"
 
 namespace safeheron {
     namespace tss_rsa {
+        class ThreadPool;
+
         enum class SaltLength {
             AutoLength,
             EqualToHash
@@ -48,6 +53,86 @@ namespace safeheron {
          */
         bool VerifyEMSA_PSS(const std::string &m, int keyBits, SaltLength saltLength, const std::string &emsa_pss);
 
+        /**
+         * EMSA-PSS-Encode of a batch of messages, the same as EncodeEMSA_PSS on each of them.
+         * The salts of the whole batch are drawn with a single call to the random source.
+         * @param m_arr messages
+         * @param keyBits
+         * @param saltLength
+         * @param pool thread pool to encode the messages in parallel on, nullptr to encode them on the calling thread
+         * @return Encoding results, in the order of m_arr.
+         */
+        std::vector<std::string> EncodeEMSA_PSSBatch(const std::vector<std::string> &m_arr, int keyBits,
+                                                     SaltLength saltLength, ThreadPool *pool = nullptr);
+
+        /**
+         * Incremental EMSA-PSS-Encode, for messages that are not in memory as one string.
+         * Feed the message with Update in as many pieces as needed, then call Final once:
+         * the result is the one of EncodeEMSA_PSS over the concatenation of the pieces.
+         */
+        class EmsaPssEncoder {
+        public:
+            /**
+             * Constructor.
+             * @param keyBits
+             * @param saltLength
+             */
+            EmsaPssEncoder(int keyBits, SaltLength saltLength);
+
+            /**
+             * Append a piece of the message.
+             * @param data
+             * @param size
+             */
+            void Update(const uint8_t *data, size_t size);
+
+            /**
+             * EMSA-PSS-Encode of the message fed so far. Throws if called twice.
+             * @return Encoding result.
+             */
+            std::string Final();
+
+        private:
+            int keyBits_;
+            SaltLength saltLength_;
+            safeheron::hash::CSHA256 sha256_;
+            bool finalized_;
+        };
+
+        /**
+         * Incremental EMSA-PSS-VERIFY, the counterpart of EmsaPssEncoder.
+         */
+        class EmsaPssVerifier {
+        public:
+            /**
+             * Constructor.
+             * @param keyBits
+             * @param saltLength
+             * @param emsa_pss encoded message to check the message against
+             */
+            EmsaPssVerifier(int keyBits, SaltLength saltLength, const std::string &emsa_pss);
+
+            /**
+             * Append a piece of the message.
+             * @param data
+             * @param size
+             */
+            void Update(const uint8_t *data, size_t size);
+
+            /**
+             * EMSA-PSS-VERIFY of the message fed so far. Throws if called twice.
+             * @return true if emsa_pss is an encoding of the message.
+             */
+            bool Final();
+
+        private:
+            int keyBits_;
+            SaltLength saltLength_;
+            std::string em_;
+            safeheron::hash::CSHA256 sha256_;
+            bool finalized_;
+        };
+
     }
 }
 
@@ -5,6 +5,13 @@
 #include "crypto-hash/hash256.h"
 #include "common.h"
 #include "RSASigShareProof.h"
+#include "MontgomeryContext.h"
+#include "SafePrimeSearch.h"
+#include "ThreadPool.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
 
 using safeheron::bignum::BN;
 using safeheron::exception::LocatedException;
@@ -17,26 +24,12 @@ const int f4 = 65537;
 namespace safeheron {
 namespace tss_rsa {
 
-static bool InternalGenerateKey(size_t key_bits_length, int l, int k,
-                                std::vector<RSAPrivateKeyShare> &private_key_share_arr,
-                                RSAPublicKey &public_key,
-                                RSAKeyMeta &key_meta,
-                                KeyGenParam &param){
-    const BN e(param.e());
-    const BN &p = param.p();
-    const BN &q = param.q();
-    const BN &f = param.f();
-    const BN &vku = param.vku();
-
-    // n
-    BN n = p * q;
-
-    // m = p' * q'
-    BN m = (p - 1) * (q - 1) / 4;
-
-    // d:  de = 1 mod m
-    BN d = e.InvM(m);
-
+/**
+ * Split d into l shares with threshold k, si = f(i) / l! mod m for a random polynomial f of degree k - 1 with f(0) = d.
+ * @return false if the self check fails.
+ */
+static bool MakePrivateKeyShares(const BN &d, const BN &m, int l, int k, bool self_check,
+                                 std::vector<RSAPrivateKeyShare> &private_key_share_arr){
     // generate shares of d
     std::vector<sss::Point> share_arr;
     std::vector<BN> index_arr;
@@ -44,9 +37,13 @@ static bool InternalGenerateKey(size_t key_bits_length, int l, int k,
         index_arr.emplace_back(BN(i));
     }
     sss::vsss::MakeShares(share_arr, d, k, index_arr, m);
-    BN secret;
-    sss::vsss::RecoverSecret(secret, share_arr, m);
+
     // extra check: d == secret
+    if(self_check){
+        BN secret;
+        sss::vsss::RecoverSecret(secret, share_arr, m);
+        if(secret != d) return false;
+    }
 
 
     // Compute \Delta = l!
@@ -60,7 +57,31 @@ static bool InternalGenerateKey(size_t key_bits_length, int l, int k,
         BN si = (share_arr[i-1].y * delta_inv) % m;
         private_key_share_arr.emplace_back(RSAPrivateKeyShare(i, si));
     }
+    return true;
+}
 
+static bool InternalGenerateKey(size_t key_bits_length, int l, int k,
+                                std::vector<RSAPrivateKeyShare> &private_key_share_arr,
+                                RSAPublicKey &public_key,
+                                RSAKeyMeta &key_meta,
+                                KeyGenParam &param){
+    const BN e(param.e());
+    const BN &p = param.p();
+    const BN &q = param.q();
+    const BN &f = param.f();
+    const BN &vku = param.vku();
+
+    // n
+    BN n = p * q;
+
+    // m = p' * q'
+    BN m = (p - 1) * (q - 1) / 4;
+
+    // d:  de = 1 mod m
+    BN d = e.InvM(m);
+
+    // shares of d
+    if(!MakePrivateKeyShares(d, m, l, k, param.self_check(), private_key_share_arr)) return false;
 
     // Public key
     public_key.set_n(n);
@@ -69,11 +90,12 @@ static bool InternalGenerateKey(size_t key_bits_length, int l, int k,
 
     // Validate Key
     BN vkv = (f * f) % n;
-    std::vector<BN> vki_arr;
-    for(int i = 1; i <= l; i++){
-        BN t_vki = vkv.PowM(private_key_share_arr[i-1].si(), n);
-        vki_arr.push_back(t_vki);
-    }
+    std::vector<BN> vki_arr(l);
+    std::shared_ptr<const MontgomeryContext> mont = public_key.mont();
+    ThreadPool pool(std::max<size_t>(param.thread_count(), 1));
+    pool.ParallelFor((size_t)l, [&](size_t i){
+        vki_arr[i] = mont->PowMSecret(vkv, private_key_share_arr[i].si());
+    });
 
     // Key meta data
     key_meta.set_k(k);
@@ -86,6 +108,29 @@ static bool InternalGenerateKey(size_t key_bits_length, int l, int k,
 }
 
 
+static bool GenerateKeyWithSafePrimes(size_t key_bits_length, int l, int k,
+                                      const BN &p, const BN &q,
+                                      std::vector<RSAPrivateKeyShare> &private_key_share_arr,
+                                      RSAPublicKey &public_key,
+                                      RSAKeyMeta &key_meta){
+    // default value
+    int e = f4;
+
+    // n = p * q
+    BN n = p * q;
+    BN f = safeheron::rand::RandomBNLtCoPrime(n);
+
+    // vku
+    BN vku;
+    do{
+        vku = safeheron::rand::RandomBNLtGcd(n);
+    } while (safeheron::bignum::BN::JacobiSymbol(vku, n) != -1);
+
+    KeyGenParam param(e, p, q, f, vku);
+    return InternalGenerateKey(key_bits_length, l, k, private_key_share_arr, public_key, key_meta, param);
+}
+
+
 /**
  * Generate private key shares, public key, key meta data.
  *
@@ -111,30 +156,58 @@ bool GenerateKey(size_t key_bits_length, int l, int k,
         return false;
     }
 
-    // default value
-    int e = f4;
+    SAFEHERON_TSS_RSA_METRIC_SCOPE(KeyGen, 0);
+    BN p, q;
+    {
+        SAFEHERON_TSS_RSA_METRIC_SCOPE(PrimeSearch, 0);
+        // p = 2p' + 1
+        p = safeheron::rand::RandomSafePrime(key_bits_length / 2);
 
-    // p = 2p' + 1
-    BN p = safeheron::rand::RandomSafePrime(key_bits_length / 2);
+        // q = 2q' + 1, make sure: p != q
+        do {
+            q = safeheron::rand::RandomSafePrime(key_bits_length / 2 - 1);
+        } while (p == q);
+    }
 
-    // q = 2q' + 1, make sure: p != q
-    BN q;
-    do {
-        q = safeheron::rand::RandomSafePrime(key_bits_length / 2 - 1);
-    } while (p == q);
+    return GenerateKeyWithSafePrimes(key_bits_length, l, k, p, q, private_key_share_arr, public_key, key_meta);
+}
 
-    // n = p * q
-    BN n = p * q;
-    BN f = safeheron::rand::RandomBNLtCoPrime(n);
 
-    // vku
-    BN vku;
-    do{
-        vku = safeheron::rand::RandomBNLtGcd(n);
-    } while (safeheron::bignum::BN::JacobiSymbol(vku, n) != -1);
+/**
+ * Generate private key shares, public key, key meta data, with safe primes taken from a pool.
+ *
+ * @param[in] key_bits_length: 1024/2048/3072/4096.  4096 is advised.
+ * @param[in] l: total number of private key shares.
+ * @param[in] k: threshold, k < l and k >= (l/2+1)
+ * @param[in] pool: pool of safe prime pairs.
+ * @param[out] private_key_share_arr[out]: shares of private key.
+ * @param[out] public_key[out]: public key.
+ * @param[out] key_meta[out]: key meta data.
+ * @return true on success, false on error.
+ */
+bool GenerateKey(size_t key_bits_length, int l, int k,
+                 SafePrimePool &pool,
+                 std::vector<RSAPrivateKeyShare> &private_key_share_arr,
+                 RSAPublicKey &public_key,
+                 RSAKeyMeta &key_meta){
+    // check key_bits_length
+    if( (key_bits_length != 1024) && (key_bits_length != 2048) && (key_bits_length != 3072) && (key_bits_length != 4096)){
+        return false;
+    }
 
-    KeyGenParam param(e, p, q, f, vku);
-    return InternalGenerateKey(key_bits_length, l, k, private_key_share_arr, public_key, key_meta, param);
+    // check k, l
+    if(l <= 1 || k <= 0 || k < (l/2+1) || k > l){
+        return false;
+    }
+
+    // p = 2p' + 1, q = 2q' + 1, p != q
+    BN p, q;
+    if(!pool.TryTake(key_bits_length, p, q)){
+        return GenerateKey(key_bits_length, l, k, private_key_share_arr, public_key, key_meta);
+    }
+    SAFEHERON_TSS_RSA_METRIC_SCOPE(KeyGen, 0);
+
+    return GenerateKeyWithSafePrimes(key_bits_length, l, k, p, q, private_key_share_arr, public_key, key_meta);
 }
 
 
@@ -160,6 +233,8 @@ bool GenerateKeyEx(size_t key_bits_length, int l, int k,
         return false;
     }
 
+    SAFEHERON_TSS_RSA_METRIC_SCOPE(KeyGen, 0);
+
     // check e
     KeyGenParam param = _param;
     BN e(param.e());
@@ -171,9 +246,21 @@ bool GenerateKeyEx(size_t key_bits_length, int l, int k,
         }
     }
 
+    // search p and q at the same time on several threads
+    if(param.thread_count() > 0 && param.p() == 0 && param.q() == 0){
+        SAFEHERON_TSS_RSA_METRIC_SCOPE(PrimeSearch, 0);
+        BN p, q;
+        RandomSafePrimePairParallel(key_bits_length / 2, key_bits_length / 2 - 1, param.thread_count(), p, q);
+        param.set_p(p);
+        param.set_q(q);
+    }
+
     // check p: p = 2p' + 1
     if(param.p() == 0){
-        BN p = safeheron::rand::RandomSafePrime(key_bits_length/ 2);
+        SAFEHERON_TSS_RSA_METRIC_SCOPE(PrimeSearch, 0);
+        BN p = param.thread_count() > 0 ?
+               RandomSafePrimeParallel(key_bits_length / 2, param.thread_count()) :
+               safeheron::rand::RandomSafePrime(key_bits_length/ 2);
         param.set_p(p);
     }else{
         BN pp = (param.p() - 1)/2;
@@ -185,9 +272,12 @@ bool GenerateKeyEx(size_t key_bits_length, int l, int k,
     // check q: q = 2q' + 1
     // make sure: q != p
     if(param.q() == 0){
+        SAFEHERON_TSS_RSA_METRIC_SCOPE(PrimeSearch, 0);
         BN q;
         do {
-            q = safeheron::rand::RandomSafePrime(key_bits_length / 2 - 1);
+            q = param.thread_count() > 0 ?
+                RandomSafePrimeParallel(key_bits_length / 2 - 1, param.thread_count()) :
+                safeheron::rand::RandomSafePrime(key_bits_length / 2 - 1);
         }while (q == param.p());
         param.set_q(q);
     }else{
@@ -229,68 +319,155 @@ bool GenerateKeyEx(size_t key_bits_length, int l, int k,
 }
 
 
+/**
+ * Share the private key of an existing key again, for a new (k, l), without touching n, e, vkv and vku.
+ *
+ * @param[in] p: the safe prime p of the key.
+ * @param[in] q: the safe prime q of the key.
+ * @param[in] public_key: public key, n = pq.
+ * @param[in] key_meta: key meta data of the current shares.
+ * @param[in] l: total number of private key shares.
+ * @param[in] k: threshold, k < l and k >= (l/2+1)
+ * @param[in] pool: thread pool, nullptr to compute the vki on the calling thread.
+ * @param[out] private_key_share_arr: new shares of private key.
+ * @param[out] out_key_meta: key meta data of the new shares.
+ * @return true on success, false on error.
+ */
+bool ReshareKey(const BN &p, const BN &q,
+                const RSAPublicKey &public_key,
+                const RSAKeyMeta &key_meta,
+                int l, int k,
+                ThreadPool *pool,
+                std::vector<RSAPrivateKeyShare> &private_key_share_arr,
+                RSAKeyMeta &out_key_meta){
+    // check k, l
+    if(l <= 1 || k <= 0 || k < (l/2+1) || k > l){
+        return false;
+    }
+
+    SAFEHERON_TSS_RSA_METRIC_SCOPE(KeyGen, 0);
+
+    // check p, q: n = pq
+    const BN &n = public_key.n();
+    if(p == q || p * q != n){
+        return false;
+    }
+
+    // m = p' * q', d:  de = 1 mod m
+    BN m = (p - 1) * (q - 1) / 4;
+    BN d = public_key.e().InvM(m);
+
+    std::vector<RSAPrivateKeyShare> share_arr;
+    if(!MakePrivateKeyShares(d, m, l, k, false, share_arr)) return false;
+
+    // vki = vkv^si, constant time in the secret si
+    std::shared_ptr<const MontgomeryContext> mont = public_key.mont();
+    std::vector<BN> vki_arr(l);
+    auto compute_vki = [&](size_t i){
+        vki_arr[i] = mont->PowMSecret(key_meta.vkv(), share_arr[i].si());
+    };
+    if(pool){
+        pool->ParallelFor((size_t)l, compute_vki);
+    }else{
+        for(size_t i = 0; i < (size_t)l; i++) compute_vki(i);
+    }
+
+    private_key_share_arr.swap(share_arr);
+    out_key_meta = RSAKeyMeta(k, l, key_meta.vkv(), vki_arr, key_meta.vku());
+    return true;
+}
+
+/**
+ * x = m    , if (m, n) == 1
+ * x = m*u^e, if (m, n) == -1
+ */
+static BN PrepareX(const BN &m, const RSAPublicKey &public_key, const RSAKeyMeta &key_meta, int &jacobi_m_n){
+    jacobi_m_n = BN::JacobiSymbol(m, public_key.n());
+    if( jacobi_m_n == -1){
+        std::shared_ptr<const MontgomeryContext> mont = public_key.mont();
+        if(!mont) return (m * key_meta.vku().PowM(public_key.e(), public_key.n())) % public_key.n();
+        return mont->MulM(m, mont->PowM(key_meta.vku(), public_key.e()));
+    }
+    return m;
+}
+
+/**
+ * mask = the bitmask of the indices of sig_arr, see CombineContext::SignerMask.
+ * @return false if an index is out of (1, ... ,l) or appears twice.
+ */
+static bool SharesMask(const std::vector<RSASigShare> &sig_arr, const RSAKeyMeta &key_meta, std::vector<uint64_t> &mask){
+    std::vector<int> S;
+    for(const auto &item : sig_arr){
+        S.push_back(item.index());
+    }
+    return CombineContext::SignerMask(S, key_meta.l(), mask);
+}
+
+/**
+ * Position of party j among the parties of mask, in increasing order.
+ */
+static size_t SignerRank(const std::vector<uint64_t> &mask, int j){
+    size_t rank = 0;
+    for(int w = 0; w < j / 64; w++){
+        rank += __builtin_popcountll(mask[w]);
+    }
+    return rank + __builtin_popcountll(mask[j / 64] & (((uint64_t)1 << (j % 64)) - 1));
+}
+
 /**
  * Combine all the shares of signature to make a real signature.
  * @param[in] x: a big number related to prepared hash
  * @param[in] sig_arr : the shares of signature.
- * @param[in] public_key: public key.
- * @param[in] key_meta: key meta data.
+ * @param[in] ctx: combine context of the key.
  * @param[out] out_sig: a real signature.
  * @return true on success, false on error.
  */
 bool InternalCombineSignatures(const safeheron::bignum::BN &_x,
                                const std::vector<RSASigShare> &sig_arr,
-                               const RSAPublicKey &public_key,
-                               const RSAKeyMeta &key_meta,
+                               const CombineContext &ctx,
                                const bool validate_sig,
                                safeheron::bignum::BN &out_sig){
-    // e' is always set to 4.
-    BN ep(4);
+    SAFEHERON_TSS_RSA_METRIC_SCOPE(Combine, 0);
+    const RSAPublicKey &public_key = ctx.public_key();
+    const RSAKeyMeta &key_meta = ctx.key_meta();
+    const MontgomeryContext &mont = ctx.mont();
 
     // x = m    , if (m, n) == 1
     // x = m*u^e, if (m, n) == -1
     BN x = _x;
     int jacobi_m_n = BN::JacobiSymbol(x, public_key.n());
     if( jacobi_m_n == -1){
-        x = (x * key_meta.vku().PowM(public_key.e(), public_key.n())) % public_key.n();
+        x = mont.MulM(x, ctx.vku_e());
     }
 
+    // S is a subset of (1, ... ,l)
+    std::vector<uint64_t> S;
+    if(!SharesMask(sig_arr, key_meta, S)) return false;
+
     // Validate signature share
     if(validate_sig) {
-        bool is_valid_sig = true;
+        SigShareVerifyContext verify_ctx(key_meta, x, public_key.n(), sig_arr.size());
         for (const auto &sig: sig_arr) {
             RSASigShareProof proof(sig.z(), sig.c());
-            is_valid_sig &= proof.Verify(key_meta.vkv(), key_meta.vki(sig.index() - 1), x, public_key.n(),
-                                         sig.sig_share());
-            if (!is_valid_sig) return false;
+            if (!proof.Verify(verify_ctx, sig.index() - 1, sig.sig_share())) return false;
         }
     }
 
-    // Compute \Delta = l!
-    BN delta(1);
-    for(int i = 1; i <= key_meta.l(); i++){
-        delta *= i;
-    }
-
-    // S is a subset of (1, ... ,l)
-    std::vector<BN> S;
-    for(const auto &item : sig_arr){
-        S.emplace_back(BN(item.index()));
-    }
-
     // w = x_{i_1}^{2 \lambda_{0,i_1}^S} \dots	x_{i_k}^{2 \lambda_{0,i_k}^S} \pmod n
-    BN w(1);
+    std::shared_ptr<const std::vector<BN>> exps = ctx.LagrangeExponents(S);
+    if(!exps) return false;
+    std::vector<BN> bases;
+    std::vector<BN> share_exps;
     for(const auto &item : sig_arr){
-        BN lam = lambda(BN(0), BN(item.index()), S, delta);
-        w = (w * item.sig_share().PowM(lam * 2, public_key.n())) % public_key.n();
+        bases.push_back(item.sig_share());
+        share_exps.push_back((*exps)[SignerRank(S, item.index())]);
     }
+    BN w = mont.MultiPowM(bases, share_exps);
 
     // y = w^a x^b \pmod n
-    BN d, a, b;
-    BN::ExtendedEuclidean(ep, public_key.e(), a, b, d);
-    BN y = w.PowM(a, public_key.n()) * x.PowM(b, public_key.n()) % public_key.n();
+    BN y = mont.MultiPowM({w, x}, {ctx.a(), ctx.b()});
     if (jacobi_m_n == -1) {
-        y = (y * key_meta.vku().InvM(public_key.n())) % public_key.n();
+        y = mont.MulM(y, ctx.vku_inv());
     }
     out_sig = y;
     return true;
@@ -311,7 +488,24 @@ bool CombineSignatures(const std::string &doc,
                        const RSAKeyMeta &key_meta,
                        safeheron::bignum::BN &out_sig){
     BN x = BN::FromBytesBE(doc);
-    return InternalCombineSignatures(x, sig_arr, public_key, key_meta, true, out_sig);
+    CombineContext ctx(public_key, key_meta);
+    return InternalCombineSignatures(x, sig_arr, ctx, true, out_sig);
+}
+
+/**
+ * Combine all the shares of signature to make a real signature, with the cached key data of ctx.
+ * @param[in] doc: doc
+ * @param[in] sig_arr : the shares of signature.
+ * @param[in] ctx: combine context of the key.
+ * @param[out] out_sig: a real signature.
+ * @return true on success, false on error.
+ */
+bool CombineSignatures(const std::string &doc,
+                       const std::vector<RSASigShare> &sig_arr,
+                       const CombineContext &ctx,
+                       safeheron::bignum::BN &out_sig){
+    BN x = BN::FromBytesBE(doc);
+    return InternalCombineSignatures(x, sig_arr, ctx, true, out_sig);
 }
 
 /**
@@ -329,7 +523,237 @@ bool CombineSignaturesWithoutValidation(const std::string &doc,
                                         const RSAKeyMeta &key_meta,
                                         safeheron::bignum::BN &out_sig){
     BN x = BN::FromBytesBE(doc);
-    return InternalCombineSignatures(x, sig_arr, public_key, key_meta, false, out_sig);
+    CombineContext ctx(public_key, key_meta);
+    return InternalCombineSignatures(x, sig_arr, ctx, false, out_sig);
+}
+
+/**
+ * Combine all the shares of signature without validation on signature shares to make a real signature,
+ * with the cached key data of ctx.
+ * @param[in] doc: doc
+ * @param[in] sig_arr : the shares of signature.
+ * @param[in] ctx: combine context of the key.
+ * @param[out] out_sig: a real signature.
+ * @return true on success, false on error.
+ */
+bool CombineSignaturesWithoutValidation(const std::string &doc,
+                                        const std::vector<RSASigShare> &sig_arr,
+                                        const CombineContext &ctx,
+                                        safeheron::bignum::BN &out_sig){
+    BN x = BN::FromBytesBE(doc);
+    return InternalCombineSignatures(x, sig_arr, ctx, false, out_sig);
+}
+
+/**
+ * Combine the shares of signature of many documents, on the threads of pool.
+ * @param[in] doc_arr: docs
+ * @param[in] sig_arr_arr: sig_arr_arr[i] are the shares of signature of doc_arr[i].
+ * @param[in] ctx: combine context of the key.
+ * @param[in] pool: thread pool.
+ * @param[out] out_sig_arr: out_sig_arr[i] is the signature of doc_arr[i].
+ * @param[out] status_arr: status_arr[i] is 1 on success, 0 on error.
+ * @return true if all the documents succeed, false otherwise.
+ */
+bool CombineSignaturesBatch(const std::vector<std::string> &doc_arr,
+                            const std::vector<std::vector<RSASigShare>> &sig_arr_arr,
+                            const CombineContext &ctx,
+                            ThreadPool &pool,
+                            std::vector<safeheron::bignum::BN> &out_sig_arr,
+                            std::vector<uint8_t> &status_arr){
+    const size_t doc_count = doc_arr.size();
+    out_sig_arr.assign(doc_count, BN::ZERO);
+    status_arr.assign(doc_count, 0);
+    if(sig_arr_arr.size() != doc_count) return false;
+
+    const RSAPublicKey &public_key = ctx.public_key();
+    const RSAKeyMeta &key_meta = ctx.key_meta();
+    const MontgomeryContext &mont = ctx.mont();
+
+    // Per document: x and the verification context shared by its shares.
+    std::vector<std::unique_ptr<SigShareVerifyContext>> verify_ctx_arr(doc_count);
+    pool.ParallelFor(doc_count, [&](size_t d){
+        std::vector<uint64_t> S;
+        if(!SharesMask(sig_arr_arr[d], key_meta, S)) return;
+        BN x = BN::FromBytesBE(doc_arr[d]);
+        if(BN::JacobiSymbol(x, public_key.n()) == -1){
+            x = mont.MulM(x, ctx.vku_e());
+        }
+        verify_ctx_arr[d].reset(new SigShareVerifyContext(key_meta, x, public_key.n(), sig_arr_arr[d].size()));
+    });
+
+    // Per share of every document: the proof.
+    std::vector<std::pair<size_t, size_t>> share_arr;
+    for(size_t d = 0; d < doc_count; d++){
+        if(!verify_ctx_arr[d]) continue;
+        for(size_t s = 0; s < sig_arr_arr[d].size(); s++) share_arr.emplace_back(d, s);
+    }
+    std::vector<uint8_t> share_valid_arr(share_arr.size(), 0);
+    pool.ParallelFor(share_arr.size(), [&](size_t j){
+        const RSASigShare &sig = sig_arr_arr[share_arr[j].first][share_arr[j].second];
+        RSASigShareProof proof(sig.z(), sig.c());
+        share_valid_arr[j] = proof.Verify(*verify_ctx_arr[share_arr[j].first], sig.index() - 1, sig.sig_share()) ? 1 : 0;
+    });
+
+    std::vector<uint8_t> doc_valid_arr(doc_count, 0);
+    for(size_t d = 0; d < doc_count; d++){
+        if(verify_ctx_arr[d]) doc_valid_arr[d] = 1;
+    }
+    for(size_t j = 0; j < share_arr.size(); j++){
+        if(!share_valid_arr[j]) doc_valid_arr[share_arr[j].first] = 0;
+    }
+
+    // Per document: the Lagrange combination.
+    pool.ParallelFor(doc_count, [&](size_t d){
+        if(!doc_valid_arr[d]) return;
+        BN sig;
+        if(InternalCombineSignatures(BN::FromBytesBE(doc_arr[d]), sig_arr_arr[d], ctx, false, sig)){
+            out_sig_arr[d] = sig;
+            status_arr[d] = 1;
+        }
+    });
+
+    return std::find(status_arr.begin(), status_arr.end(), 0) == status_arr.end();
+}
+
+/**
+ * Combine the shares of signature of many documents, on the threads of pool.
+ * @param[in] doc_arr: docs
+ * @param[in] sig_arr_arr: sig_arr_arr[i] are the shares of signature of doc_arr[i].
+ * @param[in] public_key: public key.
+ * @param[in] key_meta: key meta data.
+ * @param[in] pool: thread pool.
+ * @param[out] out_sig_arr: out_sig_arr[i] is the signature of doc_arr[i].
+ * @param[out] status_arr: status_arr[i] is 1 on success, 0 on error.
+ * @return true if all the documents succeed, false otherwise.
+ */
+bool CombineSignaturesBatch(const std::vector<std::string> &doc_arr,
+                            const std::vector<std::vector<RSASigShare>> &sig_arr_arr,
+                            const RSAPublicKey &public_key,
+                            const RSAKeyMeta &key_meta,
+                            ThreadPool &pool,
+                            std::vector<safeheron::bignum::BN> &out_sig_arr,
+                            std::vector<uint8_t> &status_arr){
+    CombineContext ctx(public_key, key_meta);
+    return CombineSignaturesBatch(doc_arr, sig_arr_arr, ctx, pool, out_sig_arr, status_arr);
+}
+
+/**
+ * Combine the first k shares of signature whose proof verifies, out of more than k.
+ * @param[in] doc: doc
+ * @param[in] sig_arr : the shares of signature, in order of arrival.
+ * @param[in] ctx: combine context of the key.
+ * @param[in] pool: thread pool, nullptr to verify the shares on the calling thread.
+ * @param[out] out_sig: a real signature.
+ * @param[out] signers: indices of the k parties whose shares were combined, sorted.
+ * @param[out] invalid_indices: indices of the parties whose share was rejected.
+ * @return true on success, false if fewer than k shares verify.
+ */
+bool CombineFirstValidSignatures(const std::string &doc,
+                                 const std::vector<RSASigShare> &sig_arr,
+                                 const CombineContext &ctx,
+                                 ThreadPool *pool,
+                                 safeheron::bignum::BN &out_sig,
+                                 std::vector<int> &signers,
+                                 std::vector<int> &invalid_indices){
+    signers.clear();
+    invalid_indices.clear();
+    const RSAPublicKey &public_key = ctx.public_key();
+    const RSAKeyMeta &key_meta = ctx.key_meta();
+    const size_t k = (size_t)key_meta.k();
+
+    // Candidates: the first share of every party, in order of arrival.
+    std::vector<size_t> candidate_arr;
+    std::vector<uint8_t> seen(key_meta.l() + 1, 0);
+    for(size_t s = 0; s < sig_arr.size(); s++){
+        int index = sig_arr[s].index();
+        if(index < 1 || index > key_meta.l()){
+            invalid_indices.push_back(index);
+            continue;
+        }
+        if(seen[index]) continue;
+        seen[index] = 1;
+        candidate_arr.push_back(s);
+    }
+    if(candidate_arr.size() < k) return false;
+
+    BN x = BN::FromBytesBE(doc);
+    if(BN::JacobiSymbol(x, public_key.n()) == -1){
+        x = ctx.mont().MulM(x, ctx.vku_e());
+    }
+    SigShareVerifyContext verify_ctx(key_meta, x, public_key.n(), k);
+
+    // Every thread takes the next candidate until k verify, or too many have failed to ever reach k.
+    // At most one candidate per thread beyond the k-th valid one is verified.
+    const size_t max_invalid = candidate_arr.size() - k;
+    std::vector<uint8_t> status_arr(candidate_arr.size(), 0);  // 0: not verified, 1: valid, 2: invalid
+    std::atomic<size_t> next(0);
+    std::atomic<size_t> valid_count(0);
+    std::atomic<size_t> invalid_count(0);
+    auto verify = [&](size_t){
+        while(valid_count.load() < k && invalid_count.load() <= max_invalid){
+            size_t t = next.fetch_add(1);
+            if(t >= candidate_arr.size()) return;
+            const RSASigShare &sig = sig_arr[candidate_arr[t]];
+            RSASigShareProof proof(sig.z(), sig.c());
+            if(proof.Verify(verify_ctx, sig.index() - 1, sig.sig_share())){
+                status_arr[t] = 1;
+                valid_count++;
+            }else{
+                status_arr[t] = 2;
+                invalid_count++;
+            }
+        }
+    };
+    if(pool){
+        pool->ParallelFor(pool->thread_count(), verify);
+    }else{
+        verify(0);
+    }
+
+    // The first k valid shares in order of arrival, so the subset does not depend on thread timing.
+    std::vector<RSASigShare> chosen;
+    for(size_t t = 0; t < candidate_arr.size(); t++){
+        if(status_arr[t] == 2) invalid_indices.push_back(sig_arr[candidate_arr[t]].index());
+        if(status_arr[t] == 1 && chosen.size() < k) chosen.push_back(sig_arr[candidate_arr[t]]);
+    }
+    if(chosen.size() < k) return false;
+
+    if(!InternalCombineSignatures(BN::FromBytesBE(doc), chosen, ctx, false, out_sig)) return false;
+    for(const auto &sig : chosen) signers.push_back(sig.index());
+    std::sort(signers.begin(), signers.end());
+    return true;
+}
+
+/**
+ * Verify the proofs of the shares of signature.
+ * @param[in] doc: doc
+ * @param[in] sig_arr : the shares of signature.
+ * @param[in] public_key: public key.
+ * @param[in] key_meta: key meta data.
+ * @param[out] invalid_indices: indices of the parties whose share does not verify.
+ * @return true if all the shares verify, false otherwise.
+ */
+bool VerifySignatureShares(const std::string &doc,
+                           const std::vector<RSASigShare> &sig_arr,
+                           const RSAPublicKey &public_key,
+                           const RSAKeyMeta &key_meta,
+                           std::vector<int> &invalid_indices){
+    invalid_indices.clear();
+    int jacobi_m_n;
+    BN x = PrepareX(BN::FromBytesBE(doc), public_key, key_meta, jacobi_m_n);
+
+    SigShareVerifyContext ctx(key_meta, x, public_key.n(), sig_arr.size());
+    for (const auto &sig: sig_arr) {
+        if (sig.index() < 1 || (size_t)sig.index() > key_meta.vki_arr().size()) {
+            invalid_indices.push_back(sig.index());
+            continue;
+        }
+        RSASigShareProof proof(sig.z(), sig.c());
+        if (!proof.Verify(ctx, sig.index() - 1, sig.sig_share())) {
+            invalid_indices.push_back(sig.index());
+        }
+    }
+    return invalid_indices.empty();
 }
 
 };
@@ -6,6 +6,14 @@
 #include "RSASigShare.h"
 #include "RSAKeyMeta.h"
 #include "KeyGenParam.h"
+#include "CombineContext.h"
+#include "SafePrimeSearch.h"
+#include "SafePrimePool.h"
+#include "ThreadPool.h"
+#include "SigningPipeline.h"
+#include "KeyStore.h"
+#include "Metrics.h"
+#include <cstdint>
 #include "emsa_pss.h"
 #include <vector>
 
@@ -28,8 +36,28 @@ bool GenerateKey(size_t key_bits_length, int l, int k,
                  RSAPublicKey &public_key,
                  RSAKeyMeta &key_meta);
 
+/**
+ * Generate private key shares, public key, key meta data, with a safe prime pair taken from a pool.
+ * When the pool has no pair for key_bits_length, the primes are generated inline as in GenerateKey.
+ *
+ * @param[in] key_bits_length: 2048, 3072, 4096 is advised.
+ * @param[in] l: total number of private key shares.
+ * @param[in] k: threshold, k < l and k >= (l/2+1)
+ * @param[in] pool: pool of safe prime pairs, see SafePrimePool.
+ * @param[out] private_key_share_arr: shares of private key.
+ * @param[out] public_key: public key.
+ * @param[out] key_meta: key meta data.
+ * @return true on success, false on error.
+ */
+bool GenerateKey(size_t key_bits_length, int l, int k,
+                 SafePrimePool &pool,
+                 std::vector<RSAPrivateKeyShare> &private_key_share_arr,
+                 RSAPublicKey &public_key,
+                 RSAKeyMeta &key_meta);
+
 /**
  * Generate private key shares, public key, key meta data with specified parameters.
+ * With param.thread_count() > 0 the missing safe primes are searched on that many threads, see RandomSafePrimePairParallel.
  *
  * @param[in] key_bits_length: 2048, 3072, 4096 is advised.
  * @param[in] l: total number of private key shares.
@@ -46,6 +74,31 @@ bool GenerateKeyEx(size_t key_bits_length, int l, int k,
                    RSAPublicKey &public_key,
                    RSAKeyMeta &key_meta);
 
+/**
+ * Share the private key of an existing key again, for a new (k, l): refresh the shares, or move the key
+ * to another set of parties. The modulus is kept, so no safe prime is searched: n, e, vkv and vku stay the
+ * same, the shares and vki are new. Any k of the former shares still sign, so they must be destroyed.
+ * This is a dealer operation, it needs the primes of the key.
+ *
+ * @param[in] p: the safe prime p of the key.
+ * @param[in] q: the safe prime q of the key.
+ * @param[in] public_key: public key, n = pq.
+ * @param[in] key_meta: key meta data of the current shares.
+ * @param[in] l: total number of private key shares.
+ * @param[in] k: threshold, k < l and k >= (l/2+1)
+ * @param[in] pool: thread pool to compute the vki on, see ThreadPool. nullptr for the calling thread.
+ * @param[out] private_key_share_arr: new shares of private key.
+ * @param[out] out_key_meta: key meta data of the new shares.
+ * @return true on success, false on error.
+ */
+bool ReshareKey(const safeheron::bignum::BN &p, const safeheron::bignum::BN &q,
+                const RSAPublicKey &public_key,
+                const RSAKeyMeta &key_meta,
+                int l, int k,
+                ThreadPool *pool,
+                std::vector<RSAPrivateKeyShare> &private_key_share_arr,
+                RSAKeyMeta &out_key_meta);
+
 /**
  * Combine all the shares of signature to make a real signature.
  * @param[in] doc: doc
@@ -61,10 +114,23 @@ bool CombineSignatures(const std::string &doc,
                        const RSAKeyMeta &key_meta,
                        safeheron::bignum::BN &out_sig);
 
+/**
+ * Combine all the shares of signature to make a real signature, with the cached key data of ctx.
+ * @param[in] doc: doc
+ * @param[in] sig_arr : the shares of signature.
+ * @param[in] ctx: combine context of the key, see CombineContext.
+ * @param[out] out_sig: a real signature.
+ * @return true on success, false on error.
+ */
+bool CombineSignatures(const std::string &doc,
+                       const std::vector<RSASigShare> &sig_arr,
+                       const CombineContext &ctx,
+                       safeheron::bignum::BN &out_sig);
+
 
 /**
  * Combine all the shares of signature without validation on signature shares to make a real signature.
- * @note The function "CombineSignaturesWithoutValidation" is very fast. It's about 50 times faster than "CombineSignatures".
+ * @note The function "CombineSignaturesWithoutValidation" is fast: it skips the proof of every share, which dominates the cost of "CombineSignatures".
  * @param[in] doc: doc
  * @param[in] sig_arr : the shares of signature.
  * @param[in] public_key: public key.
@@ -78,6 +144,98 @@ bool CombineSignaturesWithoutValidation(const std::string &doc,
                                         const RSAKeyMeta &key_meta,
                                         safeheron::bignum::BN &out_sig);
 
+/**
+ * Combine all the shares of signature without validation on signature shares to make a real signature,
+ * with the cached key data of ctx.
+ * @param[in] doc: doc
+ * @param[in] sig_arr : the shares of signature.
+ * @param[in] ctx: combine context of the key, see CombineContext.
+ * @param[out] out_sig: a real signature.
+ * @return true on success, false on error.
+ */
+bool CombineSignaturesWithoutValidation(const std::string &doc,
+                                        const std::vector<RSASigShare> &sig_arr,
+                                        const CombineContext &ctx,
+                                        safeheron::bignum::BN &out_sig);
+
+/**
+ * Combine the shares of signature of many documents, on the threads of pool.
+ * The proofs of all the shares of all the documents are verified concurrently, then the shares of every
+ * valid document are combined concurrently. A document fails as a whole if one of its shares is invalid.
+ * @param[in] doc_arr: docs
+ * @param[in] sig_arr_arr: sig_arr_arr[i] are the shares of signature of doc_arr[i].
+ * @param[in] ctx: combine context of the key, see CombineContext.
+ * @param[in] pool: thread pool, see ThreadPool.
+ * @param[out] out_sig_arr: out_sig_arr[i] is the signature of doc_arr[i].
+ * @param[out] status_arr: status_arr[i] is 1 on success, 0 on error.
+ * @return true if all the documents succeed, false otherwise.
+ */
+bool CombineSignaturesBatch(const std::vector<std::string> &doc_arr,
+                            const std::vector<std::vector<RSASigShare>> &sig_arr_arr,
+                            const CombineContext &ctx,
+                            ThreadPool &pool,
+                            std::vector<safeheron::bignum::BN> &out_sig_arr,
+                            std::vector<uint8_t> &status_arr);
+
+/**
+ * Combine the shares of signature of many documents, on the threads of pool.
+ * @param[in] doc_arr: docs
+ * @param[in] sig_arr_arr: sig_arr_arr[i] are the shares of signature of doc_arr[i].
+ * @param[in] public_key: public key.
+ * @param[in] key_meta: key meta data.
+ * @param[in] pool: thread pool, see ThreadPool.
+ * @param[out] out_sig_arr: out_sig_arr[i] is the signature of doc_arr[i].
+ * @param[out] status_arr: status_arr[i] is 1 on success, 0 on error.
+ * @return true if all the documents succeed, false otherwise.
+ */
+bool CombineSignaturesBatch(const std::vector<std::string> &doc_arr,
+                            const std::vector<std::vector<RSASigShare>> &sig_arr_arr,
+                            const RSAPublicKey &public_key,
+                            const RSAKeyMeta &key_meta,
+                            ThreadPool &pool,
+                            std::vector<safeheron::bignum::BN> &out_sig_arr,
+                            std::vector<uint8_t> &status_arr);
+
+/**
+ * Combine the first k shares of signature whose proof verifies, out of any number of shares.
+ * Unlike CombineSignatures, which fails as soon as one share is invalid, the invalid shares are set aside
+ * and reported, and the shares beyond the k-th valid one are not verified at all. The shares are verified
+ * in order of arrival, concurrently on the threads of pool, and the exponents of the chosen subset come
+ * from the memo of ctx. A share whose index is out of (1, ... ,l) is rejected; a second share of the same
+ * party is ignored.
+ * @param[in] doc: doc
+ * @param[in] sig_arr : the shares of signature, in order of arrival.
+ * @param[in] ctx: combine context of the key, see CombineContext.
+ * @param[in] pool: thread pool, see ThreadPool. nullptr to verify the shares on the calling thread.
+ * @param[out] out_sig: a real signature.
+ * @param[out] signers: indices of the k parties whose shares were combined, sorted.
+ * @param[out] invalid_indices: indices of the parties whose share was rejected.
+ * @return true on success, false if fewer than k shares verify.
+ */
+bool CombineFirstValidSignatures(const std::string &doc,
+                                 const std::vector<RSASigShare> &sig_arr,
+                                 const CombineContext &ctx,
+                                 ThreadPool *pool,
+                                 safeheron::bignum::BN &out_sig,
+                                 std::vector<int> &signers,
+                                 std::vector<int> &invalid_indices);
+
+/**
+ * Verify the proofs of the shares of signature, and report all the invalid ones.
+ * The per-document work (x^4 and its exponentiation table) is shared by all the shares.
+ * @param[in] doc: doc
+ * @param[in] sig_arr : the shares of signature.
+ * @param[in] public_key: public key.
+ * @param[in] key_meta: key meta data.
+ * @param[out] invalid_indices: indices of the parties whose share does not verify.
+ * @return true if all the shares verify, false otherwise.
+ */
+bool VerifySignatureShares(const std::string &doc,
+                           const std::vector<RSASigShare> &sig_arr,
+                           const RSAPublicKey &public_key,
+                           const RSAKeyMeta &key_meta,
+                           std::vector<int> &invalid_indices);
+
 
 };
 };
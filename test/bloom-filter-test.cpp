@@ -0,0 +1,215 @@
+#include "gtest/gtest.h"
+#include <thread>
+#include "exception/safeheron_exceptions.h"
+#include "../src/crypto-tss-rsa/BloomFilter.h"
+
+using safeheron::tss_rsa::BloomFilter;
+using safeheron::tss_rsa::BloomFilterView;
+using safeheron::tss_rsa::BlockedBloomFilter;
+using safeheron::exception::LocatedException;
+
+TEST(BloomFilter, DefaultParameters) {
+    Transaction transaction;
+    EXPECT_EQ(transaction.bloom_filter.m(), 48);
+    EXPECT_EQ(transaction.bloom_filter.k(), 17);
+    EXPECT_EQ(transaction.bloom_filter.ToString(), std::string(48, '0'));
+
+    safeheron::tss_rsa::update_bloom_filter(transaction, "{\"i\" : 1}");
+    EXPECT_TRUE(transaction.bloom_filter.Contains("{\"i\" : 1}"));
+
+    transaction.data = "transaction data";
+    safeheron::tss_rsa::append_bloom_filter(transaction);
+    EXPECT_EQ(transaction.data.size(), 16 + 9 + 8);
+    BloomFilterView view = safeheron::tss_rsa::extract_bloom_filter(transaction);
+    ASSERT_TRUE(view.valid());
+    EXPECT_EQ(view.ToBloomFilter().ToString(), transaction.bloom_filter.ToString());
+}
+
+TEST(BloomFilter, BinaryTrailer) {
+    Transaction transaction;
+    transaction.bloom_filter = BloomFilter(1000, 0.01);
+    for (int i = 0; i < 1000; i++) {
+        safeheron::tss_rsa::update_bloom_filter(transaction, "key share " + std::to_string(i));
+    }
+    transaction.data = "transaction data";
+    safeheron::tss_rsa::append_bloom_filter(transaction);
+    // 9586 bits: 150 words instead of 9586 '0'/'1' characters
+    EXPECT_EQ(transaction.bloom_filter.SerializedSize(), 150 * 8 + 9);
+    EXPECT_EQ(transaction.data.size(), 16 + transaction.bloom_filter.SerializedSize());
+    EXPECT_EQ(transaction.data.back(), 2);
+
+    BloomFilterView view = safeheron::tss_rsa::extract_bloom_filter(transaction);
+    ASSERT_TRUE(view.valid());
+    // No copy: the view points into the transaction data
+    EXPECT_EQ(view.data(), transaction.data.data() + 16);
+    EXPECT_EQ(view.m(), 9586);
+    EXPECT_EQ(view.k(), 7);
+    for (size_t i = 0; i < view.m(); i++) {
+        EXPECT_EQ(view.TestBit(i), transaction.bloom_filter.TestBit(i));
+    }
+    for (int i = 0; i < 1000; i++) {
+        EXPECT_TRUE(view.Contains("key share " + std::to_string(i)));
+    }
+    EXPECT_EQ(view.ToBloomFilter().ToString(), transaction.bloom_filter.ToString());
+
+    // The receiver does not need m and k: the footer carries them.
+    Transaction received;
+    received.data = transaction.data;
+    BloomFilterView received_view = safeheron::tss_rsa::extract_bloom_filter(received);
+    ASSERT_TRUE(received_view.valid());
+    EXPECT_EQ(received_view.m(), 9586);
+    EXPECT_EQ(received_view.k(), 7);
+    EXPECT_EQ(received_view.data(), received.data.data() + 16);
+
+    // Truncated or corrupted trailers are rejected
+    BloomFilterView bad;
+    EXPECT_FALSE(BloomFilterView::Parse(view.data(), view.size() - 1, bad));
+    EXPECT_FALSE(BloomFilterView::Parse(view.data() + 1, view.size() - 1, bad));
+    std::string corrupted(view.data(), view.size());
+    corrupted.back() = 1;
+    EXPECT_FALSE(BloomFilterView::Parse(corrupted.data(), corrupted.size(), bad));
+    EXPECT_FALSE(BloomFilterView::ParseTrailer(corrupted.data(), corrupted.size(), bad));
+    std::string too_long(view.data(), view.size());
+    too_long[too_long.size() - 9 + 3] = 0x7f;  // m far beyond the buffer
+    EXPECT_FALSE(BloomFilterView::ParseTrailer(too_long.data(), too_long.size(), bad));
+    EXPECT_FALSE(bad.valid());
+    transaction.data = "short";
+    EXPECT_FALSE(safeheron::tss_rsa::extract_bloom_filter(transaction).valid());
+}
+
+TEST(BloomFilter, SizedByFalsePositiveRate) {
+    BloomFilter filter(1000, 0.01);
+    // m = ceil(-1000 * ln(0.01) / ln(2)^2) = 9586, k = round(9586 / 1000 * ln(2)) = 7
+    EXPECT_EQ(filter.m(), 9586);
+    EXPECT_EQ(filter.k(), 7);
+
+    for (int i = 0; i < 1000; i++) {
+        filter.Add("key share " + std::to_string(i));
+    }
+    for (int i = 0; i < 1000; i++) {
+        EXPECT_TRUE(filter.Contains("key share " + std::to_string(i)));
+    }
+    int false_positives = 0;
+    for (int i = 0; i < 10000; i++) {
+        if (filter.Contains("absent " + std::to_string(i))) false_positives++;
+    }
+    EXPECT_LT(false_positives, 300);
+
+    filter.Clear();
+    EXPECT_FALSE(filter.Contains("key share 0"));
+}
+
+TEST(BloomFilter, DoubleHashingIsPortable) {
+    // The indices must not depend on the platform, so the bits of a fixed input are pinned here.
+    BloomFilter filter = BloomFilter::Create(64, 5);
+    EXPECT_EQ(filter.mode(), safeheron::tss_rsa::BloomHashMode::DoubleHashing);
+    filter.Add("hello");
+    // MurmurHash3_x64_128("hello", seed = 0): h1 = 0xcbd8a7b341bd9b02, h2 = 0x5b1e906a48ae1d19
+    uint64_t h1 = 0xcbd8a7b341bd9b02ULL;
+    uint64_t h2 = 0x5b1e906a48ae1d19ULL | 1;
+    std::string expected(64, '0');
+    for (uint64_t i = 0; i < 5; i++) {
+        expected[63 - (h1 + i * h2) % 64] = '1';
+    }
+    EXPECT_EQ(filter.ToString(), expected);
+
+    BloomFilter legacy = BloomFilter::Create(64, 5, safeheron::tss_rsa::BloomHashMode::StdHash);
+    legacy.Add("hello");
+    EXPECT_TRUE(legacy.Contains("hello"));
+}
+
+TEST(BloomFilter, InvalidParameters) {
+    EXPECT_THROW(BloomFilter(0, 0.01), LocatedException);
+    EXPECT_THROW(BloomFilter(100, 0.0), LocatedException);
+    EXPECT_THROW(BloomFilter(100, 1.0), LocatedException);
+    EXPECT_THROW(BloomFilter::Create(0, 3), LocatedException);
+}
+
+TEST(BloomFilter, ParallelUpdate) {
+    const int n_threads = 8;
+    std::vector<Transaction> transactions(n_threads * 16);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < n_threads; t++) {
+        threads.emplace_back([t, &transactions]() {
+            for (int i = t; i < (int)transactions.size(); i += n_threads) {
+                safeheron::tss_rsa::update_bloom_filter(transactions[i], "share " + std::to_string(i));
+            }
+        });
+    }
+    for (auto &th : threads) th.join();
+
+    for (size_t i = 0; i < transactions.size(); i++) {
+        Transaction expected;
+        safeheron::tss_rsa::update_bloom_filter(expected, "share " + std::to_string(i));
+        EXPECT_EQ(transactions[i].bloom_filter.ToString(), expected.bloom_filter.ToString());
+    }
+}
+
+TEST(BlockedBloomFilter, AddAndContains) {
+    BlockedBloomFilter filter(1000, 0.01);
+    EXPECT_EQ(filter.m() % BlockedBloomFilter::BLOCK_BITS, 0);
+    EXPECT_EQ(filter.m(), filter.block_count() * BlockedBloomFilter::BLOCK_BITS);
+    EXPECT_LE(filter.k(), BlockedBloomFilter::MAX_K);
+
+    for (int i = 0; i < 1000; i++) {
+        filter.Add("key share " + std::to_string(i));
+    }
+    for (int i = 0; i < 1000; i++) {
+        EXPECT_TRUE(filter.Contains("key share " + std::to_string(i)));
+    }
+    int false_positives = 0;
+    for (int i = 0; i < 10000; i++) {
+        if (filter.Contains("absent " + std::to_string(i))) false_positives++;
+    }
+    EXPECT_LT(false_positives, 300);
+
+    BlockedBloomFilter copy = filter;
+    EXPECT_TRUE(copy.Contains("key share 7"));
+    filter.Clear();
+    EXPECT_FALSE(filter.Contains("key share 7"));
+    EXPECT_TRUE(copy.Contains("key share 7"));
+
+    EXPECT_THROW(BlockedBloomFilter::Create(0, 8), LocatedException);
+    EXPECT_THROW(BlockedBloomFilter::Create(4, 17), LocatedException);
+}
+
+TEST(BlockedBloomFilter, TestMany) {
+    BlockedBloomFilter filter = BlockedBloomFilter::Create(8, 8);
+    std::vector<std::string> elements;
+    for (int i = 0; i < 100; i++) {
+        elements.push_back("fingerprint " + std::to_string(i));
+        if (i % 2 == 0) filter.Add(elements.back());
+    }
+    std::vector<uint8_t> results;
+    filter.TestMany(elements, results);
+    ASSERT_EQ(results.size(), elements.size());
+    for (size_t i = 0; i < elements.size(); i++) {
+        EXPECT_EQ(results[i], filter.Contains(elements[i]) ? 1 : 0);
+        if (i % 2 == 0) {
+            EXPECT_EQ(results[i], 1);
+        }
+    }
+
+    // One element against many filters of different sizes and k.
+    std::vector<BlockedBloomFilter> filters;
+    for (size_t i = 0; i < 20; i++) {
+        filters.push_back(BlockedBloomFilter::Create(1 + i, 1 + i % 16));
+        if (i % 3 == 0) filters.back().Add("target");
+    }
+    std::vector<const BlockedBloomFilter *> filter_ptrs;
+    for (const auto &f : filters) filter_ptrs.push_back(&f);
+    BlockedBloomFilter::TestMany("target", filter_ptrs, results);
+    ASSERT_EQ(results.size(), filters.size());
+    for (size_t i = 0; i < filters.size(); i++) {
+        EXPECT_EQ(results[i], filters[i].Contains("target") ? 1 : 0);
+        if (i % 3 == 0) {
+            EXPECT_EQ(results[i], 1);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    int ret = RUN_ALL_TESTS();
+    return ret;
+}
@@ -0,0 +1,92 @@
+#include "gtest/gtest.h"
+#include <memory>
+#include "exception/safeheron_exceptions.h"
+#include "../src/crypto-tss-rsa/BloomFilter.h"
+#include "../src/crypto-tss-rsa/CuckooFilter.h"
+
+using safeheron::tss_rsa::BloomFilter;
+using safeheron::tss_rsa::BlockedBloomFilter;
+using safeheron::tss_rsa::CuckooFilter;
+using safeheron::tss_rsa::MembershipFilter;
+using safeheron::exception::LocatedException;
+
+TEST(CuckooFilter, AddContainsRemove) {
+    CuckooFilter filter(1000);
+    // 256 buckets would be 98% full, so the table is doubled
+    EXPECT_EQ(filter.bucket_count(), 512);
+    EXPECT_EQ(filter.capacity(), 2048);
+    EXPECT_EQ(CuckooFilter(900).bucket_count(), 256);
+
+    for (int i = 0; i < 1000; i++) {
+        EXPECT_TRUE(filter.Add("key share " + std::to_string(i)));
+    }
+    EXPECT_EQ(filter.size(), 1000);
+    for (int i = 0; i < 1000; i++) {
+        EXPECT_TRUE(filter.Contains("key share " + std::to_string(i)));
+    }
+    int false_positives = 0;
+    for (int i = 0; i < 10000; i++) {
+        if (filter.Contains("absent " + std::to_string(i))) false_positives++;
+    }
+    // 8 fingerprints are compared per query, each matches with probability 1/255
+    EXPECT_LT(false_positives, 500);
+
+    for (int i = 0; i < 1000; i += 2) {
+        EXPECT_TRUE(filter.Remove("key share " + std::to_string(i)));
+    }
+    EXPECT_EQ(filter.size(), 500);
+    for (int i = 1; i < 1000; i += 2) {
+        EXPECT_TRUE(filter.Contains("key share " + std::to_string(i)));
+    }
+
+    filter.Clear();
+    EXPECT_EQ(filter.size(), 0);
+    EXPECT_FALSE(filter.Contains("key share 1"));
+    EXPECT_FALSE(filter.Remove("key share 1"));
+}
+
+TEST(CuckooFilter, Full) {
+    CuckooFilter filter(64);
+    int added = 0;
+    while (added < 1000 && filter.Add("key share " + std::to_string(added))) added++;
+    EXPECT_LT(added, 1000);
+    EXPECT_GE(added, 60);
+    EXPECT_EQ(filter.size(), added);
+    // The fingerprint kept aside is still found
+    for (int i = 0; i < added; i++) {
+        EXPECT_TRUE(filter.Contains("key share " + std::to_string(i)));
+    }
+    // Removing frees room again
+    EXPECT_TRUE(filter.Remove("key share 0"));
+    EXPECT_TRUE(filter.Add("key share 0"));
+    for (int i = 0; i < added; i++) {
+        EXPECT_TRUE(filter.Contains("key share " + std::to_string(i)));
+    }
+}
+
+TEST(CuckooFilter, InvalidParameters) {
+    EXPECT_THROW(CuckooFilter(0), LocatedException);
+}
+
+TEST(MembershipFilter, CommonInterface) {
+    std::vector<std::unique_ptr<MembershipFilter>> filters;
+    filters.emplace_back(new BloomFilter(100, 0.01));
+    filters.emplace_back(new BlockedBloomFilter(100, 0.01));
+    filters.emplace_back(new CuckooFilter(100));
+    for (auto &filter : filters) {
+        for (int i = 0; i < 100; i++) {
+            EXPECT_TRUE(filter->Add("key share " + std::to_string(i)));
+        }
+        for (int i = 0; i < 100; i++) {
+            EXPECT_TRUE(filter->Contains("key share " + std::to_string(i)));
+        }
+        filter->Clear();
+        EXPECT_FALSE(filter->Contains("key share 0"));
+    }
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    int ret = RUN_ALL_TESTS();
+    return ret;
+}
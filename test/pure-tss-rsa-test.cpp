@@ -1,14 +1,23 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <thread>
 #include "gtest/gtest.h"
 #include "crypto-bn/bn.h"
 #include "crypto-bn/rand.h"
+#include "crypto-encode/base64.h"
 #include "exception/safeheron_exceptions.h"
 #include "crypto-tss-rsa/tss_rsa.h"
+#include "crypto-tss-rsa/RSASigShareProof.h"
 
 using safeheron::bignum::BN;
 using safeheron::tss_rsa::RSAPrivateKeyShare;
 using safeheron::tss_rsa::RSAPublicKey;
 using safeheron::tss_rsa::RSAKeyMeta;
 using safeheron::tss_rsa::RSASigShare;
+using safeheron::tss_rsa::RSASigShareProof;
 using safeheron::tss_rsa::KeyGenParam;
 using safeheron::exception::LocatedException;
 using safeheron::exception::OpensslException;
@@ -177,6 +186,649 @@ TEST(TSS_RSA, KeyGenEx2_3_Sign_2_3) {
     EXPECT_TRUE(pub.VerifySignature(doc, sig));
 }
 
+TEST(TSS_RSA, KeyGenEx2_3_SignBatch) {
+    KeyGenParam param(0,
+                      BN("E4AAECAA632881A60D11813CC8379980C673BEFB959F44AA14BB15F141ADBE9E6B25FA3A8715435427B10AA608946D0A7B68A4F75BDC376E12010F813F480007", 16),
+                      BN("C32F913ECDF403DB94B07A8D02AF2934A882226F3535E6436A6A2392A2C390E525D4531D6EFF2028AE8E16F856E0945348E007EDAC43B4CE9BE5E68D76E93E63", 16),
+                      BN("77268D1F347AB0EE48741FBFFD3A052154B8FC614C0FD357F5D0E7B4119D24A4EC47FFFE68DD9BB097D2D7848B08070AEEB25C99EDAA95387F71D8589209973E538D4BC9E693963E485097EB0B8AE8ACD84A13385EC1DBEB070ABAB02E322C247DE70944B17CF3109CBF3DABAB9C66C579706C00CF719314F83A48224FF16DC9", 16),
+                      BN("1E7989EBD93507193CE394263F7C32F434E67F1750A367EC725495899BEF99EBC8FCF41148B82D66BB03BAAA25625DD12B29BAA3B43807C15988278E4BD0E64BBCC133B5583431A48BB58BA188CFBDEA1B6170EDAA4D0B1E0AA0D4CCACDB3A66A7DE6A6AC31CB14B802F45AEB4FDBD9B3D621B9BE88050749A093A382EF914C1", 16));
+
+    // Key Generation
+    int key_bits_length = 1024;
+    int k = 2;
+    int l = 3;
+    std::vector<RSAPrivateKeyShare> priv_arr;
+    RSAPublicKey pub;
+    RSAKeyMeta key_meta;
+    bool status = safeheron::tss_rsa::GenerateKeyEx(key_bits_length, l, k, param, priv_arr, pub, key_meta);
+    EXPECT_TRUE(status);
+
+    std::vector<std::string> docs;
+    for (int i = 0; i < 8; i++) {
+        docs.emplace_back("12345678123456781234567812345678, " + std::to_string(i));
+    }
+
+    // Party 1 and party 3 sign all the documents at once.
+    std::vector<RSASigShare> batch0 = priv_arr[0].SignBatch(docs, key_meta, pub);
+    std::vector<RSASigShare> batch2 = priv_arr[2].SignBatch(docs, key_meta, pub);
+    ASSERT_EQ(batch0.size(), docs.size());
+    ASSERT_EQ(batch2.size(), docs.size());
+
+    for (size_t i = 0; i < docs.size(); i++) {
+        // Same signature share as a single Sign
+        EXPECT_EQ(batch0[i].sig_share(), priv_arr[0].Sign(docs[i], key_meta, pub).sig_share());
+
+        std::vector<RSASigShare> sig_share_arr;
+        sig_share_arr.push_back(batch0[i]);
+        sig_share_arr.push_back(batch2[i]);
+        BN sig;
+        status = safeheron::tss_rsa::CombineSignatures(docs[i], sig_share_arr, pub, key_meta, sig);
+        EXPECT_TRUE(status);
+        EXPECT_TRUE(pub.VerifySignature(docs[i], sig));
+    }
+
+    EXPECT_TRUE(priv_arr[0].SignBatch(std::vector<std::string>(), key_meta, pub).empty());
+}
+
+TEST(TSS_RSA, KeyGenEx2_3_CombineContext) {
+    KeyGenParam param(0,
+                      BN("E4AAECAA632881A60D11813CC8379980C673BEFB959F44AA14BB15F141ADBE9E6B25FA3A8715435427B10AA608946D0A7B68A4F75BDC376E12010F813F480007", 16),
+                      BN("C32F913ECDF403DB94B07A8D02AF2934A882226F3535E6436A6A2392A2C390E525D4531D6EFF2028AE8E16F856E0945348E007EDAC43B4CE9BE5E68D76E93E63", 16),
+                      BN("77268D1F347AB0EE48741FBFFD3A052154B8FC614C0FD357F5D0E7B4119D24A4EC47FFFE68DD9BB097D2D7848B08070AEEB25C99EDAA95387F71D8589209973E538D4BC9E693963E485097EB0B8AE8ACD84A13385EC1DBEB070ABAB02E322C247DE70944B17CF3109CBF3DABAB9C66C579706C00CF719314F83A48224FF16DC9", 16),
+                        BN("1E7989EBD93507193CE394263F7C32F434E67F1750A367EC725495899BEF99EBC8FCF41148B82D66BB03BAAA25625DD12B29BAA3B43807C15988278E4BD0E64BBCC133B5583431A48BB58BA188CFBDEA1B6170EDAA4D0B1E0AA0D4CCACDB3A66A7DE6A6AC31CB14B802F45AEB4FDBD9B3D621B9BE88050749A093A382EF914C1", 16));
+
+    // Key Generation
+    int key_bits_length = 1024;
+    int k = 2;
+    int l = 3;
+    std::vector<RSAPrivateKeyShare> priv_arr;
+    RSAPublicKey pub;
+    RSAKeyMeta key_meta;
+    bool status = safeheron::tss_rsa::GenerateKeyEx(key_bits_length, l, k, param, priv_arr, pub, key_meta);
+    EXPECT_TRUE(status);
+
+    safeheron::tss_rsa::CombineContext ctx(pub, key_meta);
+    EXPECT_EQ(ctx.delta(), BN(6));
+    EXPECT_EQ(ctx.a() * 4 + ctx.b() * pub.e(), BN(1));
+
+    // Signer subsets {1, 2}, {2, 3}, {1, 3}, {1, 2, 3}, in any order
+    std::vector<std::vector<int>> subsets = {{1, 2}, {3, 2}, {1, 3}, {3, 1}, {2, 1, 3}};
+    for (size_t t = 0; t < subsets.size(); t++) {
+        std::string doc = "12345678123456781234567812345678, " + std::to_string(t);
+        std::vector<RSASigShare> sig_share_arr;
+        for (int i : subsets[t]) {
+            sig_share_arr.push_back(priv_arr[i - 1].Sign(doc, key_meta, pub));
+        }
+        BN sig, sig_ref;
+        EXPECT_TRUE(safeheron::tss_rsa::CombineSignatures(doc, sig_share_arr, ctx, sig));
+        EXPECT_TRUE(pub.VerifySignature(doc, sig));
+        EXPECT_TRUE(safeheron::tss_rsa::CombineSignaturesWithoutValidation(doc, sig_share_arr, ctx, sig));
+        EXPECT_TRUE(pub.VerifySignature(doc, sig));
+        EXPECT_TRUE(safeheron::tss_rsa::CombineSignatures(doc, sig_share_arr, pub, key_meta, sig_ref));
+        EXPECT_EQ(sig, sig_ref);
+    }
+    EXPECT_EQ(ctx.lagrange_cache_size(), 4);
+    EXPECT_EQ(ctx.lagrange_cache_misses(), 4);
+    EXPECT_EQ(ctx.lagrange_cache_hits(), 6);
+
+    // Least recently used subset evicted
+    safeheron::tss_rsa::CombineContext small_ctx(pub, key_meta, 2);
+    std::shared_ptr<const std::vector<BN>> exps_12 = small_ctx.LagrangeExponents(std::vector<int>({1, 2}));
+    small_ctx.LagrangeExponents(std::vector<int>({2, 3}));
+    EXPECT_EQ(small_ctx.LagrangeExponents(std::vector<int>({1, 2})), exps_12);
+    small_ctx.LagrangeExponents(std::vector<int>({1, 3}));
+    EXPECT_EQ(small_ctx.lagrange_cache_size(), 2);
+    EXPECT_EQ(small_ctx.LagrangeExponents(std::vector<int>({1, 2})), exps_12);
+    EXPECT_EQ(small_ctx.lagrange_cache_hits(), 2);
+    EXPECT_EQ(small_ctx.lagrange_cache_misses(), 3);
+    small_ctx.LagrangeExponents(std::vector<int>({2, 3}));
+    EXPECT_EQ(small_ctx.lagrange_cache_misses(), 4);
+    EXPECT_EQ(*small_ctx.LagrangeExponents(std::vector<int>({1, 3})), *ctx.LagrangeExponents(std::vector<int>({1, 3})));
+    EXPECT_EQ(small_ctx.lagrange_cache_misses(), 5);
+
+    // Unsorted, duplicate and out of range subsets are rejected, not memoized
+    EXPECT_FALSE(small_ctx.LagrangeExponents(std::vector<int>({2, 1})));
+    EXPECT_FALSE(small_ctx.LagrangeExponents(std::vector<int>({1, 1})));
+    EXPECT_FALSE(small_ctx.LagrangeExponents(std::vector<int>({0, 1})));
+    EXPECT_FALSE(small_ctx.LagrangeExponents(std::vector<int>({1, 4})));
+    EXPECT_FALSE(small_ctx.LagrangeExponents(std::vector<uint64_t>({(uint64_t)1 << 4 | 2})));
+    EXPECT_FALSE(small_ctx.LagrangeExponents(std::vector<uint64_t>({3})));
+    EXPECT_FALSE(small_ctx.LagrangeExponents(std::vector<uint64_t>({6, 0})));
+    EXPECT_EQ(small_ctx.lagrange_cache_misses(), 5);
+
+    // The same party twice
+    std::string doc("12345678123456781234567812345678");
+    std::vector<RSASigShare> sig_share_arr;
+    sig_share_arr.push_back(priv_arr[0].Sign(doc, key_meta, pub));
+    sig_share_arr.push_back(priv_arr[0].Sign(doc, key_meta, pub));
+    BN sig;
+    EXPECT_FALSE(safeheron::tss_rsa::CombineSignaturesWithoutValidation(doc, sig_share_arr, ctx, sig));
+}
+
+TEST(TSS_RSA, RandomSafePrimeParallel) {
+    for (size_t thread_count : {1, 3}) {
+        BN p = safeheron::tss_rsa::RandomSafePrimeParallel(512, thread_count);
+        EXPECT_EQ(p.BitLength(), 512);
+        EXPECT_TRUE(p.IsBitSet(510));
+        EXPECT_TRUE(p.IsProbablyPrime());
+        EXPECT_TRUE(((p - 1) / 2).IsProbablyPrime());
+    }
+
+    BN p, q;
+    safeheron::tss_rsa::RandomSafePrimePairParallel(512, 511, 2, p, q);
+    EXPECT_EQ(p.BitLength(), 512);
+    EXPECT_EQ(q.BitLength(), 511);
+    EXPECT_TRUE(p.IsProbablyPrime() && ((p - 1) / 2).IsProbablyPrime());
+    EXPECT_TRUE(q.IsProbablyPrime() && ((q - 1) / 2).IsProbablyPrime());
+}
+
+TEST(TSS_RSA, KeyGenEx2_3_ParallelSafePrimes) {
+    std::string doc("12345678123456781234567812345678");
+
+    KeyGenParam param;
+    param.set_thread_count(2);
+    param.set_self_check(true);
+    int key_bits_length = 1024;
+    int k = 2;
+    int l = 3;
+    std::vector<RSAPrivateKeyShare> priv_arr;
+    RSAPublicKey pub;
+    RSAKeyMeta key_meta;
+    bool status = safeheron::tss_rsa::GenerateKeyEx(key_bits_length, l, k, param, priv_arr, pub, key_meta);
+    EXPECT_TRUE(status);
+    for (int i = 0; i < l; ++i) {
+        EXPECT_EQ(key_meta.vki(i), key_meta.vkv().PowM(priv_arr[i].si(), pub.n()));
+    }
+
+    std::vector<RSASigShare> sig_share_arr;
+    sig_share_arr.push_back(priv_arr[0].Sign(doc, key_meta, pub));
+    sig_share_arr.push_back(priv_arr[2].Sign(doc, key_meta, pub));
+    BN sig;
+    status = safeheron::tss_rsa::CombineSignatures(doc ,sig_share_arr, pub, key_meta, sig);
+    EXPECT_TRUE(status);
+    EXPECT_TRUE(pub.VerifySignature(doc, sig));
+}
+
+TEST(TSS_RSA, KeyGen2_3_SafePrimePool) {
+    std::string doc("12345678123456781234567812345678");
+
+    safeheron::tss_rsa::SafePrimePool pool({1024}, 2, 1);
+    EXPECT_TRUE(pool.Supports(1024));
+    EXPECT_FALSE(pool.Supports(2048));
+    for (int i = 0; i < 600 && pool.Stats(1024).available < 2; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    safeheron::tss_rsa::SafePrimePoolStats stats = pool.Stats(1024);
+    EXPECT_EQ(stats.available, 2);
+    EXPECT_EQ(stats.capacity, 2);
+    EXPECT_EQ(stats.generated, 2);
+
+    BN p, q;
+    EXPECT_FALSE(pool.TryTake(2048, p, q));
+    EXPECT_TRUE(pool.TryTake(1024, p, q));
+    EXPECT_EQ(p.BitLength(), 512);
+    EXPECT_EQ(q.BitLength(), 511);
+    EXPECT_TRUE(p.IsProbablyPrime() && ((p - 1) / 2).IsProbablyPrime());
+    EXPECT_TRUE(q.IsProbablyPrime() && ((q - 1) / 2).IsProbablyPrime());
+
+    int k = 2;
+    int l = 3;
+    std::vector<RSAPrivateKeyShare> priv_arr;
+    RSAPublicKey pub;
+    RSAKeyMeta key_meta;
+    bool status = safeheron::tss_rsa::GenerateKey(1024, l, k, pool, priv_arr, pub, key_meta);
+    EXPECT_TRUE(status);
+    EXPECT_EQ(pool.Stats(1024).taken, 2);
+    EXPECT_NE(pub.n(), p * q);
+
+    std::vector<RSASigShare> sig_share_arr;
+    sig_share_arr.push_back(priv_arr[1].Sign(doc, key_meta, pub));
+    sig_share_arr.push_back(priv_arr[2].Sign(doc, key_meta, pub));
+    BN sig;
+    status = safeheron::tss_rsa::CombineSignatures(doc ,sig_share_arr, pub, key_meta, sig);
+    EXPECT_TRUE(status);
+    EXPECT_TRUE(pub.VerifySignature(doc, sig));
+}
+
+TEST(TSS_RSA, SafePrimePoolCancel) {
+    // A 4096-bit pair takes minutes to find, the destructor must not wait for it.
+    auto start = std::chrono::steady_clock::now();
+    {
+        safeheron::tss_rsa::SafePrimePool pool({4096}, 1, 0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(10));
+
+    std::atomic<bool> cancel(true);
+    BN p, q;
+    EXPECT_FALSE(safeheron::tss_rsa::RandomSafePrimePairParallel(512, 511, 2, p, q, &cancel));
+}
+
+TEST(TSS_RSA, KeyGenEx2_3_CombineSignaturesBatch) {
+    KeyGenParam param(0,
+                      BN("E4AAECAA632881A60D11813CC8379980C673BEFB959F44AA14BB15F141ADBE9E6B25FA3A8715435427B10AA608946D0A7B68A4F75BDC376E12010F813F480007", 16),
+                      BN("C32F913ECDF403DB94B07A8D02AF2934A882226F3535E6436A6A2392A2C390E525D4531D6EFF2028AE8E16F856E0945348E007EDAC43B4CE9BE5E68D76E93E63", 16),
+                      BN::ZERO,
+                      BN::ZERO);
+    int k = 2;
+    int l = 3;
+    std::vector<RSAPrivateKeyShare> priv_arr;
+    RSAPublicKey pub;
+    RSAKeyMeta key_meta;
+    EXPECT_TRUE(safeheron::tss_rsa::GenerateKeyEx(1024, l, k, param, priv_arr, pub, key_meta));
+
+    std::vector<std::string> doc_arr;
+    std::vector<std::vector<RSASigShare>> sig_arr_arr;
+    for (int i = 0; i < 6; ++i) {
+        doc_arr.push_back("12345678123456781234567812345678" + std::to_string(i));
+        std::vector<RSASigShare> sig_arr;
+        sig_arr.push_back(priv_arr[i % 3].Sign(doc_arr[i], key_meta, pub));
+        sig_arr.push_back(priv_arr[(i + 1) % 3].Sign(doc_arr[i], key_meta, pub));
+        sig_arr_arr.push_back(sig_arr);
+    }
+    // Document 2: a share of another document. Document 4: the same party twice.
+    sig_arr_arr[2][1] = priv_arr[0].Sign(doc_arr[3], key_meta, pub);
+    sig_arr_arr[4][1] = sig_arr_arr[4][0];
+
+    safeheron::tss_rsa::CombineContext ctx(pub, key_meta);
+    safeheron::tss_rsa::ThreadPool pool(3);
+    std::vector<BN> sig_arr;
+    std::vector<uint8_t> status_arr;
+    EXPECT_FALSE(safeheron::tss_rsa::CombineSignaturesBatch(doc_arr, sig_arr_arr, ctx, pool, sig_arr, status_arr));
+    ASSERT_EQ(status_arr.size(), doc_arr.size());
+    for (size_t i = 0; i < doc_arr.size(); ++i) {
+        if (i == 2 || i == 4) {
+            EXPECT_EQ(status_arr[i], 0);
+            continue;
+        }
+        EXPECT_EQ(status_arr[i], 1);
+        EXPECT_TRUE(pub.VerifySignature(doc_arr[i], sig_arr[i]));
+    }
+
+    doc_arr.resize(2);
+    sig_arr_arr.resize(2);
+    EXPECT_TRUE(safeheron::tss_rsa::CombineSignaturesBatch(doc_arr, sig_arr_arr, pub, key_meta, pool, sig_arr, status_arr));
+    EXPECT_TRUE(pub.VerifySignature(doc_arr[1], sig_arr[1]));
+}
+
+
+TEST(TSS_RSA, KeyGenEx2_3_BytesEncoding) {
+    std::string doc("12345678123456781234567812345678");
+    KeyGenParam param(0,
+                      BN("E4AAECAA632881A60D11813CC8379980C673BEFB959F44AA14BB15F141ADBE9E6B25FA3A8715435427B10AA608946D0A7B68A4F75BDC376E12010F813F480007", 16),
+                      BN("C32F913ECDF403DB94B07A8D02AF2934A882226F3535E6436A6A2392A2C390E525D4531D6EFF2028AE8E16F856E0945348E007EDAC43B4CE9BE5E68D76E93E63", 16),
+                      BN("77268D1F347AB0EE48741FBFFD3A052154B8FC614C0FD357F5D0E7B4119D24A4EC47FFFE68DD9BB097D2D7848B08070AEEB25C99EDAA95387F71D8589209973E538D4BC9E693963E485097EB0B8AE8ACD84A13385EC1DBEB070ABAB02E322C247DE70944B17CF3109CBF3DABAB9C66C579706C00CF719314F83A48224FF16DC9", 16),
+                      BN("1E7989EBD93507193CE394263F7C32F434E67F1750A367EC725495899BEF99EBC8FCF41148B82D66BB03BAAA25625DD12B29BAA3B43807C15988278E4BD0E64BBCC133B5583431A48BB58BA188CFBDEA1B6170EDAA4D0B1E0AA0D4CCACDB3A66A7DE6A6AC31CB14B802F45AEB4FDBD9B3D621B9BE88050749A093A382EF914C1", 16));
+    std::vector<RSAPrivateKeyShare> priv_arr;
+    RSAPublicKey pub;
+    RSAKeyMeta key_meta;
+    bool status = safeheron::tss_rsa::GenerateKeyEx(1024, 3, 2, param, priv_arr, pub, key_meta);
+    ASSERT_TRUE(status);
+
+    std::string bytes, b64;
+    RSAPublicKey pub2;
+    ASSERT_TRUE(pub.ToBytes(bytes));
+    ASSERT_TRUE(pub2.FromBytes(bytes));
+    EXPECT_EQ(pub2.n(), pub.n());
+    EXPECT_EQ(pub2.e(), pub.e());
+
+    RSAKeyMeta key_meta2;
+    ASSERT_TRUE(key_meta.ToBytes(bytes));
+    ASSERT_TRUE(key_meta2.FromBytes(bytes));
+    EXPECT_EQ(key_meta2.k(), key_meta.k());
+    EXPECT_EQ(key_meta2.l(), key_meta.l());
+    EXPECT_EQ(key_meta2.vkv(), key_meta.vkv());
+    EXPECT_EQ(key_meta2.vku(), key_meta.vku());
+    EXPECT_EQ(key_meta2.vki_arr(), key_meta.vki_arr());
+    {
+        google::protobuf::Arena arena;
+        RSAKeyMeta key_meta3;
+        ASSERT_TRUE(key_meta.ToProtoBytes(arena, bytes));
+        ASSERT_TRUE(key_meta3.FromProtoBytes(arena, bytes.data(), bytes.size()));
+        EXPECT_EQ(key_meta3.vki_arr(), key_meta.vki_arr());
+    }
+
+    RSAPrivateKeyShare priv2 = priv_arr[0];
+    ASSERT_TRUE(priv_arr[1].ToBytes(bytes));
+    ASSERT_TRUE(priv2.FromBytes(bytes));
+    EXPECT_EQ(priv2.i(), priv_arr[1].i());
+    EXPECT_EQ(priv2.si(), priv_arr[1].si());
+
+    // Shares pass through the v2 encoding, which is about half the size of the v1 protobuf
+    google::protobuf::Arena arena;
+    std::string buf;
+    std::vector<RSASigShare> sig_share_arr;
+    for (size_t i = 0; i < 2; i++) {
+        RSASigShare sig_share = priv_arr[i].Sign(doc, key_meta2, pub2);
+        ASSERT_TRUE(sig_share.ToBytes(bytes));
+        ASSERT_TRUE(sig_share.ToBase64(b64));
+        std::string v1 = safeheron::encode::base64::DecodeFromBase64(b64);
+        EXPECT_LT(bytes.size() * 10, v1.size() * 6);
+
+        RSASigShare decoded;
+        ASSERT_TRUE(decoded.FromBytes(bytes));
+        EXPECT_EQ(decoded.index(), sig_share.index());
+        EXPECT_EQ(decoded.sig_share(), sig_share.sig_share());
+        EXPECT_EQ(decoded.z(), sig_share.z());
+        EXPECT_EQ(decoded.c(), sig_share.c());
+        // A v1 message has no version field, a truncated one is malformed
+        EXPECT_FALSE(decoded.FromBytes(v1));
+        EXPECT_FALSE(decoded.FromBytes(bytes.substr(0, bytes.size() - 1)));
+
+        // v1 through an arena and a reused buffer
+        ASSERT_TRUE(sig_share.ToProtoBytes(arena, buf));
+        EXPECT_EQ(buf, v1);
+        ASSERT_TRUE(decoded.FromProtoBytes(arena, buf.data(), buf.size()));
+        EXPECT_EQ(decoded.z(), sig_share.z());
+        EXPECT_FALSE(decoded.FromProtoBytes(arena, buf.data(), buf.size() - 1));
+        sig_share_arr.push_back(sig_share);
+    }
+    arena.Reset();
+    BN sig;
+    EXPECT_TRUE(safeheron::tss_rsa::CombineSignatures(doc, sig_share_arr, pub2, key_meta2, sig));
+    EXPECT_TRUE(pub.VerifySignature(doc, sig));
+
+    RSASigShareProof proof(BN(12345), BN(0)), proof2;
+    ASSERT_TRUE(proof.ToBytes(bytes));
+    ASSERT_TRUE(proof2.FromBytes(bytes));
+    EXPECT_EQ(proof2.z(), BN(12345));
+    EXPECT_EQ(proof2.c(), BN(0));
+    EXPECT_FALSE(RSASigShareProof(BN(-1), BN(1)).ToBytes(bytes));
+}
+
+TEST(TSS_RSA, KeyGenEx2_3_SigningPipeline) {
+    KeyGenParam param(0,
+                      BN("E4AAECAA632881A60D11813CC8379980C673BEFB959F44AA14BB15F141ADBE9E6B25FA3A8715435427B10AA608946D0A7B68A4F75BDC376E12010F813F480007", 16),
+                      BN("C32F913ECDF403DB94B07A8D02AF2934A882226F3535E6436A6A2392A2C390E525D4531D6EFF2028AE8E16F856E0945348E007EDAC43B4CE9BE5E68D76E93E63", 16),
+                      BN::ZERO,
+                      BN::ZERO);
+    std::vector<RSAPrivateKeyShare> priv_arr;
+    RSAPublicKey pub;
+    RSAKeyMeta key_meta;
+    ASSERT_TRUE(safeheron::tss_rsa::GenerateKeyEx(1024, 3, 2, param, priv_arr, pub, key_meta));
+    safeheron::tss_rsa::CombineContext ctx(pub, key_meta);
+    safeheron::tss_rsa::ThreadPool pool(2);
+    // Verified on the pool, then on the thread handing in the shares
+    for (safeheron::tss_rsa::ThreadPool *worker_pool : {&pool, (safeheron::tss_rsa::ThreadPool *)nullptr}) {
+        safeheron::tss_rsa::SigningPipeline pipeline(ctx, 4, 8, worker_pool);
+
+        std::vector<std::string> doc_arr;
+        std::vector<uint64_t> id_arr;
+        for (int i = 0; i < 4; ++i) {
+            doc_arr.push_back("12345678123456781234567812345678" + std::to_string(i));
+            id_arr.push_back(pipeline.Submit(doc_arr[i]));
+        }
+        uint64_t id;
+        EXPECT_FALSE(pipeline.TrySubmit("one too many", id));
+
+        // Party 3 signs last, once every document is complete; document 1 gets a bad share from party 1,
+        // document 3 gets bad shares from parties 1 and 2.
+        for (size_t d = 0; d < doc_arr.size(); ++d) {
+            for (int p = 0; p < 2; ++p) {
+                RSASigShare share = priv_arr[p].Sign(doc_arr[d], key_meta, pub);
+                if ((d == 1 && p == 0) || d == 3) share.set_sig_share(share.sig_share() + 1);
+                EXPECT_TRUE(pipeline.AddShare(id_arr[d], share));
+            }
+            EXPECT_FALSE(pipeline.AddShare(id_arr[d], priv_arr[1].Sign(doc_arr[d], key_meta, pub)));
+        }
+        std::map<uint64_t, safeheron::tss_rsa::SigningResult> result_map;
+        for (size_t n = 0; n < 3; ++n) {
+            safeheron::tss_rsa::SigningResult result;
+            pipeline.WaitResult(result);
+            result_map[result.id] = result;
+        }
+        // Document 1 still waits for a third valid share
+        ASSERT_EQ(result_map.count(id_arr[1]), 0u);
+        EXPECT_TRUE(pipeline.AddShare(id_arr[1], priv_arr[2].Sign(doc_arr[1], key_meta, pub)));
+        safeheron::tss_rsa::SigningResult result;
+        pipeline.WaitResult(result);
+        result_map[result.id] = result;
+        EXPECT_FALSE(pipeline.TryTakeResult(result));
+        EXPECT_EQ(pipeline.pending(), 0u);
+
+        for (size_t d = 0; d < doc_arr.size(); ++d) {
+            const safeheron::tss_rsa::SigningResult &r = result_map[id_arr[d]];
+            if (d == 3) {
+                EXPECT_FALSE(r.ok);
+                EXPECT_EQ(r.invalid_indices.size(), 2u);
+                continue;
+            }
+            ASSERT_TRUE(r.ok);
+            EXPECT_TRUE(pub.VerifySignature(doc_arr[d], r.sig));
+            EXPECT_EQ(r.signers, d == 1 ? std::vector<int>({2, 3}) : std::vector<int>({1, 2}));
+            EXPECT_EQ(r.invalid_indices, d == 1 ? std::vector<int>({1}) : std::vector<int>());
+            // Late shares are dropped
+            EXPECT_FALSE(pipeline.AddShare(id_arr[d], priv_arr[2].Sign(doc_arr[d], key_meta, pub)));
+        }
+
+        ASSERT_TRUE(pipeline.TrySubmit(doc_arr[0], id));
+        EXPECT_TRUE(pipeline.Cancel(id));
+        EXPECT_FALSE(pipeline.Cancel(id));
+        ASSERT_TRUE(pipeline.TryTakeResult(result));
+        EXPECT_EQ(result.id, id);
+        EXPECT_FALSE(result.ok);
+    }
+}
+TEST(TSS_RSA, KeyGenEx2_3_CombineFirstValidSignatures) {
+    KeyGenParam param(0,
+                      BN("E4AAECAA632881A60D11813CC8379980C673BEFB959F44AA14BB15F141ADBE9E6B25FA3A8715435427B10AA608946D0A7B68A4F75BDC376E12010F813F480007", 16),
+                      BN("C32F913ECDF403DB94B07A8D02AF2934A882226F3535E6436A6A2392A2C390E525D4531D6EFF2028AE8E16F856E0945348E007EDAC43B4CE9BE5E68D76E93E63", 16),
+                      BN::ZERO,
+                      BN::ZERO);
+    std::vector<RSAPrivateKeyShare> priv_arr;
+    RSAPublicKey pub;
+    RSAKeyMeta key_meta;
+    ASSERT_TRUE(safeheron::tss_rsa::GenerateKeyEx(1024, 3, 2, param, priv_arr, pub, key_meta));
+    safeheron::tss_rsa::CombineContext ctx(pub, key_meta);
+    safeheron::tss_rsa::ThreadPool pool(2);
+
+    std::string doc = "12345678123456781234567812345678";
+    std::vector<RSASigShare> sig_arr;
+    for (auto &priv : priv_arr) sig_arr.push_back(priv.Sign(doc, key_meta, pub));
+    RSASigShare bad = sig_arr[0];
+    bad.set_sig_share(bad.sig_share() + 1);
+
+    BN sig;
+    std::vector<int> signers;
+    std::vector<int> invalid_indices;
+    // All valid: the first two in order of arrival are combined
+    ASSERT_TRUE(safeheron::tss_rsa::CombineFirstValidSignatures(doc, {sig_arr[2], sig_arr[0], sig_arr[1]}, ctx, nullptr, sig, signers, invalid_indices));
+    EXPECT_TRUE(pub.VerifySignature(doc, sig));
+    EXPECT_EQ(signers, std::vector<int>({1, 3}));
+    EXPECT_TRUE(invalid_indices.empty());
+
+    // A bad share, a duplicate and an out of range index are set aside
+    RSASigShare stray = sig_arr[1];
+    stray.set_index(4);
+    for (safeheron::tss_rsa::ThreadPool *p : {(safeheron::tss_rsa::ThreadPool *)nullptr, &pool}) {
+        ASSERT_TRUE(safeheron::tss_rsa::CombineFirstValidSignatures(doc, {bad, stray, sig_arr[0], sig_arr[1], sig_arr[2]}, ctx, p, sig, signers, invalid_indices));
+        EXPECT_TRUE(pub.VerifySignature(doc, sig));
+        EXPECT_EQ(signers, std::vector<int>({2, 3}));
+        EXPECT_EQ(invalid_indices, std::vector<int>({4, 1}));
+    }
+
+    // Fewer than k valid shares
+    RSASigShare bad2 = sig_arr[1];
+    bad2.set_sig_share(bad2.sig_share() + 1);
+    EXPECT_FALSE(safeheron::tss_rsa::CombineFirstValidSignatures(doc, {bad, bad2, sig_arr[2]}, ctx, &pool, sig, signers, invalid_indices));
+    EXPECT_TRUE(signers.empty());
+    std::sort(invalid_indices.begin(), invalid_indices.end());
+    EXPECT_EQ(invalid_indices, std::vector<int>({1, 2}));
+    EXPECT_FALSE(safeheron::tss_rsa::CombineFirstValidSignatures(doc, {sig_arr[0]}, ctx, &pool, sig, signers, invalid_indices));
+}
+
+TEST(TSS_RSA, KeyGenEx2_3_KeyStore) {
+    KeyGenParam param(0,
+                      BN("E4AAECAA632881A60D11813CC8379980C673BEFB959F44AA14BB15F141ADBE9E6B25FA3A8715435427B10AA608946D0A7B68A4F75BDC376E12010F813F480007", 16),
+                      BN("C32F913ECDF403DB94B07A8D02AF2934A882226F3535E6436A6A2392A2C390E525D4531D6EFF2028AE8E16F856E0945348E007EDAC43B4CE9BE5E68D76E93E63", 16),
+                      BN::ZERO,
+                      BN::ZERO);
+    std::vector<RSAPrivateKeyShare> priv_arr;
+    RSAPublicKey pub;
+    RSAKeyMeta key_meta;
+    ASSERT_TRUE(safeheron::tss_rsa::GenerateKeyEx(1024, 3, 2, param, priv_arr, pub, key_meta));
+    RSAKeyMeta key_meta2(key_meta.k(), key_meta.l(), key_meta.vkv() + 1, key_meta.vki_arr(), key_meta.vku());
+
+    safeheron::tss_rsa::KeyStoreWriter writer;
+    for (int t = 0; t < 100; ++t) {
+        EXPECT_TRUE(writer.Add("key-" + std::to_string(t), pub, t == 42 ? key_meta2 : key_meta));
+    }
+    EXPECT_FALSE(writer.Add("key-42", pub, key_meta));
+    EXPECT_EQ(writer.size(), 100u);
+    std::string path = "pure-tss-rsa-test.keystore";
+    ASSERT_TRUE(writer.WriteFile(path));
+
+    safeheron::tss_rsa::KeyStore store;
+    ASSERT_TRUE(store.Open(path));
+    EXPECT_EQ(store.size(), 100u);
+    safeheron::tss_rsa::KeyStoreEntry entry;
+    EXPECT_FALSE(store.Find("key-100", entry));
+    EXPECT_FALSE(store.Find("key-", entry));
+    EXPECT_FALSE(store.Find("", entry));
+    ASSERT_TRUE(store.Find("key-42", entry));
+    EXPECT_EQ(entry.key_id(), "key-42");
+    EXPECT_EQ(entry.k(), 2);
+    EXPECT_EQ(entry.l(), 3);
+    EXPECT_EQ(entry.vkv(), key_meta2.vkv());
+    EXPECT_EQ(entry.vku(), key_meta.vku());
+    for (size_t i = 0; i < 3; ++i) EXPECT_EQ(entry.vki(i), key_meta.vki(i));
+    EXPECT_EQ(entry.vki(3), BN::ZERO);
+    // Decoded once, and shared with the copies
+    EXPECT_EQ(&entry.vki(1), &entry.vki(1));
+    safeheron::tss_rsa::KeyStoreEntry entry_copy = entry;
+    EXPECT_EQ(&entry_copy.vkv(), &entry.vkv());
+    EXPECT_EQ(safeheron::tss_rsa::KeyStoreEntry().vkv(), BN::ZERO);
+    RSAPublicKey pub2;
+    ASSERT_TRUE(entry.public_key(pub2));
+    EXPECT_EQ(pub2.n(), pub.n());
+    EXPECT_EQ(pub2.e(), pub.e());
+
+    // The keys of the store sign as the originals
+    ASSERT_TRUE(store.Find("key-0", entry));
+    RSAKeyMeta key_meta3;
+    ASSERT_TRUE(entry.key_meta(key_meta3));
+    std::string doc = "12345678123456781234567812345678";
+    std::vector<RSASigShare> sig_arr = {priv_arr[0].Sign(doc, key_meta3, pub2), priv_arr[2].Sign(doc, key_meta3, pub2)};
+    BN sig;
+    EXPECT_TRUE(safeheron::tss_rsa::CombineSignatures(doc, sig_arr, pub2, key_meta3, sig));
+    EXPECT_TRUE(pub.VerifySignature(doc, sig));
+    store.Close();
+    EXPECT_EQ(store.size(), 0u);
+    std::remove(path.c_str());
+    EXPECT_FALSE(store.Open(path));
+
+    // In memory, and malformed
+    std::string buf;
+    writer.Serialize(buf);
+    ASSERT_TRUE(store.OpenBuffer((const uint8_t *)buf.data(), buf.size()));
+    ASSERT_TRUE(store.Find("key-99", entry));
+    EXPECT_EQ(entry.vkv(), key_meta.vkv());
+    std::string truncated = buf.substr(0, buf.size() - 1);
+    ASSERT_TRUE(store.OpenBuffer((const uint8_t *)truncated.data(), truncated.size()));
+    EXPECT_FALSE(store.Find("key-99", entry));
+    EXPECT_TRUE(store.Find("key-0", entry));
+    buf[0] = 'X';
+    EXPECT_FALSE(store.OpenBuffer((const uint8_t *)buf.data(), buf.size()));
+}
+
+TEST(TSS_RSA, KeyGenEx2_3_ReshareKey) {
+    BN p("E4AAECAA632881A60D11813CC8379980C673BEFB959F44AA14BB15F141ADBE9E6B25FA3A8715435427B10AA608946D0A7B68A4F75BDC376E12010F813F480007", 16);
+    BN q("C32F913ECDF403DB94B07A8D02AF2934A882226F3535E6436A6A2392A2C390E525D4531D6EFF2028AE8E16F856E0945348E007EDAC43B4CE9BE5E68D76E93E63", 16);
+    KeyGenParam param(0, p, q, BN::ZERO, BN::ZERO);
+    std::vector<RSAPrivateKeyShare> priv_arr;
+    RSAPublicKey pub;
+    RSAKeyMeta key_meta;
+    ASSERT_TRUE(safeheron::tss_rsa::GenerateKeyEx(1024, 3, 2, param, priv_arr, pub, key_meta));
+
+    safeheron::tss_rsa::ThreadPool pool(2);
+    std::string doc = "12345678123456781234567812345678";
+    // Refresh 2/3, then move to 3/5
+    for (int l : {3, 5}) {
+        int k = l / 2 + 1;
+        std::vector<RSAPrivateKeyShare> new_priv_arr;
+        RSAKeyMeta new_key_meta;
+        ASSERT_TRUE(safeheron::tss_rsa::ReshareKey(p, q, pub, key_meta, l, k, l == 3 ? nullptr : &pool, new_priv_arr, new_key_meta));
+        ASSERT_EQ(new_priv_arr.size(), (size_t)l);
+        EXPECT_EQ(new_key_meta.k(), k);
+        EXPECT_EQ(new_key_meta.l(), l);
+        EXPECT_EQ(new_key_meta.vkv(), key_meta.vkv());
+        EXPECT_EQ(new_key_meta.vku(), key_meta.vku());
+        EXPECT_NE(new_priv_arr[0].si(), priv_arr[0].si());
+
+        std::vector<RSASigShare> sig_arr;
+        for (int i = l - k; i < l; ++i) {
+            EXPECT_EQ(new_priv_arr[i].i(), i + 1);
+            EXPECT_EQ(new_key_meta.vki(i), new_key_meta.vkv().PowM(new_priv_arr[i].si(), pub.n()));
+            sig_arr.push_back(new_priv_arr[i].Sign(doc, new_key_meta, pub));
+        }
+        BN sig;
+        EXPECT_TRUE(safeheron::tss_rsa::CombineSignatures(doc, sig_arr, pub, new_key_meta, sig));
+        EXPECT_TRUE(pub.VerifySignature(doc, sig));
+
+        // The former shares do not verify against the new key meta data
+        sig_arr[0] = priv_arr[0].Sign(doc, new_key_meta, pub);
+        EXPECT_FALSE(safeheron::tss_rsa::CombineSignatures(doc, sig_arr, pub, new_key_meta, sig));
+    }
+
+    std::vector<RSAPrivateKeyShare> new_priv_arr;
+    RSAKeyMeta new_key_meta;
+    EXPECT_FALSE(safeheron::tss_rsa::ReshareKey(p, p, pub, key_meta, 3, 2, nullptr, new_priv_arr, new_key_meta));
+    EXPECT_FALSE(safeheron::tss_rsa::ReshareKey(p, q + 2, pub, key_meta, 3, 2, nullptr, new_priv_arr, new_key_meta));
+    EXPECT_FALSE(safeheron::tss_rsa::ReshareKey(p, q, pub, key_meta, 4, 2, nullptr, new_priv_arr, new_key_meta));
+    EXPECT_TRUE(new_priv_arr.empty());
+}
+
+TEST(TSS_RSA, KeyGenEx2_3_Metrics) {
+    using safeheron::tss_rsa::Metric;
+    KeyGenParam param(0,
+                      BN("E4AAECAA632881A60D11813CC8379980C673BEFB959F44AA14BB15F141ADBE9E6B25FA3A8715435427B10AA608946D0A7B68A4F75BDC376E12010F813F480007", 16),
+                      BN("C32F913ECDF403DB94B07A8D02AF2934A882226F3535E6436A6A2392A2C390E525D4531D6EFF2028AE8E16F856E0945348E007EDAC43B4CE9BE5E68D76E93E63", 16),
+                      BN::ZERO,
+                      BN::ZERO);
+    std::vector<RSAPrivateKeyShare> priv_arr;
+    RSAPublicKey pub;
+    RSAKeyMeta key_meta;
+    safeheron::tss_rsa::MetricsSnapshot before, after;
+    safeheron::tss_rsa::TakeMetricsSnapshot(before);
+    ASSERT_TRUE(safeheron::tss_rsa::GenerateKeyEx(1024, 3, 2, param, priv_arr, pub, key_meta));
+    std::string doc = safeheron::tss_rsa::EncodeEMSA_PSS("hello world", 1024, safeheron::tss_rsa::SaltLength::AutoLength);
+    std::vector<RSASigShare> sig_arr;
+    std::string bytes;
+    std::thread signer([&] {
+        // Counted by a thread that exits before the snapshot
+        sig_arr.push_back(priv_arr[0].Sign(doc, key_meta, pub));
+    });
+    signer.join();
+    sig_arr.push_back(priv_arr[1].Sign(doc, key_meta, pub));
+    ASSERT_TRUE(sig_arr[1].ToBytes(bytes));
+    ASSERT_TRUE(sig_arr[1].FromBytes(bytes));
+    BN sig;
+    ASSERT_TRUE(safeheron::tss_rsa::CombineSignatures(doc, sig_arr, pub, key_meta, sig));
+    safeheron::tss_rsa::TakeMetricsSnapshot(after);
+
+    auto delta = [&](Metric metric) { return after[metric].count - before[metric].count; };
+    if (!safeheron::tss_rsa::MetricsEnabled()) {
+        for (size_t m = 0; m < (size_t)Metric::Count; ++m) EXPECT_EQ(after.values[m].count, 0u);
+        return;
+    }
+    EXPECT_EQ(delta(Metric::KeyGen), 1u);
+    EXPECT_EQ(delta(Metric::PrimeSearch), 0u);
+    EXPECT_EQ(delta(Metric::Sign), 2u);
+    EXPECT_EQ(delta(Metric::Prove), 2u);
+    EXPECT_EQ(delta(Metric::Verify), 2u);
+    EXPECT_EQ(delta(Metric::ProofHash), 4u);
+    EXPECT_EQ(delta(Metric::Combine), 1u);
+    EXPECT_EQ(delta(Metric::PssEncode), 1u);
+    EXPECT_EQ(after[Metric::PssEncode].bytes - before[Metric::PssEncode].bytes, 11u);
+    EXPECT_GE(delta(Metric::Serialize), 1u);
+    EXPECT_EQ(after[Metric::Deserialize].bytes - before[Metric::Deserialize].bytes, bytes.size());
+    EXPECT_GT(delta(Metric::PowM), 0u);
+    EXPECT_GT(after[Metric::Sign].nanos, before[Metric::Sign].nanos);
+
+    std::string text = safeheron::tss_rsa::ToPrometheusText(after);
+    EXPECT_NE(text.find("safeheron_tss_rsa_sign_total " + std::to_string(after[Metric::Sign].count) + "\n"), std::string::npos);
+    EXPECT_NE(text.find("# TYPE safeheron_tss_rsa_prime_search_seconds_total counter\n"), std::string::npos);
+}
 
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
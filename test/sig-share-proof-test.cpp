@@ -0,0 +1,366 @@
+#include "gtest/gtest.h"
+#include "crypto-bn/bn.h"
+#include "crypto-bn/rand.h"
+#include "exception/safeheron_exceptions.h"
+#include "crypto-tss-rsa/tss_rsa.h"
+#include "crypto-tss-rsa/RSASigShareProof.h"
+#include "crypto-tss-rsa/MontgomeryContext.h"
+#include "crypto-tss-rsa/FixedBN.h"
+#include "crypto-tss-rsa/FixedBaseTable.h"
+#include "crypto-tss-rsa/KeyMetaPrecompute.h"
+#include "crypto-tss-rsa/ThreadPool.h"
+#include "crypto-tss-rsa/ProofTranscript.h"
+#include "crypto-hash/sha256.h"
+#include <algorithm>
+
+using safeheron::bignum::BN;
+using safeheron::tss_rsa::RSAPrivateKeyShare;
+using safeheron::tss_rsa::RSAPublicKey;
+using safeheron::tss_rsa::RSAKeyMeta;
+using safeheron::tss_rsa::RSASigShare;
+using safeheron::tss_rsa::RSASigShareProof;
+using safeheron::tss_rsa::KeyGenParam;
+using safeheron::tss_rsa::MontgomeryContext;
+using safeheron::tss_rsa::FixedBaseTable;
+using safeheron::tss_rsa::KeyMetaPrecompute;
+using safeheron::tss_rsa::ProofTranscript;
+using safeheron::exception::LocatedException;
+
+static void GenerateTestKey(std::vector<RSAPrivateKeyShare> &priv_arr, RSAPublicKey &pub, RSAKeyMeta &key_meta) {
+    KeyGenParam param(0,
+                      BN("E4AAECAA632881A60D11813CC8379980C673BEFB959F44AA14BB15F141ADBE9E6B25FA3A8715435427B10AA608946D0A7B68A4F75BDC376E12010F813F480007", 16),
+                      BN("C32F913ECDF403DB94B07A8D02AF2934A882226F3535E6436A6A2392A2C390E525D4531D6EFF2028AE8E16F856E0945348E007EDAC43B4CE9BE5E68D76E93E63", 16),
+                      BN("77268D1F347AB0EE48741FBFFD3A052154B8FC614C0FD357F5D0E7B4119D24A4EC47FFFE68DD9BB097D2D7848B08070AEEB25C99EDAA95387F71D8589209973E538D4BC9E693963E485097EB0B8AE8ACD84A13385EC1DBEB070ABAB02E322C247DE70944B17CF3109CBF3DABAB9C66C579706C00CF719314F83A48224FF16DC9", 16),
+                      BN("1E7989EBD93507193CE394263F7C32F434E67F1750A367EC725495899BEF99EBC8FCF41148B82D66BB03BAAA25625DD12B29BAA3B43807C15988278E4BD0E64BBCC133B5583431A48BB58BA188CFBDEA1B6170EDAA4D0B1E0AA0D4CCACDB3A66A7DE6A6AC31CB14B802F45AEB4FDBD9B3D621B9BE88050749A093A382EF914C1", 16));
+    bool status = safeheron::tss_rsa::GenerateKeyEx(1024, 3, 2, param, priv_arr, pub, key_meta);
+    ASSERT_TRUE(status);
+}
+
+TEST(FixedBaseTable, MatchesPowM) {
+    std::vector<RSAPrivateKeyShare> priv_arr;
+    RSAPublicKey pub;
+    RSAKeyMeta key_meta;
+    GenerateTestKey(priv_arr, pub, key_meta);
+    const BN &n = pub.n();
+
+    std::shared_ptr<const MontgomeryContext> mont = std::make_shared<MontgomeryContext>(n);
+    FixedBaseTable table(mont, key_meta.vkv(), 600);
+    EXPECT_EQ(table.PowM(BN(0)), BN(1));
+    EXPECT_EQ(table.PowM(BN(1)), key_meta.vkv());
+    for (int i = 0; i < 20; i++) {
+        BN e = safeheron::rand::RandomBNLt(BN(1) << (i * 30 + 1));
+        EXPECT_EQ(table.PowM(e), key_meta.vkv().PowM(e, n));
+    }
+    // Longer and negative exponents fall back to a plain exponentiation
+    BN e = safeheron::rand::RandomBNLt(BN(1) << 700);
+    EXPECT_EQ(table.PowM(e), key_meta.vkv().PowM(e, n));
+    EXPECT_EQ(table.PowM(BN(-5)), key_meta.vkv().PowM(BN(-5), n));
+
+    EXPECT_EQ(mont->MulM(n - 1, n - 1), BN(1));
+    EXPECT_THROW(MontgomeryContext(BN(10)), LocatedException);
+}
+
+TEST(MontgomeryContext, MultiPowM) {
+    std::vector<RSAPrivateKeyShare> priv_arr;
+    RSAPublicKey pub;
+    RSAKeyMeta key_meta;
+    GenerateTestKey(priv_arr, pub, key_meta);
+    const BN &n = pub.n();
+    MontgomeryContext mont(n);
+
+    EXPECT_EQ(mont.MultiPowM({}, {}), BN(1));
+    EXPECT_EQ(mont.MultiPowM({BN(5)}, {BN(0)}), BN(1));
+    EXPECT_THROW(mont.MultiPowM({BN(5)}, {}), LocatedException);
+
+    // Exponents of mixed signs and lengths, as in the Lagrange combination and the share proofs
+    for (size_t k = 1; k <= 7; k++) {
+        std::vector<BN> bases, exps;
+        BN expected(1);
+        for (size_t i = 0; i < k; i++) {
+            BN g = safeheron::rand::RandomBNLtGcd(n);
+            BN e = safeheron::rand::RandomBNLt(BN(1) << (1 + 97 * i));
+            if (i % 2 == 1) e = e.Neg();
+            bases.push_back(g);
+            exps.push_back(e);
+            expected = (expected * g.PowM(e, n)) % n;
+        }
+        EXPECT_EQ(mont.MultiPowM(bases, exps), expected);
+    }
+}
+
+#ifdef SAFEHERON_TSS_RSA_HAS_FIXED_BN
+template <size_t BITS>
+static void CheckFixedMontgomery() {
+    typedef safeheron::tss_rsa::FixedBN<BITS> Num;
+    auto load = [](const BN &a) {
+        std::string buf;
+        a.ToBytesBE(buf);
+        Num r;
+        r.FromBytesBE((const uint8_t *)buf.data(), buf.size());
+        return r;
+    };
+    BN n = (BN(1) << (int)(BITS - 1)) + safeheron::rand::RandomBN(BITS - 1);
+    if (n.IsEven()) n = n + 1;
+    BN rr = (BN(1) << (int)(128 * Num::LIMBS)) % n;
+    safeheron::tss_rsa::FixedMontgomery<BITS> mont(load(n), load(rr));
+
+    std::vector<BN> exps = {BN(0), BN(1), BN(65537), n - 1,
+                            safeheron::rand::RandomBNLt(BN(1) << 200), safeheron::rand::RandomBNLt(n)};
+    for (const BN &e : exps) {
+        BN base = safeheron::rand::RandomBNLt(n);
+        std::string e_bytes, out;
+        e.ToBytesBE(e_bytes);
+        Num a = load(base);
+        mont.ToMontgomery(a, a);
+        mont.Pow(a, a, (const uint8_t *)e_bytes.data(), e_bytes.size());
+        mont.FromMontgomery(a, a);
+        a.ToBytesBE(out);
+        EXPECT_EQ(BN::FromBytesBE(out), base.PowM(e, n));
+    }
+}
+
+TEST(MontgomeryContext, PowMSecret) {
+    std::vector<RSAPrivateKeyShare> priv_arr;
+    RSAPublicKey pub;
+    RSAKeyMeta key_meta;
+    GenerateTestKey(priv_arr, pub, key_meta);
+    const BN &n = pub.n();
+    MontgomeryContext mont(n);
+
+    BN x = safeheron::rand::RandomBNLtGcd(n);
+    EXPECT_EQ(mont.PowMSecret(x, BN(0)), BN(1));
+    EXPECT_EQ(mont.PowMSecret(x, BN(1)), x);
+    for (const auto &priv : priv_arr) {
+        EXPECT_EQ(mont.PowMSecret(x, priv.si() * 2), mont.PowM(x, priv.si() * 2));
+    }
+    // Unreduced and negative bases
+    EXPECT_EQ(mont.PowMSecret(x + n, BN(3)), x.PowM(BN(3), n));
+    EXPECT_EQ(mont.PowMSecret(x.Neg(), BN(3)), mont.PowM(x.Neg(), BN(3)));
+    EXPECT_THROW(mont.PowMSecret(x, BN(-1)), LocatedException);
+
+    EXPECT_EQ(mont.MulM(x + n, x.Neg()), (n - x.MulM(x, n)) % n);
+}
+
+TEST(FixedMontgomery, MatchesPowM) {
+    CheckFixedMontgomery<1024>();
+    CheckFixedMontgomery<2048>();
+    CheckFixedMontgomery<3072>();
+    CheckFixedMontgomery<4096>();
+
+    // Whichever kernel the build selected
+    BN n = (BN(1) << 2047) + safeheron::rand::RandomBN(2047);
+    if (n.IsEven()) n = n + 1;
+    MontgomeryContext ctx(n);
+#ifdef ENABLE_FIXED_BN
+    EXPECT_TRUE(ctx.fixed_width());
+#endif
+    BN base = safeheron::rand::RandomBNLt(n);
+    BN e = safeheron::rand::RandomBNLt(n);
+    EXPECT_EQ(ctx.PowM(base, e), base.PowM(e, n));
+    EXPECT_EQ(ctx.PowM(base.Neg(), e), base.Neg().PowM(e, n));
+}
+#endif
+
+TEST(RSASigShareProof, PrecomputedMatchesPlain) {
+    std::vector<RSAPrivateKeyShare> priv_arr;
+    RSAPublicKey pub;
+    RSAKeyMeta key_meta;
+    GenerateTestKey(priv_arr, pub, key_meta);
+    const BN &n = pub.n();
+    BN x = safeheron::rand::RandomBNLtGcd(n);
+
+    RSAKeyMeta plain_meta = key_meta;
+    plain_meta.set_precompute_enabled(false);
+    EXPECT_FALSE(plain_meta.Precompute(n));
+    ASSERT_TRUE(key_meta.Precompute(n));
+    // Copies share the tables, until the validation keys change
+    RSAKeyMeta copy = key_meta;
+    EXPECT_EQ(copy.Precompute(n), key_meta.Precompute(n));
+    copy.set_vki_arr(key_meta.vki_arr());
+    EXPECT_NE(copy.Precompute(n), key_meta.Precompute(n));
+    // A moved-from key meta has no tables, until it is given validation keys again
+    RSAKeyMeta moved(std::move(copy));
+    EXPECT_TRUE(moved.Precompute(n));
+    EXPECT_FALSE(copy.Precompute(n));
+    copy = key_meta;
+    EXPECT_EQ(copy.Precompute(n), key_meta.Precompute(n));
+
+    for (size_t i = 0; i < priv_arr.size(); i++) {
+        const BN &si = priv_arr[i].si();
+        BN xi = x.PowM(si * 2, n);
+
+        RSASigShareProof proof;
+        proof.Prove(si, key_meta, i, x, n, xi);
+        EXPECT_TRUE(proof.Verify(key_meta.vkv(), key_meta.vki(i), x, n, xi));
+        EXPECT_TRUE(proof.Verify(key_meta, i, x, n, xi));
+        EXPECT_TRUE(proof.Verify(plain_meta, i, x, n, xi));
+
+        RSASigShareProof plain_proof;
+        plain_proof.Prove(si, key_meta.vkv(), key_meta.vki(i), x, n, xi);
+        EXPECT_TRUE(plain_proof.Verify(key_meta, i, x, n, xi));
+
+        // Wrong share, wrong party
+        EXPECT_FALSE(proof.Verify(key_meta, i, x, n, (xi * 2) % n));
+        EXPECT_FALSE(proof.Verify(key_meta, (i + 1) % priv_arr.size(), x, n, xi));
+    }
+}
+
+TEST(ProofTranscript, ConcatenatedMagnitudes) {
+    BN a("0102", 16), b("ff", 16), c("030405", 16);
+    const uint8_t bytes[] = {0x01, 0x02, 0xff, 0x03, 0x04, 0x05};
+    uint8_t digest[safeheron::hash::CSHA256::OUTPUT_SIZE];
+    safeheron::hash::CSHA256().Write(bytes, sizeof(bytes)).Finalize(digest);
+    BN expected = BN::FromBytesBE(digest, sizeof(digest));
+
+    // 0 adds no byte
+    EXPECT_EQ(ProofTranscript().Append(a).Append(BN(0)).Append(b).Append(c).Challenge(), expected);
+    // A copy continues from the midstate, Challenge leaves the transcript as it was
+    ProofTranscript prefix;
+    prefix.Append(a).Append(b);
+    EXPECT_EQ(ProofTranscript(prefix).Append(c).Challenge(), expected);
+    EXPECT_EQ(ProofTranscript(prefix).Append(c).Challenge(), expected);
+    EXPECT_NE(prefix.Challenge(), expected);
+    EXPECT_NE(ProofTranscript(prefix).Append(a).Challenge(), expected);
+}
+
+TEST(RSASigShareProof, VerifySignatureShares) {
+    std::vector<RSAPrivateKeyShare> priv_arr;
+    RSAPublicKey pub;
+    RSAKeyMeta key_meta;
+    GenerateTestKey(priv_arr, pub, key_meta);
+    std::string doc("12345678123456781234567812345678");
+
+    std::vector<RSASigShare> sig_arr;
+    for (auto &priv : priv_arr) {
+        sig_arr.push_back(priv.Sign(doc, key_meta, pub));
+    }
+    std::vector<int> invalid_indices;
+    EXPECT_TRUE(safeheron::tss_rsa::VerifySignatureShares(doc, sig_arr, pub, key_meta, invalid_indices));
+    EXPECT_TRUE(invalid_indices.empty());
+    BN sig;
+    EXPECT_TRUE(safeheron::tss_rsa::CombineSignatures(doc, sig_arr, pub, key_meta, sig));
+    EXPECT_TRUE(pub.VerifySignature(doc, sig));
+
+    // Tamper with the share of party 2
+    sig_arr[1].set_sig_share((sig_arr[1].sig_share() * 2) % pub.n());
+    EXPECT_FALSE(safeheron::tss_rsa::VerifySignatureShares(doc, sig_arr, pub, key_meta, invalid_indices));
+    ASSERT_EQ(invalid_indices.size(), 1);
+    EXPECT_EQ(invalid_indices[0], 2);
+    EXPECT_FALSE(safeheron::tss_rsa::CombineSignatures(doc, sig_arr, pub, key_meta, sig));
+
+    // Same result without the precomputed tables
+    RSAKeyMeta plain_meta = key_meta;
+    plain_meta.set_precompute_enabled(false);
+    EXPECT_FALSE(safeheron::tss_rsa::VerifySignatureShares(doc, sig_arr, pub, plain_meta, invalid_indices));
+    ASSERT_EQ(invalid_indices.size(), 1);
+    EXPECT_EQ(invalid_indices[0], 2);
+}
+
+TEST(RSAPublicKey, MontgomeryContext) {
+    BN n = safeheron::rand::RandomPrime(256) * safeheron::rand::RandomPrime(256);
+    RSAPublicKey pub(n, BN(65537));
+    std::shared_ptr<const MontgomeryContext> mont = pub.mont();
+    ASSERT_TRUE(mont != nullptr);
+    EXPECT_EQ(mont->n(), n);
+
+    // Shared by copies, rebuilt once n changes.
+    RSAPublicKey copy = pub;
+    EXPECT_EQ(copy.mont(), mont);
+    EXPECT_EQ(pub.mont(), mont);
+    BN n2 = safeheron::rand::RandomPrime(256) * safeheron::rand::RandomPrime(256);
+    copy.set_n(n2);
+    EXPECT_EQ(copy.mont()->n(), n2);
+    EXPECT_EQ(pub.mont(), mont);
+
+    // A moved-from key still has a slot, and can be given a new n.
+    RSAPublicKey moved(std::move(copy));
+    EXPECT_EQ(moved.mont()->n(), n2);
+    copy.set_n(n);
+    EXPECT_EQ(copy.mont()->n(), n);
+    RSAPublicKey assigned;
+    assigned = std::move(moved);
+    EXPECT_EQ(assigned.mont()->n(), n2);
+    moved = RSAPublicKey(n, BN(65537));
+    EXPECT_EQ(moved.mont()->n(), n);
+
+    BN sig = safeheron::rand::RandomBNLt(n);
+    std::string doc;
+    sig.PowM(BN(65537), n).ToBytesBE(doc);
+    EXPECT_TRUE(pub.VerifySignature(doc, sig));
+    EXPECT_FALSE(pub.VerifySignature(doc, sig + 1));
+
+    RSAPublicKey even(BN(1000), BN(3));
+    EXPECT_TRUE(even.mont() == nullptr);
+}
+
+TEST(RSAPublicKey, VerifySignatures) {
+    BN n = safeheron::rand::RandomPrime(512) * safeheron::rand::RandomPrime(512);
+    RSAPublicKey pub(n, BN(65537));
+    // Pick sig and derive the doc x = sig^e, no private key needed.
+    std::vector<std::string> doc_arr;
+    std::vector<BN> sig_arr;
+    for (int i = 0; i < 150; ++i) {
+        BN sig = safeheron::rand::RandomBNLt(n);
+        std::string doc;
+        sig.PowM(BN(65537), n).ToBytesBE(doc);
+        doc_arr.push_back(doc);
+        sig_arr.push_back(sig);
+    }
+    sig_arr[7] = sig_arr[7] + 1;
+    sig_arr[100] = BN(0);
+    // Docs 20 and 21 with their signatures multiplied and divided by 2: invalid, yet their product is unchanged.
+    sig_arr[20] = sig_arr[20].MulM(BN(2), n);
+    sig_arr[21] = sig_arr[21].MulM(BN(2).InvM(n), n);
+
+    std::vector<uint8_t> expected(doc_arr.size(), 1);
+    expected[7] = expected[100] = expected[20] = expected[21] = 0;
+
+    safeheron::tss_rsa::ThreadPool pool(3);
+    std::vector<uint8_t> result_arr;
+    EXPECT_FALSE(pub.VerifySignatures(doc_arr, sig_arr, result_arr));
+    EXPECT_EQ(result_arr, expected);
+    EXPECT_FALSE(pub.VerifySignatures(doc_arr, sig_arr, result_arr, false, &pool));
+    EXPECT_EQ(result_arr, expected);
+    for (size_t i = 0; i < doc_arr.size(); ++i) {
+        EXPECT_EQ(pub.VerifySignature(doc_arr[i], sig_arr[i]), expected[i] == 1);
+    }
+
+    // Screening: the chunk holding 7 and 100 fails and is verified pair by pair, 20 and 21 screen together.
+    EXPECT_FALSE(pub.VerifySignatures(doc_arr, sig_arr, result_arr, true));
+    EXPECT_EQ(result_arr[7], RSAPublicKey::SIG_INVALID);
+    EXPECT_EQ(result_arr[100], RSAPublicKey::SIG_INVALID);
+    sig_arr[7] = sig_arr[7] - 1;
+    sig_arr[100] = safeheron::rand::RandomBNLt(n);
+    sig_arr[100].PowM(BN(65537), n).ToBytesBE(doc_arr[100]);
+    EXPECT_TRUE(pub.VerifySignatures(doc_arr, sig_arr, result_arr, true));
+    // A passing screen never reports a pair as valid.
+    EXPECT_EQ(std::count(result_arr.begin(), result_arr.end(), RSAPublicKey::SIG_VALID), 0);
+    EXPECT_EQ(result_arr[20], RSAPublicKey::SIG_SCREENED);
+    EXPECT_EQ(result_arr[21], RSAPublicKey::SIG_SCREENED);
+    EXPECT_FALSE(pub.VerifySignatures(doc_arr, sig_arr, result_arr, false));
+    EXPECT_EQ(result_arr[20], RSAPublicKey::SIG_INVALID);
+    EXPECT_EQ(result_arr[21], RSAPublicKey::SIG_INVALID);
+
+    // sig(x_1 * x_2) for x_1 and 1 for x_2 pass the screen, though x_1 and x_2 were never signed.
+    std::vector<BN> pair_sig_arr = {safeheron::rand::RandomBNLt(n), BN(1)};
+    BN x2 = safeheron::rand::RandomBNLtCoPrime(n);
+    BN x1 = pair_sig_arr[0].PowM(BN(65537), n).MulM(x2.InvM(n), n);
+    std::vector<std::string> pair_doc_arr(2);
+    x1.ToBytesBE(pair_doc_arr[0]);
+    x2.ToBytesBE(pair_doc_arr[1]);
+    EXPECT_TRUE(pub.VerifySignatures(pair_doc_arr, pair_sig_arr, result_arr, true));
+    EXPECT_EQ(result_arr, std::vector<uint8_t>(2, RSAPublicKey::SIG_SCREENED));
+    EXPECT_FALSE(pub.VerifySignatures(pair_doc_arr, pair_sig_arr, result_arr));
+    EXPECT_EQ(result_arr, std::vector<uint8_t>(2, RSAPublicKey::SIG_INVALID));
+
+    // Size mismatch.
+    sig_arr.pop_back();
+    EXPECT_FALSE(pub.VerifySignatures(doc_arr, sig_arr, result_arr));
+    EXPECT_EQ(result_arr, std::vector<uint8_t>(doc_arr.size(), 0));
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    int ret = RUN_ALL_TESTS();
+    return ret;
+}
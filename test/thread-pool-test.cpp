@@ -0,0 +1,65 @@
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+#include "gtest/gtest.h"
+#include "crypto-tss-rsa/ThreadPool.h"
+
+using safeheron::tss_rsa::ThreadPool;
+
+TEST(ThreadPool, ParallelFor) {
+    for (size_t thread_count : {1, 2, 4}) {
+        ThreadPool pool(thread_count);
+        EXPECT_EQ(pool.thread_count(), thread_count);
+
+        std::vector<int> out(1000, 0);
+        pool.ParallelFor(out.size(), [&](size_t i) { out[i] = (int)i * 2; });
+        for (size_t i = 0; i < out.size(); ++i) EXPECT_EQ(out[i], (int)i * 2);
+
+        pool.ParallelFor(0, [&](size_t) { FAIL(); });
+    }
+}
+
+TEST(ThreadPool, Nested) {
+    ThreadPool pool(3);
+    std::atomic<int> sum(0);
+    pool.ParallelFor(8, [&](size_t i) {
+        pool.ParallelFor(8, [&](size_t j) { sum += (int)(i * 8 + j); });
+    });
+    EXPECT_EQ(sum.load(), 64 * 63 / 2);
+}
+
+TEST(ThreadPool, Exception) {
+    ThreadPool pool(3);
+    std::atomic<int> calls(0);
+    EXPECT_THROW(pool.ParallelFor(100, [&](size_t i) {
+        calls++;
+        if (i == 42) throw std::runtime_error("task failed");
+    }), std::runtime_error);
+    EXPECT_EQ(calls.load(), 100);
+
+    // The pool is still usable.
+    std::atomic<int> count(0);
+    pool.ParallelFor(10, [&](size_t) { count++; });
+    EXPECT_EQ(count.load(), 10);
+}
+
+TEST(ThreadPool, Submit) {
+    for (size_t thread_count : {1, 3}) {
+        std::atomic<int> count(0);
+        {
+            ThreadPool pool(thread_count);
+            for (int i = 0; i < 100; ++i) pool.Submit([&] { count++; });
+            if (thread_count == 1) {
+                EXPECT_EQ(count.load(), 100);
+            }
+        }
+        // The destructor runs the queued tasks.
+        EXPECT_EQ(count.load(), 100);
+    }
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    int ret = RUN_ALL_TESTS();
+    return ret;
+}
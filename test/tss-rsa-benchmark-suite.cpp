@@ -0,0 +1,424 @@
+// Benchmark suite over the key size, the threshold (k, l) and the batch size, for regression tracking.
+//
+// Run all of it and keep the results as JSON:
+//     ./test/tss-rsa-benchmark-suite --benchmark_out=tss-rsa-benchmark.json --benchmark_out_format=json
+// or "make run-benchmark-suite". Select cases with --benchmark_filter, e.g. --benchmark_filter='/2048/'.
+//
+// One safe prime pair is searched per key size, on first use, then the key of every (k, l) is generated from it
+// with GenerateKeyEx; key generation is measured with the primes given, the prime search being random.
+// The caches are filled under a lock: the threads of a multi-threaded case all ask for the key.
+#include <benchmark/benchmark.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include "crypto-bn/bn.h"
+#include "crypto-bn/rand.h"
+#include "../src/crypto-tss-rsa/tss_rsa.h"
+#include "../src/crypto-tss-rsa/RSASigShareProof.h"
+#include "../src/crypto-tss-rsa/BloomFilter.h"
+#include "../src/crypto-tss-rsa/CuckooFilter.h"
+
+using safeheron::bignum::BN;
+using safeheron::tss_rsa::CombineContext;
+using safeheron::tss_rsa::KeyGenParam;
+using safeheron::tss_rsa::RSAKeyMeta;
+using safeheron::tss_rsa::RSAPrivateKeyShare;
+using safeheron::tss_rsa::RSAPublicKey;
+using safeheron::tss_rsa::RSASigShare;
+using safeheron::tss_rsa::ThreadPool;
+
+static const int KEY_BITS[] = {2048, 3072, 4096};
+static const std::pair<int, int> THRESHOLDS[] = {{2, 3}, {3, 5}, {6, 10}, {15, 20}};   // (k, l)
+static const int BATCH_SIZES[] = {1, 8, 64, 512, 1024};
+
+struct Primes
+{
+    BN p;
+    BN q;
+};
+
+struct Key
+{
+    std::vector<RSAPrivateKeyShare> priv_arr;
+    RSAPublicKey pub;
+    RSAKeyMeta key_meta;
+    std::unique_ptr<CombineContext> ctx;
+};
+
+// GetKey calls GetPrimes with the lock held
+static std::recursive_mutex &CacheMutex()
+{
+    static std::recursive_mutex mutex;
+    return mutex;
+}
+
+static const Primes &GetPrimes(int key_bits)
+{
+    static std::map<int, Primes> primes_map;
+    std::lock_guard<std::recursive_mutex> lock(CacheMutex());
+    auto it = primes_map.find(key_bits);
+    if (it == primes_map.end())
+    {
+        Primes primes;
+        size_t thread_count = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        safeheron::tss_rsa::RandomSafePrimePairParallel(key_bits / 2, key_bits / 2 - 1, thread_count, primes.p, primes.q);
+        it = primes_map.insert(std::make_pair(key_bits, primes)).first;
+    }
+    return it->second;
+}
+
+static const Key &GetKey(int key_bits, int k, int l)
+{
+    static std::map<std::vector<int>, std::unique_ptr<Key>> key_map;
+    std::lock_guard<std::recursive_mutex> lock(CacheMutex());
+    std::unique_ptr<Key> &key = key_map[{key_bits, k, l}];
+    if (!key)
+    {
+        const Primes &primes = GetPrimes(key_bits);
+        std::unique_ptr<Key> new_key(new Key());
+        KeyGenParam param(0, primes.p, primes.q, BN::ZERO, BN::ZERO);
+        if (!safeheron::tss_rsa::GenerateKeyEx(key_bits, l, k, param, new_key->priv_arr, new_key->pub, new_key->key_meta))
+        {
+            throw std::runtime_error("GenerateKeyEx failed for " + std::to_string(key_bits) + " bits, " +
+                                     std::to_string(k) + "-of-" + std::to_string(l));
+        }
+        new_key->ctx.reset(new CombineContext(new_key->pub, new_key->key_meta));
+        key = std::move(new_key);
+    }
+    return *key;
+}
+
+static std::string Doc(int key_bits, size_t i)
+{
+    return safeheron::tss_rsa::EncodeEMSA_PSS("hello world, " + std::to_string(i), key_bits,
+                                              safeheron::tss_rsa::SaltLength::AutoLength);
+}
+
+// The first k shares of the signature of doc
+static std::vector<RSASigShare> SignShares(const Key &key, const std::string &doc)
+{
+    std::vector<RSASigShare> sig_arr;
+    for (int i = 0; i < key.key_meta.k(); i++)
+    {
+        RSAPrivateKeyShare priv = key.priv_arr[i];
+        sig_arr.emplace_back(priv.Sign(doc, key.key_meta, key.pub));
+    }
+    return sig_arr;
+}
+
+// Args: key bits, k, l
+static void ThresholdArgs(benchmark::internal::Benchmark *b)
+{
+    b->ArgNames({"bits", "k", "l"});
+    for (int key_bits : KEY_BITS)
+        for (const auto &t : THRESHOLDS)
+            b->Args({key_bits, t.first, t.second});
+}
+
+// Args: key bits, batch size
+static void BatchArgs(benchmark::internal::Benchmark *b)
+{
+    b->ArgNames({"bits", "batch"});
+    for (int key_bits : KEY_BITS)
+        for (int batch : BATCH_SIZES)
+            b->Args({key_bits, batch});
+}
+
+// Args: key bits, batch size, threads
+static void ParallelBatchArgs(benchmark::internal::Benchmark *b)
+{
+    b->ArgNames({"bits", "batch", "threads"});
+    int max_threads = std::max<int>(std::thread::hardware_concurrency(), 1);
+    for (int key_bits : KEY_BITS)
+        for (int batch : BATCH_SIZES)
+            for (int threads = 1; threads <= max_threads; threads *= 2)
+                b->Args({key_bits, batch, threads});
+}
+
+void BM_keyGenWithPrimes(benchmark::State &state)
+{
+    int key_bits = (int)state.range(0), k = (int)state.range(1), l = (int)state.range(2);
+    const Primes &primes = GetPrimes(key_bits);
+    for (auto _ : state)
+    {
+        std::vector<RSAPrivateKeyShare> priv_arr;
+        RSAPublicKey pub;
+        RSAKeyMeta key_meta;
+        KeyGenParam param(0, primes.p, primes.q, BN::ZERO, BN::ZERO);
+        benchmark::DoNotOptimize(safeheron::tss_rsa::GenerateKeyEx(key_bits, l, k, param, priv_arr, pub, key_meta));
+    }
+}
+
+void BM_reshareKey(benchmark::State &state)
+{
+    int key_bits = (int)state.range(0), k = (int)state.range(1), l = (int)state.range(2);
+    const Primes &primes = GetPrimes(key_bits);
+    const Key &key = GetKey(key_bits, k, l);
+    for (auto _ : state)
+    {
+        std::vector<RSAPrivateKeyShare> priv_arr;
+        RSAKeyMeta key_meta;
+        benchmark::DoNotOptimize(safeheron::tss_rsa::ReshareKey(primes.p, primes.q, key.pub, key.key_meta, l, k,
+                                                                nullptr, priv_arr, key_meta));
+    }
+}
+
+// One signature share, proof included; with ->Threads, every thread signs with its own copy of the share
+void BM_sign(benchmark::State &state)
+{
+    int key_bits = (int)state.range(0), k = (int)state.range(1), l = (int)state.range(2);
+    const Key &key = GetKey(key_bits, k, l);
+    RSAPrivateKeyShare priv = key.priv_arr[0];
+    std::string doc = Doc(key_bits, (size_t)state.thread_index());
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(priv.Sign(doc, key.key_meta, key.pub));
+    }
+}
+
+void BM_signBatch(benchmark::State &state)
+{
+    int key_bits = (int)state.range(0);
+    size_t batch = (size_t)state.range(1);
+    const Key &key = GetKey(key_bits, 2, 3);
+    RSAPrivateKeyShare priv = key.priv_arr[0];
+    std::vector<std::string> docs;
+    for (size_t i = 0; i < batch; i++) docs.push_back(Doc(key_bits, i));
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(priv.SignBatch(docs, key.key_meta, key.pub));
+    }
+    state.SetItemsProcessed(state.iterations() * batch);
+}
+
+// The proof of one share, with the per-document context built once as in a combiner
+void BM_verifyShareProof(benchmark::State &state)
+{
+    int key_bits = (int)state.range(0), k = (int)state.range(1), l = (int)state.range(2);
+    const Key &key = GetKey(key_bits, k, l);
+    std::string doc = Doc(key_bits, 0);
+    RSAPrivateKeyShare priv = key.priv_arr[l - 1];
+    RSASigShare sig = priv.Sign(doc, key.key_meta, key.pub);
+    BN x = BN::FromBytesBE(doc);
+    if (BN::JacobiSymbol(x, key.pub.n()) == -1) x = key.ctx->mont().MulM(x, key.ctx->vku_e());
+    safeheron::tss_rsa::SigShareVerifyContext verify_ctx(key.key_meta, x, key.pub.n(), (size_t)k);
+    safeheron::tss_rsa::RSASigShareProof proof(sig.z(), sig.c());
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(proof.Verify(verify_ctx, (size_t)(l - 1), sig.sig_share()));
+    }
+}
+
+void BM_combineValidated(benchmark::State &state)
+{
+    int key_bits = (int)state.range(0), k = (int)state.range(1), l = (int)state.range(2);
+    const Key &key = GetKey(key_bits, k, l);
+    std::string doc = Doc(key_bits, 0);
+    std::vector<RSASigShare> sig_arr = SignShares(key, doc);
+    BN sig;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(safeheron::tss_rsa::CombineSignatures(doc, sig_arr, *key.ctx, sig));
+    }
+}
+
+void BM_combineWithoutValidation(benchmark::State &state)
+{
+    int key_bits = (int)state.range(0), k = (int)state.range(1), l = (int)state.range(2);
+    const Key &key = GetKey(key_bits, k, l);
+    std::string doc = Doc(key_bits, 0);
+    std::vector<RSASigShare> sig_arr = SignShares(key, doc);
+    BN sig;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(safeheron::tss_rsa::CombineSignaturesWithoutValidation(doc, sig_arr, *key.ctx, sig));
+    }
+}
+
+// All the l shares handed in, the first one invalid: the first k valid are combined
+void BM_combineFirstValid(benchmark::State &state)
+{
+    int key_bits = (int)state.range(0), k = (int)state.range(1), l = (int)state.range(2);
+    const Key &key = GetKey(key_bits, k, l);
+    std::string doc = Doc(key_bits, 0);
+    std::vector<RSASigShare> sig_arr;
+    for (int i = 0; i < l; i++)
+    {
+        RSAPrivateKeyShare priv = key.priv_arr[i];
+        sig_arr.emplace_back(priv.Sign(doc, key.key_meta, key.pub));
+    }
+    sig_arr[0].set_sig_share(sig_arr[0].sig_share() + 1);
+    BN sig;
+    std::vector<int> signers, invalid_indices;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(safeheron::tss_rsa::CombineFirstValidSignatures(doc, sig_arr, *key.ctx, nullptr, sig,
+                                                                                 signers, invalid_indices));
+    }
+}
+
+void BM_combineBatch(benchmark::State &state)
+{
+    int key_bits = (int)state.range(0);
+    size_t batch = (size_t)state.range(1);
+    ThreadPool pool((size_t)state.range(2));
+    const Key &key = GetKey(key_bits, 2, 3);
+    std::vector<std::string> doc_arr;
+    std::vector<std::vector<RSASigShare>> sig_arr_arr;
+    for (size_t i = 0; i < batch; i++)
+    {
+        doc_arr.push_back(Doc(key_bits, i));
+        sig_arr_arr.push_back(SignShares(key, doc_arr.back()));
+    }
+    std::vector<BN> sig_arr;
+    std::vector<uint8_t> status_arr;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(safeheron::tss_rsa::CombineSignaturesBatch(doc_arr, sig_arr_arr, *key.ctx, pool,
+                                                                            sig_arr, status_arr));
+    }
+    state.SetItemsProcessed(state.iterations() * batch);
+}
+
+void BM_verifySignatures(benchmark::State &state)
+{
+    int key_bits = (int)state.range(0);
+    size_t batch = (size_t)state.range(1);
+    const Key &key = GetKey(key_bits, 2, 3);
+    std::string doc = Doc(key_bits, 0);
+    BN sig;
+    safeheron::tss_rsa::CombineSignatures(doc, SignShares(key, doc), *key.ctx, sig);
+    std::vector<std::string> doc_arr(batch, doc);
+    std::vector<BN> sig_arr(batch, sig);
+    std::vector<uint8_t> result_arr;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(key.pub.VerifySignatures(doc_arr, sig_arr, result_arr));
+    }
+    state.SetItemsProcessed(state.iterations() * batch);
+}
+
+void BM_pssEncodeBatch(benchmark::State &state)
+{
+    int key_bits = (int)state.range(0);
+    size_t batch = (size_t)state.range(1);
+    ThreadPool pool((size_t)state.range(2));
+    std::vector<std::string> m_arr;
+    for (size_t i = 0; i < batch; i++) m_arr.push_back("hello world, " + std::to_string(i));
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(safeheron::tss_rsa::EncodeEMSA_PSSBatch(m_arr, key_bits,
+                                                                         safeheron::tss_rsa::SaltLength::AutoLength, &pool));
+    }
+    state.SetItemsProcessed(state.iterations() * batch);
+}
+
+// Filters holding one fingerprint per key share of a fleet: 10^4 to 10^6 members, 1024 queries, half of them members
+static std::vector<std::string> Fingerprints(size_t count, const std::string &prefix)
+{
+    std::vector<std::string> fingerprints;
+    for (size_t i = 0; i < count; i++) fingerprints.emplace_back(prefix + std::to_string(i));
+    return fingerprints;
+}
+
+static std::vector<std::string> Queries(size_t members)
+{
+    std::vector<std::string> queries;
+    for (size_t i = 0; i < 1024; i++)
+    {
+        queries.emplace_back(i % 2 ? "member " + std::to_string(i * 7919 % members) : "query " + std::to_string(i));
+    }
+    return queries;
+}
+
+template <class Filter>
+void BM_filterAdd(benchmark::State &state)
+{
+    std::vector<std::string> members = Fingerprints((size_t)state.range(0), "member ");
+    for (auto _ : state)
+    {
+        Filter filter(members.size(), 0.01);
+        for (const auto &member : members) filter.Add(member);
+        benchmark::DoNotOptimize(&filter);
+    }
+    state.SetItemsProcessed(state.iterations() * members.size());
+}
+
+template <class Filter>
+void BM_filterContains(benchmark::State &state)
+{
+    std::vector<std::string> members = Fingerprints((size_t)state.range(0), "member ");
+    std::vector<std::string> queries = Queries(members.size());
+    Filter filter(members.size(), 0.01);
+    for (const auto &member : members) filter.Add(member);
+    for (auto _ : state)
+    {
+        for (const auto &query : queries) benchmark::DoNotOptimize(filter.Contains(query));
+    }
+    state.SetItemsProcessed(state.iterations() * queries.size());
+}
+
+void BM_blockedBloomFilterTestMany(benchmark::State &state)
+{
+    std::vector<std::string> members = Fingerprints((size_t)state.range(0), "member ");
+    std::vector<std::string> queries = Queries(members.size());
+    safeheron::tss_rsa::BlockedBloomFilter filter(members.size(), 0.01);
+    for (const auto &member : members) filter.Add(member);
+    std::vector<uint8_t> results;
+    for (auto _ : state)
+    {
+        filter.TestMany(queries, results);
+        benchmark::DoNotOptimize(results.data());
+    }
+    state.SetItemsProcessed(state.iterations() * queries.size());
+}
+
+void BM_cuckooFilterAdd(benchmark::State &state)
+{
+    std::vector<std::string> members = Fingerprints((size_t)state.range(0), "member ");
+    for (auto _ : state)
+    {
+        safeheron::tss_rsa::CuckooFilter filter(members.size());
+        for (const auto &member : members) filter.Add(member);
+        benchmark::DoNotOptimize(&filter);
+    }
+    state.SetItemsProcessed(state.iterations() * members.size());
+}
+
+void BM_cuckooFilterContains(benchmark::State &state)
+{
+    std::vector<std::string> members = Fingerprints((size_t)state.range(0), "member ");
+    std::vector<std::string> queries = Queries(members.size());
+    safeheron::tss_rsa::CuckooFilter filter(members.size());
+    for (const auto &member : members) filter.Add(member);
+    for (auto _ : state)
+    {
+        for (const auto &query : queries) benchmark::DoNotOptimize(filter.Contains(query));
+    }
+    state.SetItemsProcessed(state.iterations() * queries.size());
+}
+
+BENCHMARK(BM_keyGenWithPrimes)->Apply(ThresholdArgs)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_reshareKey)->Apply(ThresholdArgs)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_sign)->Apply(ThresholdArgs)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_sign)->Name("BM_signThreads")->ArgNames({"bits", "k", "l"})->Args({2048, 2, 3})->ThreadRange(1, 16)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_signBatch)->Apply(BatchArgs)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_verifyShareProof)->Apply(ThresholdArgs)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_combineValidated)->Apply(ThresholdArgs)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_combineWithoutValidation)->Apply(ThresholdArgs)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_combineFirstValid)->Apply(ThresholdArgs)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_combineBatch)->Apply(ParallelBatchArgs)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_verifySignatures)->Apply(BatchArgs)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_pssEncodeBatch)->Apply(ParallelBatchArgs)->UseRealTime()->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_filterAdd, safeheron::tss_rsa::BloomFilter)->RangeMultiplier(10)->Range(10000, 1000000)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_filterContains, safeheron::tss_rsa::BloomFilter)->RangeMultiplier(10)->Range(10000, 1000000)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_filterAdd, safeheron::tss_rsa::BlockedBloomFilter)->RangeMultiplier(10)->Range(10000, 1000000)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_filterContains, safeheron::tss_rsa::BlockedBloomFilter)->RangeMultiplier(10)->Range(10000, 1000000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_blockedBloomFilterTestMany)->RangeMultiplier(10)->Range(10000, 1000000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_cuckooFilterAdd)->RangeMultiplier(10)->Range(10000, 1000000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_cuckooFilterContains)->RangeMultiplier(10)->Range(10000, 1000000)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
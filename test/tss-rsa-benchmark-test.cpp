@@ -1,9 +1,11 @@
 #include <benchmark/benchmark.h>
+#include <memory>
 #include "gtest/gtest.h"
 #include "crypto-bn/bn.h"
 #include "../src/crypto-tss-rsa/tss_rsa.h"
 #include "exception/safeheron_exceptions.h"
 #include "../src/crypto-tss-rsa/BloomFilter.h"
+#include "../src/crypto-tss-rsa/CuckooFilter.h"
 using safeheron::bignum::BN;
 using safeheron::tss_rsa::KeyGenParam;
 using safeheron::tss_rsa::RSAKeyMeta;
@@ -15,8 +17,11 @@ void BM_generateRandom(benchmark::State &state, int key_bits_length, int l, int
 void BM_generateEx(benchmark::State &state, int key_bits_length, int l, int k);
 
 void BM_generateSig(benchmark::State &state);
+void BM_generateSigBatch(benchmark::State &state);
 void BM_combineSig(benchmark::State &state);
+void BM_combineSigWithContext(benchmark::State &state);
 void BM_verifySig(benchmark::State &state);
+void BM_verifySigBatch(benchmark::State &state);
 
 std::vector<std::vector<RSAPrivateKeyShare>> priv_arr;
 std::vector<RSAPublicKey> pub;
@@ -83,6 +88,19 @@ void BM_generateSig(benchmark::State &state)
     }
 }
 
+// Sign all the documents with every share of the first key, one SignBatch call per share
+void BM_generateSigBatch(benchmark::State &state)
+{
+    std::vector<std::string> docs(std::begin(doc), std::end(doc));
+    for (auto _ : state)
+    {
+        for (size_t j = 0; j < priv_arr[0].size(); j++)
+        {
+            benchmark::DoNotOptimize(priv_arr[0][j].SignBatch(docs, key_meta[0], pub[0]));
+        }
+    }
+}
+
 void BM_combineSig(benchmark::State &state)
 {
     for (auto _ : state)
@@ -94,6 +112,23 @@ void BM_combineSig(benchmark::State &state)
     }
 }
 
+// Same as BM_combineSig, with one CombineContext per key built up front
+void BM_combineSigWithContext(benchmark::State &state)
+{
+    std::vector<std::unique_ptr<safeheron::tss_rsa::CombineContext>> ctx;
+    for (size_t i = 0; i < sig_arr.size(); i++)
+    {
+        ctx.emplace_back(new safeheron::tss_rsa::CombineContext(pub[i], key_meta[i]));
+    }
+    for (auto _ : state)
+    {
+        for (size_t i = 0; i < sig_arr.size(); i++)
+        {
+            CombineSignaturesWithoutValidation(doc[i], sig_arr[i], *ctx[i], sig[i]);
+        }
+    }
+}
+
 void BM_verifySig(benchmark::State &state)
 {
     for (auto _ : state)
@@ -109,22 +144,190 @@ void BM_verifySig(benchmark::State &state)
     }
 }
 
-void BM_update_bloom_filter(benchmark::State &state, Transaction &transaction, std::string &json_str)
+// Same signatures as BM_verifySig, 10 copies of every signature verified in one call per key
+void BM_verifySigBatch(benchmark::State &state)
 {
+    std::vector<std::vector<std::string>> doc_batch(sig.size());
+    std::vector<std::vector<BN>> sig_batch(sig.size());
+    for (size_t i = 0; i < sig.size(); i++)
+    {
+        doc_batch[i].assign(10, doc[i]);
+        sig_batch[i].assign(10, sig[i]);
+    }
+    std::vector<uint8_t> result_arr;
+    for (auto _ : state)
+    {
+        for (size_t i = 0; i < sig.size(); i++)
+        {
+            pub[i].VerifySignatures(doc_batch[i], sig_batch[i], result_arr);
+        }
+    }
+    for (size_t i = 0; i < sig.size(); i++)
+    {
+        EXPECT_TRUE(pub[i].VerifySignatures(doc_batch[i], sig_batch[i], result_arr));
+    }
+}
+
+// Key-share fingerprints used by the filter query benchmarks
+std::vector<std::string> make_fingerprints(size_t count, const std::string &prefix)
+{
+    std::vector<std::string> fingerprints;
+    for (size_t i = 0; i < count; i++)
+    {
+        fingerprints.emplace_back(prefix + std::to_string(i));
+    }
+    return fingerprints;
+}
+
+void BM_update_bloom_filter(benchmark::State &state, safeheron::tss_rsa::BloomHashMode mode, std::string &json_str)
+{
+    Transaction transaction;
+    transaction.bloom_filter = safeheron::tss_rsa::BloomFilter(mode);
     for (auto _ : state)
     {
         safeheron::tss_rsa::update_bloom_filter(transaction, json_str);
     }
 }
 
+void BM_insert_cuckoo_filter(benchmark::State &state)
+{
+    std::vector<std::string> members = make_fingerprints(10000, "member ");
+    safeheron::tss_rsa::CuckooFilter filter(members.size());
+    for (auto _ : state)
+    {
+        filter.Clear();
+        for (const auto &member : members)
+        {
+            filter.Add(member);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * members.size());
+}
+
+void BM_lookup_cuckoo_filter(benchmark::State &state)
+{
+    std::vector<std::string> members = make_fingerprints(10000, "member ");
+    std::vector<std::string> queries = make_fingerprints(1024, "query ");
+    safeheron::tss_rsa::CuckooFilter filter(members.size());
+    for (const auto &member : members) filter.Add(member);
+    for (auto _ : state)
+    {
+        for (const auto &query : queries)
+        {
+            benchmark::DoNotOptimize(filter.Contains(query));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * queries.size());
+}
+
+// Remove then re-insert, so that the filter load stays constant
+void BM_delete_cuckoo_filter(benchmark::State &state)
+{
+    std::vector<std::string> members = make_fingerprints(10000, "member ");
+    safeheron::tss_rsa::CuckooFilter filter(members.size());
+    for (const auto &member : members) filter.Add(member);
+    for (auto _ : state)
+    {
+        for (size_t i = 0; i < 1024; i++)
+        {
+            filter.Remove(members[i]);
+            filter.Add(members[i]);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 1024);
+}
+
 void BM_extract_bloom_filter(benchmark::State &state, Transaction &transaction, std::string &json_str)
 {
     safeheron::tss_rsa::update_bloom_filter(transaction, json_str);
-    transaction.data += transaction.bloom_filter.to_string();
+    safeheron::tss_rsa::append_bloom_filter(transaction);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(safeheron::tss_rsa::extract_bloom_filter(transaction));
+    }
+}
+
+
+void BM_bloom_filter_contains(benchmark::State &state)
+{
+    std::vector<std::string> members = make_fingerprints(10000, "member ");
+    std::vector<std::string> queries = make_fingerprints(1024, "query ");
+    safeheron::tss_rsa::BloomFilter filter(members.size(), 0.01);
+    for (const auto &member : members) filter.Add(member);
+    for (auto _ : state)
+    {
+        for (const auto &query : queries)
+        {
+            benchmark::DoNotOptimize(filter.Contains(query));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * queries.size());
+}
+
+void BM_blocked_bloom_filter_add(benchmark::State &state)
+{
+    std::vector<std::string> members = make_fingerprints(10000, "member ");
+    safeheron::tss_rsa::BlockedBloomFilter filter(members.size(), 0.01);
     for (auto _ : state)
     {
-        safeheron::tss_rsa::extract_bloom_filter(transaction);
+        for (const auto &member : members)
+        {
+            filter.Add(member);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * members.size());
+}
+
+void BM_blocked_bloom_filter_contains(benchmark::State &state)
+{
+    std::vector<std::string> members = make_fingerprints(10000, "member ");
+    std::vector<std::string> queries = make_fingerprints(1024, "query ");
+    safeheron::tss_rsa::BlockedBloomFilter filter(members.size(), 0.01);
+    for (const auto &member : members) filter.Add(member);
+    for (auto _ : state)
+    {
+        for (const auto &query : queries)
+        {
+            benchmark::DoNotOptimize(filter.Contains(query));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * queries.size());
+}
+
+// N keys against one filter
+void BM_blocked_bloom_filter_test_many(benchmark::State &state)
+{
+    std::vector<std::string> members = make_fingerprints(10000, "member ");
+    std::vector<std::string> queries = make_fingerprints(1024, "query ");
+    safeheron::tss_rsa::BlockedBloomFilter filter(members.size(), 0.01);
+    for (const auto &member : members) filter.Add(member);
+    std::vector<uint8_t> results;
+    for (auto _ : state)
+    {
+        filter.TestMany(queries, results);
+        benchmark::DoNotOptimize(results.data());
     }
+    state.SetItemsProcessed(state.iterations() * queries.size());
+}
+
+// One key against N filters
+void BM_blocked_bloom_filter_test_many_filters(benchmark::State &state)
+{
+    std::vector<safeheron::tss_rsa::BlockedBloomFilter> filters;
+    for (size_t i = 0; i < 1024; i++)
+    {
+        filters.emplace_back(safeheron::tss_rsa::BlockedBloomFilter(16, 0.01));
+        filters.back().Add("member " + std::to_string(i));
+    }
+    std::vector<const safeheron::tss_rsa::BlockedBloomFilter *> filter_ptrs;
+    for (const auto &filter : filters) filter_ptrs.push_back(&filter);
+    std::vector<uint8_t> results;
+    for (auto _ : state)
+    {
+        safeheron::tss_rsa::BlockedBloomFilter::TestMany("member 7", filter_ptrs, results);
+        benchmark::DoNotOptimize(results.data());
+    }
+    state.SetItemsProcessed(state.iterations() * filters.size());
 }
 
 int main(int argc, char **argv)
@@ -139,19 +342,38 @@ int main(int argc, char **argv)
     ::benchmark::RegisterBenchmark("BM_generateRandom", &BM_generateRandom, 4096, 5, 3)->Iterations(n_key_pairs)->Unit(benchmark::kSecond);
     // Generate 10 * "n_key_pairs" signature shares
     ::benchmark::RegisterBenchmark("BM_generateSig", &BM_generateSig)->Iterations(10)->Unit(benchmark::kSecond);
+    // Generate 10 signature shares per private key share of the first key pair, in batches
+    ::benchmark::RegisterBenchmark("BM_generateSigBatch", &BM_generateSigBatch)->Iterations(10)->Unit(benchmark::kSecond);
     // Combine 10 * "n_key_pairs" signatures
     ::benchmark::RegisterBenchmark("BM_combineSig", &BM_combineSig)->Iterations(10)->Unit(benchmark::kSecond);
+    ::benchmark::RegisterBenchmark("BM_combineSigWithContext", &BM_combineSigWithContext)->Iterations(10)->Unit(benchmark::kSecond);
     // Verify 10 * "n_key_pairs" signatures
     ::benchmark::RegisterBenchmark("BM_verifySig", &BM_verifySig)->Iterations(10)->Unit(benchmark::kSecond);
-    // Update bloom filter
-    ::benchmark::RegisterBenchmark("BM_updateBloomFilter", [&transaction, &json_str](benchmark::State &state)
-                                   { BM_update_bloom_filter(state, transaction, json_str); })
-        ->Iterations(10)
-        ->Unit(benchmark::kMillisecond);
+    // Verify 10 * "n_key_pairs" signatures, in one call per key pair
+    ::benchmark::RegisterBenchmark("BM_verifySigBatch", &BM_verifySigBatch)->Iterations(10)->Unit(benchmark::kSecond);
+    // Update bloom filter: one std::hash pass per hash function
+    ::benchmark::RegisterBenchmark("BM_updateBloomFilter_StdHash", [&json_str](benchmark::State &state)
+                                   { BM_update_bloom_filter(state, safeheron::tss_rsa::BloomHashMode::StdHash, json_str); })
+        ->Unit(benchmark::kMicrosecond);
+    // Update bloom filter: a single MurmurHash3_x64_128 pass and double hashing
+    ::benchmark::RegisterBenchmark("BM_updateBloomFilter", [&json_str](benchmark::State &state)
+                                   { BM_update_bloom_filter(state, safeheron::tss_rsa::BloomHashMode::DoubleHashing, json_str); })
+        ->Unit(benchmark::kMicrosecond);
+    // Cuckoo filter holding 10000 fingerprints
+    ::benchmark::RegisterBenchmark("BM_insertCuckooFilter", &BM_insert_cuckoo_filter)->Unit(benchmark::kMicrosecond);
+    ::benchmark::RegisterBenchmark("BM_lookupCuckooFilter", &BM_lookup_cuckoo_filter)->Unit(benchmark::kMicrosecond);
+    ::benchmark::RegisterBenchmark("BM_deleteCuckooFilter", &BM_delete_cuckoo_filter)->Unit(benchmark::kMicrosecond);
     ::benchmark::RegisterBenchmark("BM_extractBloomFilter", [&transaction, &json_str](benchmark::State &state)
                                    { BM_extract_bloom_filter(state, transaction, json_str); })
         ->Iterations(10)
         ->Unit(benchmark::kMillisecond);
+    // Query 1024 fingerprints against a filter holding 10000 of them
+    ::benchmark::RegisterBenchmark("BM_bloomFilterContains", &BM_bloom_filter_contains)->Unit(benchmark::kMicrosecond);
+    ::benchmark::RegisterBenchmark("BM_blockedBloomFilterAdd", &BM_blocked_bloom_filter_add)->Unit(benchmark::kMicrosecond);
+    ::benchmark::RegisterBenchmark("BM_blockedBloomFilterContains", &BM_blocked_bloom_filter_contains)->Unit(benchmark::kMicrosecond);
+    ::benchmark::RegisterBenchmark("BM_blockedBloomFilterTestMany", &BM_blocked_bloom_filter_test_many)->Unit(benchmark::kMicrosecond);
+    // Query one fingerprint against 1024 filters
+    ::benchmark::RegisterBenchmark("BM_blockedBloomFilterTestManyFilters", &BM_blocked_bloom_filter_test_many_filters)->Unit(benchmark::kMicrosecond);
 
     benchmark::RunSpecifiedBenchmarks();
     benchmark::Shutdown();
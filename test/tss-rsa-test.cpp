@@ -1,9 +1,11 @@
+#include <algorithm>
 #include "gtest/gtest.h"
 #include "crypto-bn/bn.h"
 #include "crypto-bn/rand.h"
 #include "exception/safeheron_exceptions.h"
 #include "../src/crypto-tss-rsa/tss_rsa.h"
 #include "../src/crypto-tss-rsa/emsa_pss.h"
+#include "../src/crypto-tss-rsa/ThreadPool.h"
 #include "crypto-encode/hex.h"
 using safeheron::bignum::BN;
 using safeheron::tss_rsa::RSAPrivateKeyShare;
@@ -95,6 +97,57 @@ TEST(TSS_RSA_4096, PSS) {
     EXPECT_TRUE(pub.VerifySignature(doc_pss, sig));
 }
 
+TEST(TSS_RSA, PSSStreaming) {
+    std::string doc(100000, '\0');
+    safeheron::rand::RandomBytes((uint8_t *)&doc[0], doc.size());
+    const int key_bits_length = 2048;
+
+    // Pieces of varying sizes give the encoding of the whole message
+    safeheron::tss_rsa::EmsaPssEncoder encoder(key_bits_length, safeheron::tss_rsa::SaltLength::AutoLength);
+    for (size_t pos = 0, piece = 1; pos < doc.size(); pos += piece, piece = piece * 3 % 997 + 1) {
+        encoder.Update((const uint8_t *)doc.data() + pos, std::min(piece, doc.size() - pos));
+    }
+    std::string em = encoder.Final();
+    EXPECT_THROW(encoder.Final(), LocatedException);
+    EXPECT_TRUE(safeheron::tss_rsa::VerifyEMSA_PSS(doc, key_bits_length, safeheron::tss_rsa::SaltLength::AutoLength, em));
+
+    std::string em2 = safeheron::tss_rsa::EncodeEMSA_PSS(doc, key_bits_length, safeheron::tss_rsa::SaltLength::EqualToHash);
+    safeheron::tss_rsa::EmsaPssVerifier verifier(key_bits_length, safeheron::tss_rsa::SaltLength::EqualToHash, em2);
+    verifier.Update((const uint8_t *)doc.data(), 4096);
+    verifier.Update((const uint8_t *)doc.data() + 4096, doc.size() - 4096);
+    EXPECT_TRUE(verifier.Final());
+    EXPECT_THROW(verifier.Update((const uint8_t *)doc.data(), 1), LocatedException);
+
+    // A message missing its last byte does not match
+    safeheron::tss_rsa::EmsaPssVerifier truncated(key_bits_length, safeheron::tss_rsa::SaltLength::AutoLength, em);
+    truncated.Update((const uint8_t *)doc.data(), doc.size() - 1);
+    EXPECT_FALSE(truncated.Final());
+}
+
+TEST(TSS_RSA, PSSBatch) {
+    std::vector<std::string> doc_arr;
+    for (size_t i = 0; i < 20; i++) doc_arr.push_back(std::string(i * 7, (char)('a' + i)));
+    safeheron::tss_rsa::ThreadPool pool(3);
+    for (int key_bits_length : {1024, 2048, 4096}) {
+        for (safeheron::tss_rsa::SaltLength salt_length : {safeheron::tss_rsa::SaltLength::AutoLength,
+                                                           safeheron::tss_rsa::SaltLength::EqualToHash}) {
+            std::vector<std::string> em_arr = safeheron::tss_rsa::EncodeEMSA_PSSBatch(doc_arr, key_bits_length, salt_length);
+            std::vector<std::string> em_arr2 = safeheron::tss_rsa::EncodeEMSA_PSSBatch(doc_arr, key_bits_length, salt_length, &pool);
+            ASSERT_EQ(em_arr.size(), doc_arr.size());
+            ASSERT_EQ(em_arr2.size(), doc_arr.size());
+            for (size_t i = 0; i < doc_arr.size(); i++) {
+                EXPECT_TRUE(safeheron::tss_rsa::VerifyEMSA_PSS(doc_arr[i], key_bits_length, salt_length, em_arr[i]));
+                EXPECT_TRUE(safeheron::tss_rsa::VerifyEMSA_PSS(doc_arr[i], key_bits_length, salt_length, em_arr2[i]));
+                // Every message has its own salt
+                EXPECT_NE(em_arr[i], em_arr2[i]);
+            }
+            EXPECT_FALSE(safeheron::tss_rsa::VerifyEMSA_PSS(doc_arr[1], key_bits_length, salt_length, em_arr[2]));
+        }
+    }
+    EXPECT_TRUE(safeheron::tss_rsa::EncodeEMSA_PSSBatch({}, 2048, safeheron::tss_rsa::SaltLength::AutoLength).empty());
+    EXPECT_THROW(safeheron::tss_rsa::EncodeEMSA_PSSBatch(doc_arr, 256, safeheron::tss_rsa::SaltLength::EqualToHash), LocatedException);
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     int ret = RUN_ALL_TESTS();